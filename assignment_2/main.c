@@ -1,240 +1,298 @@
-#include <glad/glad.h>
-#include <GLFW/glfw3.h>
-#include <iostream>
-#include <cmath>
-#include <string>
-#include <fstream>
-#include <sstream>
-
-const unsigned int WIDTH = 800;
-const unsigned int HEIGHT = 600;
-
-std::string readShaderFile(const std::string& filePath) {
-    std::ifstream shaderFile;
-    shaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-    try {
-        shaderFile.open(filePath);
-        std::stringstream shaderStream;
-        shaderStream << shaderFile.rdbuf();
-        shaderFile.close();
-        return shaderStream.str();
-    } catch (std::ifstream::failure& e) {
-        std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ: " << filePath << std::endl;
-        return "";
-    }
-}
-
-// Cube vertices with normals
-float vertices[] = {
-    // positions          // normals
-    -0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f,
-     0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f,
-     0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f,
-    -0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f,
-    
-    -0.5f, -0.5f,  0.5f,  0.0f,  0.0f,  1.0f,
-     0.5f, -0.5f,  0.5f,  0.0f,  0.0f,  1.0f,
-     0.5f,  0.5f,  0.5f,  0.0f,  0.0f,  1.0f,
-    -0.5f,  0.5f,  0.5f,  0.0f,  0.0f,  1.0f,
-    
-    -0.5f,  0.5f,  0.5f, -1.0f,  0.0f,  0.0f,
-    -0.5f,  0.5f, -0.5f, -1.0f,  0.0f,  0.0f,
-    -0.5f, -0.5f, -0.5f, -1.0f,  0.0f,  0.0f,
-    -0.5f, -0.5f,  0.5f, -1.0f,  0.0f,  0.0f,
-    
-     0.5f,  0.5f,  0.5f,  1.0f,  0.0f,  0.0f,
-     0.5f,  0.5f, -0.5f,  1.0f,  0.0f,  0.0f,
-     0.5f, -0.5f, -0.5f,  1.0f,  0.0f,  0.0f,
-     0.5f, -0.5f,  0.5f,  1.0f,  0.0f,  0.0f,
-    
-    -0.5f, -0.5f, -0.5f,  0.0f, -1.0f,  0.0f,
-     0.5f, -0.5f, -0.5f,  0.0f, -1.0f,  0.0f,
-     0.5f, -0.5f,  0.5f,  0.0f, -1.0f,  0.0f,
-    -0.5f, -0.5f,  0.5f,  0.0f, -1.0f,  0.0f,
-    
-    -0.5f,  0.5f, -0.5f,  0.0f,  1.0f,  0.0f,
-     0.5f,  0.5f, -0.5f,  0.0f,  1.0f,  0.0f,
-     0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  0.0f,
-    -0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  0.0f
-};
-
-unsigned int indices[] = {
-    0, 1, 2,  2, 3, 0,
-    4, 5, 6,  6, 7, 4,
-    8, 9, 10,  10, 11, 8,
-    12, 13, 14,  14, 15, 12,
-    16, 17, 18,  18, 19, 16,
-    20, 21, 22,  22, 23, 20
-};
-
-void multiply4x4(float* result, float* a, float* b) {
-    for(int i = 0; i < 4; i++) {
-        for(int j = 0; j < 4; j++) {
-            result[i*4+j] = 0;
-            for(int k = 0; k < 4; k++) {
-                result[i*4+j] += a[i*4+k] * b[k*4+j];
-            }
-        }
-    }
-}
-
-void identity(float* mat) {
-    for(int i = 0; i < 16; i++) mat[i] = 0;
-    mat[0] = mat[5] = mat[10] = mat[15] = 1.0f;
-}
-
-void rotateY(float* mat, float angle) {
-    identity(mat);
-    mat[0] = cos(angle);
-    mat[2] = sin(angle);
-    mat[8] = -sin(angle);
-    mat[10] = cos(angle);
-}
-
-void rotateX(float* mat, float angle) {
-    identity(mat);
-    mat[5] = cos(angle);
-    mat[6] = -sin(angle);
-    mat[9] = sin(angle);
-    mat[10] = cos(angle);
-}
-
-void perspective(float* mat, float fov, float aspect, float near, float far) {
-    identity(mat);
-    float tanHalf = tan(fov / 2.0f);
-    mat[0] = 1.0f / (aspect * tanHalf);
-    mat[5] = 1.0f / tanHalf;
-    mat[10] = -(far + near) / (far - near);
-    mat[11] = -1.0f;
-    mat[14] = -(2.0f * far * near) / (far - near);
-    mat[15] = 0.0f;
-}
-
-void translate(float* mat, float x, float y, float z) {
-    identity(mat);
-    mat[12] = x;
-    mat[13] = y;
-    mat[14] = z;
-}
-
-int main() {
-    glfwInit();
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-
-    GLFWwindow* window = glfwCreateWindow(WIDTH, HEIGHT, "3D Cube with Lights", NULL, NULL);
-    if(!window) {
-        std::cout << "Failed to create window\n";
-        glfwTerminate();
-        return -1;
-    }
-    glfwMakeContextCurrent(window);
-
-    if(!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
-        std::cout << "Failed to initialize GLAD\n";
-        return -1;
-    }
-
-    glEnable(GL_DEPTH_TEST);
-
-    std::string vertexShaderCode = readShaderFile("shader.vs");
-    std::string fragmentShaderCode = readShaderFile("shader.fs");
-
-    if (vertexShaderCode.empty() || fragmentShaderCode.empty()) {
-        glfwTerminate();
-        return -1;
-    }
-
-    const char* vertexShaderSource = vertexShaderCode.c_str();
-    const char* fragmentShaderSource = fragmentShaderCode.c_str();
-    // Compile shaders
-    unsigned int vertexShader = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertexShader, 1, &vertexShaderSource, NULL);
-    glCompileShader(vertexShader);
-
-    unsigned int fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragmentShader, 1, &fragmentShaderSource, NULL);
-    glCompileShader(fragmentShader);
-
-    unsigned int program = glCreateProgram();
-    glAttachShader(program, vertexShader);
-    glAttachShader(program, fragmentShader);
-    glLinkProgram(program);
-
-    glDeleteShader(vertexShader);
-    glDeleteShader(fragmentShader);
-
-    // Setup buffers
-    unsigned int VBO, VAO, EBO;
-    glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
-    glGenBuffers(1, &EBO);
-
-    glBindVertexArray(VAO);
-
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
-
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
-
-    // Main loop
-    while(!glfwWindowShouldClose(window)) {
-        if(glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
-            glfwSetWindowShouldClose(window, true);
-
-        glClearColor(0.1f, 0.1f, 0.15f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-        float time = glfwGetTime();
-
-        // Build transformation matrices
-        float model[16], rotX[16], rotY[16], temp[16];
-        rotateX(rotX, time * 0.5f);
-        rotateY(rotY, time * 0.8f);
-        multiply4x4(model, rotY, rotX);
-
-        float view[16];
-        translate(view, 0.0f, 0.0f, -3.0f);
-
-        float projection[16];
-        perspective(projection, 45.0f * 3.14159f / 180.0f, (float)WIDTH / HEIGHT, 0.1f, 100.0f);
-
-        // Moving lights
-        float light1X = cos(time) * 2.0f;
-        float light1Z = sin(time) * 2.0f;
-        float light2X = cos(time + 3.14159f) * 2.0f;
-        float light2Z = sin(time + 3.14159f) * 2.0f;
-
-        glUseProgram(program);
-        glUniformMatrix4fv(glGetUniformLocation(program, "model"), 1, GL_FALSE, model);
-        glUniformMatrix4fv(glGetUniformLocation(program, "view"), 1, GL_FALSE, view);
-        glUniformMatrix4fv(glGetUniformLocation(program, "projection"), 1, GL_FALSE, projection);
-        
-        glUniform3f(glGetUniformLocation(program, "objectColor"), 1.0f, 1.0f, 1.0f);
-        glUniform3f(glGetUniformLocation(program, "light1Pos"), light1X, 1.0f, light1Z);
-        glUniform3f(glGetUniformLocation(program, "light1Color"), 0.8f, 0.3f, 0.5f);
-        glUniform3f(glGetUniformLocation(program, "light2Pos"), light2X, -1.0f, light2Z);
-        glUniform3f(glGetUniformLocation(program, "light2Color"), 0.2f, 0.5f, 1.0f);
-
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-        glfwSwapBuffers(window);
-        glfwPollEvents();
-    }
-
-    glDeleteVertexArrays(1, &VAO);
-    glDeleteBuffers(1, &VBO);
-    glDeleteBuffers(1, &EBO);
-    glDeleteProgram(program);
-
-    glfwTerminate();
-    return 0;
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include <iostream>
+#include <cmath>
+#include <cstddef>
+#include <string>
+#include <fstream>
+#include <sstream>
+
+const unsigned int WIDTH = 800;
+const unsigned int HEIGHT = 600;
+
+// Uniform blocks, mirrored from the std140 declarations in the shaders.
+// std140 aligns vec3 like vec4, so positions and colors take four floats.
+enum BlockBinding {
+    CAMERA_BLOCK_BINDING = 0,
+    LIGHT_BLOCK_BINDING = 1,
+    OBJECT_BLOCK_BINDING = 2
+};
+
+struct CameraBlock {
+    float projection[16];
+    float view[16];
+};
+
+struct LightBlock {
+    float positions[2][4];
+    float colors[2][4];
+};
+
+struct ObjectBlock {
+    float model[16];
+    float color[4];
+};
+
+static_assert(offsetof(CameraBlock, view) == 64 && sizeof(CameraBlock) == 128, "CameraBlock does not match std140");
+static_assert(offsetof(LightBlock, colors) == 32 && sizeof(LightBlock) == 64, "LightBlock does not match std140");
+static_assert(offsetof(ObjectBlock, color) == 64 && sizeof(ObjectBlock) == 80, "ObjectBlock does not match std140");
+
+std::string readShaderFile(const std::string& filePath) {
+    std::ifstream shaderFile;
+    shaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+    try {
+        shaderFile.open(filePath);
+        std::stringstream shaderStream;
+        shaderStream << shaderFile.rdbuf();
+        shaderFile.close();
+        return shaderStream.str();
+    } catch (std::ifstream::failure& e) {
+        std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ: " << filePath << std::endl;
+        return "";
+    }
+}
+
+// Cube vertices with normals
+float vertices[] = {
+    // positions          // normals
+    -0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f,
+     0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f,
+     0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f,
+    -0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f,
+    
+    -0.5f, -0.5f,  0.5f,  0.0f,  0.0f,  1.0f,
+     0.5f, -0.5f,  0.5f,  0.0f,  0.0f,  1.0f,
+     0.5f,  0.5f,  0.5f,  0.0f,  0.0f,  1.0f,
+    -0.5f,  0.5f,  0.5f,  0.0f,  0.0f,  1.0f,
+    
+    -0.5f,  0.5f,  0.5f, -1.0f,  0.0f,  0.0f,
+    -0.5f,  0.5f, -0.5f, -1.0f,  0.0f,  0.0f,
+    -0.5f, -0.5f, -0.5f, -1.0f,  0.0f,  0.0f,
+    -0.5f, -0.5f,  0.5f, -1.0f,  0.0f,  0.0f,
+    
+     0.5f,  0.5f,  0.5f,  1.0f,  0.0f,  0.0f,
+     0.5f,  0.5f, -0.5f,  1.0f,  0.0f,  0.0f,
+     0.5f, -0.5f, -0.5f,  1.0f,  0.0f,  0.0f,
+     0.5f, -0.5f,  0.5f,  1.0f,  0.0f,  0.0f,
+    
+    -0.5f, -0.5f, -0.5f,  0.0f, -1.0f,  0.0f,
+     0.5f, -0.5f, -0.5f,  0.0f, -1.0f,  0.0f,
+     0.5f, -0.5f,  0.5f,  0.0f, -1.0f,  0.0f,
+    -0.5f, -0.5f,  0.5f,  0.0f, -1.0f,  0.0f,
+    
+    -0.5f,  0.5f, -0.5f,  0.0f,  1.0f,  0.0f,
+     0.5f,  0.5f, -0.5f,  0.0f,  1.0f,  0.0f,
+     0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  0.0f,
+    -0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  0.0f
+};
+
+unsigned int indices[] = {
+    0, 1, 2,  2, 3, 0,
+    4, 5, 6,  6, 7, 4,
+    8, 9, 10,  10, 11, 8,
+    12, 13, 14,  14, 15, 12,
+    16, 17, 18,  18, 19, 16,
+    20, 21, 22,  22, 23, 20
+};
+
+// Creates a uniform buffer of the given size and attaches it to a binding point
+unsigned int createUniformBuffer(unsigned int binding, size_t size) {
+    unsigned int buffer;
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+    glBufferData(GL_UNIFORM_BUFFER, size, NULL, GL_DYNAMIC_DRAW);
+    glBindBufferBase(GL_UNIFORM_BUFFER, binding, buffer);
+    return buffer;
+}
+
+void updateUniformBuffer(unsigned int buffer, const void* data, size_t size) {
+    glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, size, data);
+}
+
+void bindUniformBlock(unsigned int program, const char* name, unsigned int binding) {
+    unsigned int index = glGetUniformBlockIndex(program, name);
+    if (index != GL_INVALID_INDEX) glUniformBlockBinding(program, index, binding);
+}
+
+void multiply4x4(float* result, float* a, float* b) {
+    for(int i = 0; i < 4; i++) {
+        for(int j = 0; j < 4; j++) {
+            result[i*4+j] = 0;
+            for(int k = 0; k < 4; k++) {
+                result[i*4+j] += a[i*4+k] * b[k*4+j];
+            }
+        }
+    }
+}
+
+void identity(float* mat) {
+    for(int i = 0; i < 16; i++) mat[i] = 0;
+    mat[0] = mat[5] = mat[10] = mat[15] = 1.0f;
+}
+
+void rotateY(float* mat, float angle) {
+    identity(mat);
+    mat[0] = cos(angle);
+    mat[2] = sin(angle);
+    mat[8] = -sin(angle);
+    mat[10] = cos(angle);
+}
+
+void rotateX(float* mat, float angle) {
+    identity(mat);
+    mat[5] = cos(angle);
+    mat[6] = -sin(angle);
+    mat[9] = sin(angle);
+    mat[10] = cos(angle);
+}
+
+void perspective(float* mat, float fov, float aspect, float near, float far) {
+    identity(mat);
+    float tanHalf = tan(fov / 2.0f);
+    mat[0] = 1.0f / (aspect * tanHalf);
+    mat[5] = 1.0f / tanHalf;
+    mat[10] = -(far + near) / (far - near);
+    mat[11] = -1.0f;
+    mat[14] = -(2.0f * far * near) / (far - near);
+    mat[15] = 0.0f;
+}
+
+void translate(float* mat, float x, float y, float z) {
+    identity(mat);
+    mat[12] = x;
+    mat[13] = y;
+    mat[14] = z;
+}
+
+int main() {
+    glfwInit();
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+
+    GLFWwindow* window = glfwCreateWindow(WIDTH, HEIGHT, "3D Cube with Lights", NULL, NULL);
+    if(!window) {
+        std::cout << "Failed to create window\n";
+        glfwTerminate();
+        return -1;
+    }
+    glfwMakeContextCurrent(window);
+
+    if(!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
+        std::cout << "Failed to initialize GLAD\n";
+        return -1;
+    }
+
+    glEnable(GL_DEPTH_TEST);
+
+    std::string vertexShaderCode = readShaderFile("shader.vs");
+    std::string fragmentShaderCode = readShaderFile("shader.fs");
+
+    if (vertexShaderCode.empty() || fragmentShaderCode.empty()) {
+        glfwTerminate();
+        return -1;
+    }
+
+    const char* vertexShaderSource = vertexShaderCode.c_str();
+    const char* fragmentShaderSource = fragmentShaderCode.c_str();
+    // Compile shaders
+    unsigned int vertexShader = glCreateShader(GL_VERTEX_SHADER);
+    glShaderSource(vertexShader, 1, &vertexShaderSource, NULL);
+    glCompileShader(vertexShader);
+
+    unsigned int fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
+    glShaderSource(fragmentShader, 1, &fragmentShaderSource, NULL);
+    glCompileShader(fragmentShader);
+
+    unsigned int program = glCreateProgram();
+    glAttachShader(program, vertexShader);
+    glAttachShader(program, fragmentShader);
+    glLinkProgram(program);
+
+    glDeleteShader(vertexShader);
+    glDeleteShader(fragmentShader);
+
+    bindUniformBlock(program, "Camera", CAMERA_BLOCK_BINDING);
+    bindUniformBlock(program, "Lights", LIGHT_BLOCK_BINDING);
+    bindUniformBlock(program, "Object", OBJECT_BLOCK_BINDING);
+
+    // Setup buffers
+    unsigned int VBO, VAO, EBO;
+    glGenVertexArrays(1, &VAO);
+    glGenBuffers(1, &VBO);
+    glGenBuffers(1, &EBO);
+
+    glBindVertexArray(VAO);
+
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
+    glEnableVertexAttribArray(1);
+
+    // The camera never moves, so its block is filled once
+    unsigned int cameraUBO = createUniformBuffer(CAMERA_BLOCK_BINDING, sizeof(CameraBlock));
+    unsigned int lightUBO = createUniformBuffer(LIGHT_BLOCK_BINDING, sizeof(LightBlock));
+    unsigned int objectUBO = createUniformBuffer(OBJECT_BLOCK_BINDING, sizeof(ObjectBlock));
+
+    CameraBlock camera;
+    perspective(camera.projection, 45.0f * 3.14159f / 180.0f, (float)WIDTH / HEIGHT, 0.1f, 100.0f);
+    translate(camera.view, 0.0f, 0.0f, -3.0f);
+    updateUniformBuffer(cameraUBO, &camera, sizeof(camera));
+
+    // Main loop
+    while(!glfwWindowShouldClose(window)) {
+        if(glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
+            glfwSetWindowShouldClose(window, true);
+
+        glClearColor(0.1f, 0.1f, 0.15f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        float time = glfwGetTime();
+
+        // Build transformation matrices
+        float rotX[16], rotY[16];
+        rotateX(rotX, time * 0.5f);
+        rotateY(rotY, time * 0.8f);
+        ObjectBlock object = { {}, { 1.0f, 1.0f, 1.0f, 1.0f } };
+        multiply4x4(object.model, rotY, rotX);
+
+        // Moving lights
+        float light1X = cos(time) * 2.0f;
+        float light1Z = sin(time) * 2.0f;
+        float light2X = cos(time + 3.14159f) * 2.0f;
+        float light2Z = sin(time + 3.14159f) * 2.0f;
+        LightBlock lights = {
+            { { light1X, 1.0f, light1Z, 1.0f }, { light2X, -1.0f, light2Z, 1.0f } },
+            { { 0.8f, 0.3f, 0.5f, 1.0f }, { 0.2f, 0.5f, 1.0f, 1.0f } }
+        };
+
+        updateUniformBuffer(lightUBO, &lights, sizeof(lights));
+        updateUniformBuffer(objectUBO, &object, sizeof(object));
+
+        glUseProgram(program);
+
+        glBindVertexArray(VAO);
+        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+
+        glfwSwapBuffers(window);
+        glfwPollEvents();
+    }
+
+    glDeleteVertexArrays(1, &VAO);
+    glDeleteBuffers(1, &VBO);
+    glDeleteBuffers(1, &EBO);
+    glDeleteBuffers(1, &cameraUBO);
+    glDeleteBuffers(1, &lightUBO);
+    glDeleteBuffers(1, &objectUBO);
+    glDeleteProgram(program);
+
+    glfwTerminate();
+    return 0;
 }
\ No newline at end of file
@@ -1,31 +1,37 @@
-#version 330 core
-out vec4 FragColor;
-
-in vec3 FragPos;
-in vec3 Normal;
-
-uniform vec3 objectColor;
-uniform vec3 light1Pos;
-uniform vec3 light1Color;
-uniform vec3 light2Pos;
-uniform vec3 light2Color;
-
-void main()
-{
-    vec3 norm = normalize(Normal);
-    
-    // Light 1
-    vec3 lightDir1 = normalize(light1Pos - FragPos);
-    float diff1 = max(dot(norm, lightDir1), 0.0);
-    vec3 diffuse1 = diff1 * light1Color;
-    
-    // Light 2
-    vec3 lightDir2 = normalize(light2Pos - FragPos);
-    float diff2 = max(dot(norm, lightDir2), 0.0);
-    vec3 diffuse2 = diff2 * light2Color;
-    
-    vec3 ambient = 0.1 * vec3(1.0);
-    vec3 result = (ambient + diffuse1 + diffuse2) * objectColor;
-    
-    FragColor = vec4(result, 1.0);
+#version 330 core
+out vec4 FragColor;
+
+in vec3 FragPos;
+in vec3 Normal;
+
+// Shared with main.c's LightBlock and ObjectBlock (std140); vec3 values are
+// stored as vec4
+layout (std140) uniform Lights {
+    vec4 lightPositions[2];
+    vec4 lightColors[2];
+};
+
+layout (std140) uniform Object {
+    mat4 model;
+    vec4 objectColor;
+};
+
+void main()
+{
+    vec3 norm = normalize(Normal);
+    
+    // Light 1
+    vec3 lightDir1 = normalize(lightPositions[0].xyz - FragPos);
+    float diff1 = max(dot(norm, lightDir1), 0.0);
+    vec3 diffuse1 = diff1 * lightColors[0].rgb;
+    
+    // Light 2
+    vec3 lightDir2 = normalize(lightPositions[1].xyz - FragPos);
+    float diff2 = max(dot(norm, lightDir2), 0.0);
+    vec3 diffuse2 = diff2 * lightColors[1].rgb;
+    
+    vec3 ambient = 0.1 * vec3(1.0);
+    vec3 result = (ambient + diffuse1 + diffuse2) * objectColor.rgb;
+    
+    FragColor = vec4(result, 1.0);
 }
\ No newline at end of file
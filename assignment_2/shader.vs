@@ -1,17 +1,24 @@
-#version 330 core
-layout (location = 0) in vec3 aPos;
-layout (location = 1) in vec3 aNormal;
-
-out vec3 FragPos;
-out vec3 Normal;
-
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
-
-void main()
-{
-    FragPos = vec3(model * vec4(aPos, 1.0));
-    Normal = mat3(model) * aNormal;
-    gl_Position = projection * view * vec4(FragPos, 1.0);
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+
+out vec3 FragPos;
+out vec3 Normal;
+
+// Shared with main.c's CameraBlock and ObjectBlock (std140)
+layout (std140) uniform Camera {
+    mat4 projection;
+    mat4 view;
+};
+
+layout (std140) uniform Object {
+    mat4 model;
+    vec4 objectColor;
+};
+
+void main()
+{
+    FragPos = vec3(model * vec4(aPos, 1.0));
+    Normal = mat3(model) * aNormal;
+    gl_Position = projection * view * vec4(FragPos, 1.0);
 }
\ No newline at end of file
@@ -0,0 +1,386 @@
+// Headless animation microbenchmark. Measures the cost of one character
+// update through AnimationSystem at 1..N worker threads, either on a model
+// file or on a generated rig with a chosen bone count, hierarchy depth and
+// key density, and writes the results as JSON.
+//
+//   ./anim_bench --bones 120 --depth 8 --keys 30 --threads 8 --output rig.json
+//   ./anim_bench --model Swimming.dae --compress
+
+#include "animation_system.h"
+#include "model.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+struct RigSettings {
+    int bones = 0;              // 0 loads modelPath instead of generating a rig
+    int depth = 6;              // bones per chain below the root
+    int keysPerSecond = 30;
+    float duration = 2.0f;      // seconds
+};
+
+struct BenchResult {
+    unsigned int threads;
+    double nsPerUpdate;
+    double speedup;
+    long long cacheMisses;      // -1 when hardware counters are unavailable
+};
+
+int getIntArgument(int argc, char** argv, const char* name, int fallback) {
+    for (int i = 1; i + 1 < argc; i++) {
+        if (std::string(argv[i]) == name) return atoi(argv[i + 1]);
+    }
+    return fallback;
+}
+
+const char* getStringArgument(int argc, char** argv, const char* name, const char* fallback) {
+    for (int i = 1; i + 1 < argc; i++) {
+        if (std::string(argv[i]) == name) return argv[i + 1];
+    }
+    return fallback;
+}
+
+bool hasArgument(int argc, char** argv, const char* name) {
+    for (int i = 1; i < argc; i++) {
+        if (std::string(argv[i]) == name) return true;
+    }
+    return false;
+}
+
+// Counts last-level cache misses of the calling thread and of threads it
+// starts while the counter is open
+class CacheMissCounter {
+public:
+    CacheMissCounter() {
+#ifdef __linux__
+        perf_event_attr attr = perf_event_attr();
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = PERF_COUNT_HW_CACHE_MISSES;
+        attr.disabled = 1;
+        attr.inherit = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        fd = (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+#endif
+    }
+
+    ~CacheMissCounter() {
+#ifdef __linux__
+        if (fd >= 0) close(fd);
+#endif
+    }
+
+    void Start() {
+#ifdef __linux__
+        if (fd < 0) return;
+        ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+#endif
+    }
+
+    void Stop() {
+#ifdef __linux__
+        if (fd >= 0) ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+#endif
+    }
+
+    // Counts from worker threads are only folded in once they have exited
+    long long Read() const {
+#ifdef __linux__
+        long long count = 0;
+        if (fd >= 0 && read(fd, &count, sizeof(count)) == (ssize_t)sizeof(count)) {
+            return count;
+        }
+#endif
+        return -1;
+    }
+
+private:
+    int fd = -1;
+};
+
+aiMatrix4x4 translationMatrix(float x, float y, float z) {
+    aiMatrix4x4 matrix;
+    matrix.a4 = x;
+    matrix.b4 = y;
+    matrix.c4 = z;
+    return matrix;
+}
+
+// Builds a skinned rig of settings.bones nodes arranged in chains of
+// settings.depth under one root, a mesh with one vertex per bone and a clip
+// with a channel per bone. The caller owns the returned scene.
+aiScene* generateRig(const RigSettings& settings, std::mt19937& random) {
+    std::uniform_real_distribution<float> jitter(-1.0f, 1.0f);
+    const float ticksPerSecond = 30.0f;
+    unsigned int boneCount = (unsigned int)settings.bones;
+    unsigned int depth = (unsigned int)std::max(1, settings.depth);
+    unsigned int chainCount = (boneCount + depth - 1) / depth;
+
+    aiScene* scene = new aiScene();
+    aiNode* root = new aiNode();
+    root->mName = aiString("Root");
+    root->mNumMeshes = 1;
+    root->mMeshes = new unsigned int[1];
+    root->mMeshes[0] = 0;
+    root->mNumChildren = chainCount;
+    root->mChildren = new aiNode*[chainCount];
+    scene->mRootNode = root;
+
+    std::vector<aiNode*> boneNodes;
+    for (unsigned int chain = 0; chain < chainCount; chain++) {
+        aiNode* parent = root;
+        unsigned int length = std::min(depth, boneCount - chain * depth);
+        for (unsigned int link = 0; link < length; link++) {
+            aiNode* node = new aiNode();
+            node->mName = aiString(("Bone" + std::to_string(boneNodes.size())).c_str());
+            node->mTransformation = translationMatrix(jitter(random), 10.0f, jitter(random));
+            node->mParent = parent;
+            if (link + 1 < length) {
+                node->mNumChildren = 1;
+                node->mChildren = new aiNode*[1];
+            }
+            if (parent == root) {
+                root->mChildren[chain] = node;
+            }
+            else {
+                parent->mChildren[0] = node;
+            }
+            boneNodes.push_back(node);
+            parent = node;
+        }
+    }
+
+    aiMesh* mesh = new aiMesh();
+    mesh->mNumVertices = boneCount;
+    mesh->mVertices = new aiVector3D[boneCount];
+    mesh->mNumBones = boneCount;
+    mesh->mBones = new aiBone*[boneCount];
+    for (unsigned int i = 0; i < boneCount; i++) {
+        mesh->mVertices[i] = aiVector3D(jitter(random), (float)i, jitter(random));
+        aiBone* bone = new aiBone();
+        bone->mName = boneNodes[i]->mName;
+        bone->mNumWeights = 1;
+        bone->mWeights = new aiVertexWeight[1];
+        bone->mWeights[0].mVertexId = i;
+        bone->mWeights[0].mWeight = 1.0f;
+        mesh->mBones[i] = bone;
+    }
+    scene->mNumMeshes = 1;
+    scene->mMeshes = new aiMesh*[1];
+    scene->mMeshes[0] = mesh;
+
+    unsigned int keyCount = std::max(2u, (unsigned int)(settings.keysPerSecond * settings.duration) + 1);
+    double duration = settings.duration * ticksPerSecond;
+    aiAnimation* animation = new aiAnimation();
+    animation->mName = aiString("Synthetic");
+    animation->mDuration = duration;
+    animation->mTicksPerSecond = ticksPerSecond;
+    animation->mNumChannels = boneCount;
+    animation->mChannels = new aiNodeAnim*[boneCount];
+    for (unsigned int i = 0; i < boneCount; i++) {
+        aiNodeAnim* channel = new aiNodeAnim();
+        channel->mNodeName = boneNodes[i]->mName;
+        channel->mNumPositionKeys = keyCount;
+        channel->mPositionKeys = new aiVectorKey[keyCount];
+        channel->mNumRotationKeys = keyCount;
+        channel->mRotationKeys = new aiQuatKey[keyCount];
+        channel->mNumScalingKeys = keyCount;
+        channel->mScalingKeys = new aiVectorKey[keyCount];
+
+        glm::vec3 axis = glm::normalize(glm::vec3(jitter(random), jitter(random), jitter(random)) + glm::vec3(0.0f, 0.0f, 0.01f));
+        float phase = jitter(random) * 3.14159265f;
+        for (unsigned int k = 0; k < keyCount; k++) {
+            double time = duration * k / (keyCount - 1);
+            float angle = 0.5f * std::sin(phase + 6.2831853f * (float)k / (keyCount - 1));
+            glm::quat rotation = glm::angleAxis(angle, axis);
+            channel->mPositionKeys[k].mTime = time;
+            channel->mPositionKeys[k].mValue = aiVector3D(jitter(random) * 0.1f, 10.0f, jitter(random) * 0.1f);
+            channel->mRotationKeys[k].mTime = time;
+            channel->mRotationKeys[k].mValue = aiQuaternion(rotation.w, rotation.x, rotation.y, rotation.z);
+            channel->mScalingKeys[k].mTime = time;
+            channel->mScalingKeys[k].mValue = aiVector3D(1.0f, 1.0f, 1.0f);
+        }
+        animation->mChannels[i] = channel;
+    }
+    scene->mNumAnimations = 1;
+    scene->mAnimations = new aiAnimation*[1];
+    scene->mAnimations[0] = animation;
+    return scene;
+}
+
+BenchResult runAnimationSystem(Model* model, unsigned int threads, int instanceCount, int frames, std::mt19937& random) {
+    const float frameTime = 1.0f / 60.0f;
+    std::uniform_real_distribution<float> startTime(0.0f, (float)model->GetAnimation()->mDuration);
+
+    BenchResult result;
+    result.threads = threads;
+    result.speedup = 1.0;
+    double seconds = 0.0;
+
+    CacheMissCounter counter;
+    {
+        // Worker threads must start after the counter opens to be counted
+        AnimationSystem system(threads);
+        for (int i = 0; i < instanceCount; i++) {
+            system.AddInstance(model, startTime(random));
+        }
+        for (int i = 0; i < 10; i++) {
+            system.Update(frameTime);
+        }
+
+        counter.Start();
+        auto start = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < frames; i++) {
+            system.Update(frameTime);
+        }
+        seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+        counter.Stop();
+    }
+
+    result.nsPerUpdate = seconds * 1e9 / ((double)instanceCount * frames);
+    result.cacheMisses = counter.Read();
+    return result;
+}
+
+double runModelUpdate(Model* model, int frames) {
+    const float frameTime = 1.0f / 60.0f;
+    for (int i = 0; i < 10; i++) {
+        model->UpdateAnimation(frameTime);
+    }
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < frames; i++) {
+        model->UpdateAnimation(frameTime);
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+    return seconds * 1e9 / frames;
+}
+
+void writeJson(const char* path, const std::string& source, const Model& model, const RigSettings& rig, bool compressed,
+               int instanceCount, int frames, double modelUpdateNs, const std::vector<BenchResult>& results) {
+    std::ofstream file(path);
+    if (!file) {
+        std::cout << "ERROR::BENCHMARK::CANNOT_WRITE " << path << std::endl;
+        return;
+    }
+
+    file << "{\n";
+    file << "  \"source\": \"" << source << "\",\n";
+    file << "  \"bones\": " << model.boneCounter << ",\n";
+    file << "  \"nodes\": " << model.skeleton.size() << ",\n";
+    if (rig.bones > 0) {
+        file << "  \"depth\": " << rig.depth << ",\n";
+        file << "  \"keysPerSecond\": " << rig.keysPerSecond << ",\n";
+    }
+    file << "  \"compressed\": " << (compressed ? "true" : "false") << ",\n";
+    file << "  \"instances\": " << instanceCount << ",\n";
+    file << "  \"frames\": " << frames << ",\n";
+    file << "  \"modelUpdateNs\": " << modelUpdateNs << ",\n";
+    file << "  \"results\": [\n";
+    for (size_t i = 0; i < results.size(); i++) {
+        const BenchResult& result = results[i];
+        file << "    { \"threads\": " << result.threads
+             << ", \"nsPerCharacterUpdate\": " << result.nsPerUpdate
+             << ", \"speedup\": " << result.speedup
+             << ", \"cacheMisses\": ";
+        if (result.cacheMisses >= 0) {
+            file << result.cacheMisses << ", \"cacheMissesPerUpdate\": "
+                 << (double)result.cacheMisses / ((double)instanceCount * frames);
+        }
+        else {
+            file << "null, \"cacheMissesPerUpdate\": null";
+        }
+        file << " }" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    file << "  ]\n";
+    file << "}\n";
+}
+
+int main(int argc, char** argv) {
+    RigSettings rig;
+    rig.bones = getIntArgument(argc, argv, "--bones", 0);
+    rig.depth = getIntArgument(argc, argv, "--depth", rig.depth);
+    rig.keysPerSecond = getIntArgument(argc, argv, "--keys", rig.keysPerSecond);
+    const char* modelPath = getStringArgument(argc, argv, "--model", "Swimming.dae");
+    const char* outputPath = getStringArgument(argc, argv, "--output", "anim_bench.json");
+    int maxThreads = getIntArgument(argc, argv, "--threads", (int)std::max(1u, std::thread::hardware_concurrency()));
+    int instanceCount = std::max(1, getIntArgument(argc, argv, "--instances", 256));
+    int frames = std::max(1, getIntArgument(argc, argv, "--frames", 300));
+    bool compress = hasArgument(argc, argv, "--compress");
+
+    // Fixed seed so runs with the same arguments are comparable
+    std::mt19937 random(1234);
+    // Declared before the model so the model, which points into it, goes first
+    std::unique_ptr<aiScene> generated;
+    std::unique_ptr<Model> model;
+    std::string source;
+    if (rig.bones > 0) {
+        generated.reset(generateRig(rig, random));
+        model.reset(new Model(generated.get(), false));
+        source = "synthetic";
+    }
+    else {
+        model.reset(new Model(modelPath, false));
+        source = modelPath;
+    }
+
+    if (!model->GetAnimation() || model->skeleton.empty()) {
+        std::cout << "ERROR::BENCHMARK::NO_ANIMATION " << source << std::endl;
+        return 1;
+    }
+
+    if (compress) {
+        // Keep the raw keys so the single-model loop below samples the same clip
+        ClipCompressionSettings settings;
+        settings.releaseSourceKeys = false;
+        compress = model->CompressAnimation(settings);
+    }
+
+    double modelUpdateNs = runModelUpdate(model.get(), frames);
+
+    // 1, 2, 4, ... threads, always ending at maxThreads
+    std::vector<unsigned int> threadCounts;
+    for (int threads = 1; threads < maxThreads; threads *= 2) {
+        threadCounts.push_back((unsigned int)threads);
+    }
+    threadCounts.push_back((unsigned int)std::max(1, maxThreads));
+
+    std::vector<BenchResult> results;
+    for (unsigned int threads : threadCounts) {
+        results.push_back(runAnimationSystem(model.get(), threads, instanceCount, frames, random));
+        results.back().speedup = results.front().nsPerUpdate / results.back().nsPerUpdate;
+    }
+
+    std::cout << std::endl;
+    std::cout << "Animation benchmark: " << source << ", " << model->boneCounter << " bones, "
+              << instanceCount << " instances, " << frames << " frames"
+              << (compress ? ", compressed clip" : "") << std::endl;
+    std::cout << "  Model::UpdateAnimation: " << modelUpdateNs << " ns" << std::endl;
+    for (const auto& result : results) {
+        std::cout << "  " << result.threads << " thread(s): " << result.nsPerUpdate << " ns per character update, "
+                  << result.speedup << "x";
+        if (result.cacheMisses >= 0) {
+            std::cout << ", " << (double)result.cacheMisses / ((double)instanceCount * frames) << " cache misses per update";
+        }
+        std::cout << std::endl;
+    }
+
+    writeJson(outputPath, source, *model, rig, compress, instanceCount, frames, modelUpdateNs, results);
+    std::cout << "Results written to " << outputPath << std::endl;
+    return 0;
+}
@@ -0,0 +1,81 @@
+#include "animation_baker.h"
+#include "gl_state.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+bool AnimationBaker::Bake(const Model& model, float frameRate, BakedAnimation& baked) {
+    const aiAnimation* animation = model.GetAnimation();
+    if (!animation || model.boneTransforms.empty() || model.meshes.empty() || frameRate <= 0.0f) {
+        std::cout << "ERROR::ANIMATION_BAKER::NOTHING_TO_BAKE" << std::endl;
+        return false;
+    }
+
+    float ticksPerSecond = animation->mTicksPerSecond != 0 ? animation->mTicksPerSecond : 25.0f;
+    std::vector<unsigned int> meshBoneOffsets;
+    unsigned int boneCount = 0;
+    for (const auto& mesh : model.meshes) {
+        meshBoneOffsets.push_back(boneCount);
+        boneCount += (unsigned int)mesh.bones.size();
+    }
+    float duration = (float)animation->mDuration / ticksPerSecond;
+    unsigned int frameCount = std::max(1u, (unsigned int)std::ceil(duration * frameRate));
+
+    GLint maxSize = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+    if (boneCount * 3 > (unsigned int)maxSize || frameCount > (unsigned int)maxSize) {
+        std::cout << "ERROR::ANIMATION_BAKER::TEXTURE_TOO_LARGE: " << boneCount * 3 << "x" << frameCount
+                  << " exceeds " << maxSize << std::endl;
+        return false;
+    }
+
+    std::vector<glm::mat4> nodeGlobals(model.skeleton.size());
+    std::vector<glm::mat4> palette(model.boneTransforms.size(), glm::mat4(1.0f));
+    std::vector<glm::vec4> texels(boneCount * 3 * frameCount);
+
+    float animationTime = 0.0f;
+    for (unsigned int frame = 0; frame < frameCount; frame++) {
+        model.EvaluatePose(animationTime, nodeGlobals.data(), palette.data());
+        animationTime = model.AdvanceAnimationTime(animationTime, 1.0f / frameRate);
+
+        glm::vec4* row = &texels[frame * boneCount * 3];
+        for (size_t m = 0; m < model.meshes.size(); m++) {
+            const std::vector<unsigned int>& bones = model.meshes[m].bones;
+            for (size_t b = 0; b < bones.size(); b++) {
+                const glm::mat4& bone = palette[bones[b]];
+                glm::vec4* out = &row[(meshBoneOffsets[m] + b) * 3];
+                for (int r = 0; r < 3; r++) {
+                    out[r] = glm::vec4(bone[0][r], bone[1][r], bone[2][r], bone[3][r]);
+                }
+            }
+        }
+    }
+
+    Release(baked);
+    glGenTextures(1, &baked.texture);
+    GLStateCache::Get().BindTexture(BAKED_ANIMATION_TEXTURE_UNIT, GL_TEXTURE_2D, baked.texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, boneCount * 3, frameCount, 0, GL_RGBA, GL_FLOAT, texels.data());
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    baked.boneCount = boneCount;
+    baked.meshBoneOffsets = meshBoneOffsets;
+    baked.frameCount = frameCount;
+    baked.frameRate = frameRate;
+    baked.duration = duration;
+
+    std::cout << "Baked animation: " << frameCount << " frames x " << boneCount << " bones ("
+              << texels.size() * sizeof(glm::vec4) / 1024 << " KB)" << std::endl;
+    return true;
+}
+
+void AnimationBaker::Release(BakedAnimation& baked) {
+    if (baked.texture) {
+        glDeleteTextures(1, &baked.texture);
+        GLStateCache::Get().Invalidate();
+    }
+    baked = BakedAnimation();
+}
@@ -0,0 +1,35 @@
+#ifndef ANIMATION_BAKER_H
+#define ANIMATION_BAKER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "model.h"
+
+#include <vector>
+
+// Texture unit the crowd shader reads baked bone matrices from
+#define BAKED_ANIMATION_TEXTURE_UNIT 9
+
+// A clip sampled at a fixed rate into an RGBA32F texture: one row per frame,
+// three texels per bone holding the rows of its 3x4 skinning matrix. Each
+// mesh's palette (Mesh::bones) is stored as its own run of bones in the row.
+struct BakedAnimation {
+    unsigned int texture = 0;
+    unsigned int boneCount = 0;         // bones per row, summed over meshes
+    std::vector<unsigned int> meshBoneOffsets;   // first bone of each mesh in a row
+    unsigned int frameCount = 0;
+    float frameRate = 0.0f;     // frames per second of playback
+    float duration = 0.0f;      // clip length in seconds
+};
+
+// Bakes the model's clip offline by stepping the same pose evaluation
+// UpdateAnimation uses, so instanced crowds replay it without any per-instance
+// CPU work or palette uploads.
+class AnimationBaker {
+public:
+    static bool Bake(const Model& model, float frameRate, BakedAnimation& baked);
+    static void Release(BakedAnimation& baked);
+};
+
+#endif
@@ -0,0 +1,214 @@
+#include "animation_system.h"
+
+#include <algorithm>
+
+AnimationSystem::AnimationSystem(unsigned int threadCount) : jobs(threadCount) {
+    workerNodeGlobals.resize(jobs.GetWorkerCount());
+    workerStats.resize(jobs.GetWorkerCount());
+}
+
+int AnimationSystem::AddInstance(Model* model, float startTime) {
+    CharacterInstance instance;
+    instance.model = model;
+    instance.animationTime = startTime;
+    instance.paletteOffset = (unsigned int)palettes.size();
+    instance.paletteSize = (unsigned int)model->boneTransforms.size();
+    palettes.resize(palettes.size() + instance.paletteSize, glm::mat4(1.0f));
+    blendPalettes.resize(palettes.size() * 2, glm::mat4(1.0f));
+
+    model->SetDetailBones(lodSettings.detailBonePatterns);
+    for (auto& scratch : workerNodeGlobals) {
+        if (scratch.size() < model->skeleton.size()) {
+            scratch.resize(model->skeleton.size());
+        }
+    }
+
+    instances.push_back(instance);
+    return (int)instances.size() - 1;
+}
+
+CharacterInstance& AnimationSystem::GetInstance(int id) {
+    return instances[id];
+}
+
+unsigned int AnimationSystem::GetInstanceCount() const {
+    return (unsigned int)instances.size();
+}
+
+void AnimationSystem::SetLODSettings(const AnimationLODSettings& settings) {
+    lodSettings = settings;
+    for (auto& instance : instances) {
+        instance.model->SetDetailBones(lodSettings.detailBonePatterns);
+    }
+}
+
+void AnimationSystem::SetPoseCacheSettings(const PoseCacheSettings& settings) {
+    poseCache.SetSettings(settings);
+}
+
+void AnimationSystem::SetViewer(const glm::vec3& position, const Frustum& frustum) {
+    hasViewer = true;
+    viewerPosition = position;
+    viewFrustum = frustum;
+}
+
+void AnimationSystem::Update(float deltaTime) {
+    for (auto& workerStat : workerStats) {
+        workerStat = AnimationStats();
+    }
+
+    stats = AnimationStats();
+    PlanInstances(deltaTime);
+    poseCache.Resolve(poseRequests);
+
+    // Every distinct pose first, then the instances that use them
+    jobs.ParallelFor((unsigned int)poseRequests.size(), 4, [this](unsigned int begin, unsigned int end, unsigned int worker) {
+        EvaluatePoses(begin, end, worker);
+    });
+    jobs.ParallelFor((unsigned int)instances.size(), 4, [this](unsigned int begin, unsigned int end, unsigned int) {
+        FinishInstances(begin, end);
+    });
+
+    for (const auto& request : poseRequests) {
+        if (!request.evaluate) stats.posesFromCache++;
+    }
+    for (const auto& workerStat : workerStats) {
+        stats.instancesEvaluated += workerStat.instancesEvaluated;
+        stats.bonesEvaluated += workerStat.bonesEvaluated;
+    }
+}
+
+int AnimationSystem::SelectLOD(const CharacterInstance& instance) const {
+    if (!hasViewer || lodSettings.levels.empty()) return -1;
+
+    float distance = glm::length(instance.position - viewerPosition);
+    for (size_t i = 0; i < lodSettings.levels.size(); i++) {
+        if (distance <= lodSettings.levels[i].maxDistance) return (int)i;
+    }
+    return (int)lodSettings.levels.size() - 1;
+}
+
+void AnimationSystem::PlanInstances(float deltaTime) {
+    updates.assign(instances.size(), PoseUpdate::None);
+    instanceRequests.assign(instances.size(), -1);
+    poseRequests.clear();
+
+    for (unsigned int i = 0; i < instances.size(); i++) {
+        CharacterInstance& instance = instances[i];
+        const Model* model = instance.model;
+        const StreamedClip* clip = instance.clip.get();
+        if (!clip && !model->GetAnimation()) continue;
+
+        // Time always advances so culled characters stay in sync
+        float step = deltaTime * instance.playbackSpeed;
+        instance.animationTime = clip ? clip->AdvanceTime(instance.animationTime, step)
+                                      : model->AdvanceAnimationTime(instance.animationTime, step);
+
+        if (hasViewer && !IsInView(instance)) {
+            instance.visible = false;
+            stats.instancesCulled++;
+            continue;
+        }
+
+        int lod = SelectLOD(instance);
+        unsigned int interval = lod >= 0 ? lodSettings.levels[lod].updateInterval : 1;
+        bool reduced = lod >= 0 && lodSettings.levels[lod].reducedSkeleton;
+        instance.lod = lod;
+
+        // Full rate, or just became visible: evaluate straight into the palette
+        if (interval <= 1 || !instance.visible) {
+            updates[i] = PoseUpdate::Evaluate;
+            AddPoseRequest(i, instance.animationTime, reduced, &palettes[instance.paletteOffset]);
+            instance.visible = true;
+            instance.blendStep = instance.blendSteps = 0;
+            continue;
+        }
+
+        // Start a new interval: blend from what is shown now towards the pose
+        // at the time the interval ends
+        if (instance.blendStep >= instance.blendSteps) {
+            float targetTime = clip ? clip->AdvanceTime(instance.animationTime, step * (interval - 1))
+                                    : model->AdvanceAnimationTime(instance.animationTime, step * (interval - 1));
+            updates[i] = PoseUpdate::StartBlend;
+            AddPoseRequest(i, targetTime, reduced, &blendPalettes[instance.paletteOffset * 2] + instance.paletteSize);
+            instance.blendStep = 0;
+            instance.blendSteps = interval;
+        }
+        else {
+            updates[i] = PoseUpdate::Blend;
+            stats.instancesInterpolated++;
+        }
+        instance.blendStep++;
+    }
+}
+
+void AnimationSystem::AddPoseRequest(unsigned int instance, float animationTime, bool reducedSkeleton, glm::mat4* output) {
+    PoseRequest request;
+    request.model = instances[instance].model;
+    request.clip = instances[instance].clip.get();
+    request.animationTime = animationTime;
+    request.lod = instances[instance].lod;
+    request.reducedSkeleton = reducedSkeleton;
+    request.output = output;
+    instanceRequests[instance] = (int)poseRequests.size();
+    poseRequests.push_back(request);
+}
+
+// Requests sharing a cached pose leave it to the one that evaluates it
+void AnimationSystem::EvaluatePoses(unsigned int begin, unsigned int end, unsigned int worker) {
+    glm::mat4* nodeGlobals = workerNodeGlobals[worker].data();
+    AnimationStats& counters = workerStats[worker];
+
+    for (unsigned int r = begin; r < end; r++) {
+        if (!poseRequests[r].evaluate) continue;
+        counters.bonesEvaluated += PoseCache::Evaluate(poseRequests[r], nodeGlobals);
+        counters.instancesEvaluated++;
+    }
+}
+
+void AnimationSystem::FinishInstances(unsigned int begin, unsigned int end) {
+    for (unsigned int i = begin; i < end; i++) {
+        if (updates[i] == PoseUpdate::None) continue;
+        CharacterInstance& instance = instances[i];
+        glm::mat4* output = &palettes[instance.paletteOffset];
+        if (instanceRequests[i] >= 0) PoseCache::CopyResult(poseRequests[instanceRequests[i]]);
+
+        if (updates[i] != PoseUpdate::Evaluate) {
+            glm::mat4* previous = &blendPalettes[instance.paletteOffset * 2];
+            glm::mat4* target = previous + instance.paletteSize;
+            if (updates[i] == PoseUpdate::StartBlend) {
+                std::copy(output, output + instance.paletteSize, previous);
+            }
+            float factor = (float)instance.blendStep / instance.blendSteps;
+            for (unsigned int b = 0; b < instance.paletteSize; b++) {
+                output[b] = previous[b] + (target[b] - previous[b]) * factor;
+            }
+        }
+        instance.bounds = instance.model->skinnedBounds.Compute(output, instance.paletteSize);
+    }
+}
+
+// Culled instances keep the bounds of the pose they were last seen in
+bool AnimationSystem::IsInView(const CharacterInstance& instance) const {
+    if (instance.bounds.IsEmpty()) {
+        return viewFrustum.IntersectsSphere(instance.position, instance.boundingRadius);
+    }
+    BoundingVolume world = instance.bounds.Transform(instance.transform);
+    return viewFrustum.IntersectsSphere(world.center, world.radius);
+}
+
+const glm::mat4* AnimationSystem::GetPalette(int id) const {
+    return palettes.data() + instances[id].paletteOffset;
+}
+
+const std::vector<glm::mat4>& AnimationSystem::GetPalettes() const {
+    return palettes;
+}
+
+const AnimationStats& AnimationSystem::GetStats() const {
+    return stats;
+}
+
+PoseCacheStats AnimationSystem::GetPoseCacheStats() const {
+    return poseCache.GetStats();
+}
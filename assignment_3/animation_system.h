@@ -0,0 +1,127 @@
+#ifndef ANIMATION_SYSTEM_H
+#define ANIMATION_SYSTEM_H
+
+#include <glm/glm.hpp>
+
+#include "frustum.h"
+#include "job_system.h"
+#include "model.h"
+#include "pose_cache.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+struct CharacterInstance {
+    Model* model = nullptr;
+    float animationTime = 0.0f;
+    float playbackSpeed = 1.0f;
+    glm::vec3 position = glm::vec3(0.0f);   // world-space centre used for LOD
+    glm::mat4 transform = glm::mat4(1.0f);  // model to world, places the pose bounds for culling
+    float boundingRadius = 1.0f;            // culling radius around position until a pose is evaluated
+    BoundingVolume bounds;                  // model-space bounds of the last evaluated pose
+    unsigned int paletteOffset = 0;   // first matrix in AnimationSystem::GetPalettes()
+    unsigned int paletteSize = 0;
+    int lod = 0;
+    bool visible = false;
+    unsigned int blendStep = 0;       // progress through the current reduced-rate interval
+    unsigned int blendSteps = 0;
+    std::shared_ptr<const StreamedClip> clip;   // played instead of the model's own clip when set
+};
+
+struct AnimationLODLevel {
+    float maxDistance;          // instances up to this distance from the viewer use the level
+    unsigned int updateInterval; // evaluate every Nth frame, interpolating palettes in between
+    bool reducedSkeleton;       // skip detail bones such as fingers
+};
+
+struct AnimationLODSettings {
+    std::vector<AnimationLODLevel> levels = {
+        { 15.0f, 1, false },
+        { 30.0f, 2, false },
+        { 60.0f, 4, true }
+    };
+    std::vector<std::string> detailBonePatterns = {
+        "Thumb", "Index", "Middle", "Ring", "Pinky", "_End"
+    };
+};
+
+struct AnimationStats {
+    unsigned int instancesEvaluated = 0;
+    unsigned int instancesInterpolated = 0;
+    unsigned int instancesCulled = 0;
+    unsigned int bonesEvaluated = 0;
+    unsigned int posesFromCache = 0;
+};
+
+// Evaluates the poses of many character instances in parallel. Every
+// instance owns a fixed range of one contiguous palette buffer, so results
+// do not depend on which worker evaluated them and the whole buffer can be
+// uploaded in one go.
+//
+// Each evaluated pose also yields tight bounds (SkinnedBounds) that the
+// next frame's culling tests and gameplay can use for collision.
+//
+// Once a viewer is set, instances outside the frustum are not evaluated and
+// distant ones follow the LOD levels: reduced update rates blend between two
+// evaluated palettes and far levels skip detail bones. With the pose cache
+// enabled, instances playing the same clip at the same quantized time and
+// LOD share one evaluation.
+//
+// Update() decides on the calling thread which instances need a pose and
+// resolves them against the pose cache; the workers then evaluate the
+// distinct poses and, in a second pass, copy, blend and bound them per
+// instance, without locks.
+class AnimationSystem {
+public:
+    explicit AnimationSystem(unsigned int threadCount = 0);
+
+    int AddInstance(Model* model, float startTime = 0.0f);
+    CharacterInstance& GetInstance(int id);
+    unsigned int GetInstanceCount() const;
+
+    void SetLODSettings(const AnimationLODSettings& settings);
+    void SetPoseCacheSettings(const PoseCacheSettings& settings);
+    void SetViewer(const glm::vec3& position, const Frustum& frustum);
+    void Update(float deltaTime);
+
+    const glm::mat4* GetPalette(int id) const;
+    const std::vector<glm::mat4>& GetPalettes() const;
+    const AnimationStats& GetStats() const;
+    PoseCacheStats GetPoseCacheStats() const;
+
+private:
+    JobSystem jobs;
+    std::vector<CharacterInstance> instances;
+    std::vector<glm::mat4> palettes;
+    std::vector<glm::mat4> blendPalettes;   // previous and target palette per instance
+    std::vector<std::vector<glm::mat4>> workerNodeGlobals;
+    std::vector<AnimationStats> workerStats;
+    AnimationStats stats;
+    PoseCache poseCache;
+
+    // Work for each instance this frame, decided before the workers start
+    enum class PoseUpdate {
+        None,         // culled or not animated
+        Evaluate,     // pose straight into the palette
+        StartBlend,   // pose into the blend target, then blend
+        Blend         // blend between the poses already there
+    };
+    std::vector<PoseUpdate> updates;
+    std::vector<int> instanceRequests;   // index into poseRequests, or -1
+    std::vector<PoseRequest> poseRequests;
+
+    AnimationLODSettings lodSettings;
+    bool hasViewer = false;
+    glm::vec3 viewerPosition;
+    Frustum viewFrustum;
+
+    int SelectLOD(const CharacterInstance& instance) const;
+    bool IsInView(const CharacterInstance& instance) const;
+    void PlanInstances(float deltaTime);
+    void AddPoseRequest(unsigned int instance, float animationTime, bool reducedSkeleton, glm::mat4* output);
+    void EvaluatePoses(unsigned int begin, unsigned int end, unsigned int worker);
+    void FinishInstances(unsigned int begin, unsigned int end);
+};
+
+#endif
@@ -0,0 +1,109 @@
+#include "bone_palette.h"
+#include "cpu_skinning.h"
+#include "gl_state.h"
+
+#include <algorithm>
+#include <iostream>
+
+BonePaletteBuffer::BonePaletteBuffer(unsigned int regionSize)
+    : regionTexels(FitRegionTexels(regionSize)), stream(regionTexels * sizeof(glm::vec4)) {
+    glGenTextures(1, &texture);
+    GLStateCache::Get().BindTexture(BONE_PALETTE_TEXTURE_UNIT, GL_TEXTURE_BUFFER, texture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, stream.GetBuffer());
+}
+
+BonePaletteBuffer::~BonePaletteBuffer() {
+    glDeleteTextures(1, &texture);
+    GLStateCache::Get().Invalidate();
+}
+
+void BonePaletteBuffer::Begin() {
+    stream.BeginFrame();
+    staging.clear();
+    baseTexel = stream.GetWriteOffset(sizeof(glm::vec4)) / sizeof(glm::vec4);
+}
+
+unsigned int BonePaletteBuffer::Add(const glm::mat4* palette, unsigned int boneCount, SkinningMode mode) {
+    return AddBones(palette, NULL, boneCount, mode);
+}
+
+unsigned int BonePaletteBuffer::Add(const glm::mat4* palette, const std::vector<unsigned int>& boneMap, SkinningMode mode) {
+    return AddBones(palette, boneMap.data(), (unsigned int)boneMap.size(), mode);
+}
+
+unsigned int BonePaletteBuffer::AddBones(const glm::mat4* palette, const unsigned int* boneMap, unsigned int boneCount, SkinningMode mode) {
+    unsigned int offset = (unsigned int)staging.size();
+    unsigned int texelsPerBone = TexelsPerBone(mode);
+    if (offset + boneCount * texelsPerBone > regionTexels) {
+        std::cout << "ERROR::BONE_PALETTE::TOO_MANY_BONES: " << boneCount << " bones do not fit in "
+                  << regionTexels << " texels" << std::endl;
+        boneCount = (regionTexels - std::min(offset, regionTexels)) / texelsPerBone;
+    }
+
+    if (boneCount == 0) return baseTexel + offset;
+
+    staging.resize(offset + boneCount * texelsPerBone);
+    glm::vec4* out = &staging[offset];
+
+    for (unsigned int b = 0; b < boneCount; b++) {
+        const glm::mat4& m = palette[boneMap ? boneMap[b] : b];
+        if (mode == SkinningMode::DualQuaternion) {
+            DualQuaternionFromMatrix(m, out[b * 2], out[b * 2 + 1]);
+        }
+        else {
+            // Drop the constant last row: bone n occupies texels 3n..3n+2
+            for (int row = 0; row < 3; row++) {
+                out[b * 3 + row] = glm::vec4(m[0][row], m[1][row], m[2][row], m[3][row]);
+            }
+        }
+    }
+    return baseTexel + offset;
+}
+
+void BonePaletteBuffer::Finish() {
+    uploadedBytes = (unsigned int)(staging.size() * sizeof(glm::vec4));
+    if (uploadedBytes == 0) return;
+
+    // Add() keeps the palettes within the region, and nothing else writes to it
+    stream.Write(staging.data(), uploadedBytes, sizeof(glm::vec4));
+}
+
+void BonePaletteBuffer::Upload(const glm::mat4* palette, unsigned int boneCount, SkinningMode mode) {
+    Begin();
+    Add(palette, boneCount, mode);
+    Finish();
+}
+
+void BonePaletteBuffer::Bind() const {
+    GLStateCache::Get().BindTexture(BONE_PALETTE_TEXTURE_UNIT, GL_TEXTURE_BUFFER, texture);
+}
+
+unsigned int BonePaletteBuffer::GetMaxTexels() const {
+    return regionTexels;
+}
+
+unsigned int BonePaletteBuffer::GetUploadedBytes() const {
+    return uploadedBytes;
+}
+
+const StreamBuffer& BonePaletteBuffer::GetStream() const {
+    return stream;
+}
+
+unsigned int BonePaletteBuffer::TexelsPerBone(SkinningMode mode) {
+    return mode == SkinningMode::DualQuaternion ? 2 : 3;
+}
+
+// Every region has to lie below the texel limit, not just the first one
+unsigned int BonePaletteBuffer::FitRegionTexels(unsigned int regionSize) {
+    GLint maxTexels = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxTexels);
+    unsigned int limit = (unsigned int)maxTexels / StreamBuffer::REGION_COUNT;
+    unsigned int texels = regionSize / sizeof(glm::vec4);
+    if (texels > limit) {
+        std::cout << "ERROR::BONE_PALETTE::REGION_TOO_LARGE: " << texels << " texels per frame reduced to "
+                  << limit << std::endl;
+        texels = limit;
+    }
+    return texels;
+}
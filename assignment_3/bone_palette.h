@@ -0,0 +1,63 @@
+#ifndef BONE_PALETTE_H
+#define BONE_PALETTE_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "mesh.h"
+#include "stream_buffer.h"
+
+#include <vector>
+
+// Texture unit reserved for the bone palette; material textures use the
+// units below it.
+#define BONE_PALETTE_TEXTURE_UNIT 8
+
+// Bone palettes stored in a texture buffer of RGBA32F texels. Linear blend
+// palettes take three texels per bone (the rows of a 3x4 matrix), dual
+// quaternion palettes take two (real and dual part). Palettes of every
+// character are appended between Begin() and Finish() and go up in a single
+// write to the frame's region of a StreamBuffer; shaders fetch bones with
+// texelFetch from the texel offset Add() returned, so the bone limit is the
+// texture buffer size rather than a uniform array length.
+//
+// glTexBuffer always starts at the buffer's first byte and only
+// GL_MAX_TEXTURE_BUFFER_SIZE texels are addressable, which GL only
+// guarantees to be 65536. The palettes therefore have a StreamBuffer of their
+// own instead of sharing the frame's, with regions shrunk until all of them
+// fit under that limit. Begin() moves it to its next region, so it is
+// called once per frame.
+class BonePaletteBuffer {
+public:
+    // regionSize is in bytes and is reduced to what the texture can address
+    explicit BonePaletteBuffer(unsigned int regionSize);
+    ~BonePaletteBuffer();
+
+    void Begin();
+    unsigned int Add(const glm::mat4* palette, unsigned int boneCount, SkinningMode mode = SkinningMode::Linear);
+    // Appends only the bones a mesh references, in the mesh's palette order
+    unsigned int Add(const glm::mat4* palette, const std::vector<unsigned int>& boneMap, SkinningMode mode = SkinningMode::Linear);
+    void Finish();
+    void Upload(const glm::mat4* palette, unsigned int boneCount, SkinningMode mode = SkinningMode::Linear);
+
+    void Bind() const;
+    // Texels one frame's palettes may take
+    unsigned int GetMaxTexels() const;
+    unsigned int GetUploadedBytes() const;
+    const StreamBuffer& GetStream() const;
+
+    static unsigned int TexelsPerBone(SkinningMode mode);
+
+private:
+    unsigned int regionTexels;
+    StreamBuffer stream;
+    unsigned int texture = 0;
+    unsigned int baseTexel = 0;   // where this frame's palettes go in the stream
+    unsigned int uploadedBytes = 0;
+    std::vector<glm::vec4> staging;
+
+    static unsigned int FitRegionTexels(unsigned int regionSize);
+    unsigned int AddBones(const glm::mat4* palette, const unsigned int* boneMap, unsigned int boneCount, SkinningMode mode);
+};
+
+#endif
@@ -0,0 +1,494 @@
+#include "clip_compressor.h"
+#include "model.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+
+static const float SQRT2 = 1.41421356f;
+
+static uint16_t QuantizeTime(double time, float duration) {
+    if (duration <= 0.0f) return 0;
+    float normalized = glm::clamp((float)(time / duration), 0.0f, 1.0f);
+    return (uint16_t)(normalized * 65535.0f + 0.5f);
+}
+
+static uint16_t QuantizeRange(float value, float min, float extent) {
+    if (extent <= 0.0f) return 0;
+    float normalized = glm::clamp((value - min) / extent, 0.0f, 1.0f);
+    return (uint16_t)(normalized * 65535.0f + 0.5f);
+}
+
+static glm::vec3 DecodeVector(const uint16_t* packed, const glm::vec3& min, const glm::vec3& extent) {
+    return glm::vec3(min.x + extent.x * (packed[0] / 65535.0f),
+                     min.y + extent.y * (packed[1] / 65535.0f),
+                     min.z + extent.z * (packed[2] / 65535.0f));
+}
+
+// Normalized lerp along the shortest arc; used both at runtime and while
+// measuring reduction error so the two always agree.
+static glm::quat BlendRotations(const glm::quat& a, const glm::quat& b, float factor) {
+    glm::quat end = glm::dot(a, b) < 0.0f ? -b : b;
+    return glm::normalize(a * (1.0f - factor) + end * factor);
+}
+
+static float RotationAngle(const glm::quat& a, const glm::quat& b) {
+    float d = std::min(1.0f, std::fabs(glm::dot(a, b)));
+    return 2.0f * std::acos(d);
+}
+
+static float MaxComponent(const glm::vec3& v) {
+    return std::max(std::fabs(v.x), std::max(std::fabs(v.y), std::fabs(v.z)));
+}
+
+// Finds the key segment containing time (in quantized units) and the blend
+// factor inside it. Returns the index of the first key of the segment.
+static unsigned int FindSegment(const std::vector<uint16_t>& times, float time, float& factor) {
+    factor = 0.0f;
+    if (times.size() < 2) return 0;
+
+    unsigned int next = (unsigned int)(std::upper_bound(times.begin(), times.end(), time) - times.begin());
+    if (next == 0) return 0;
+    if (next >= times.size()) return (unsigned int)times.size() - 1;
+
+    unsigned int index = next - 1;
+    float span = (float)(times[next] - times[index]);
+    factor = span > 0.0f ? (time - times[index]) / span : 0.0f;
+    return index;
+}
+
+// Error-bounded key reduction: keep both ends of a span, find the key whose
+// reconstruction from those ends is worst, and split there while it exceeds
+// the tolerance.
+template <typename ErrorFn>
+static void ReduceKeys(int first, int last, float tolerance, ErrorFn error, std::vector<bool>& keep) {
+    if (last - first < 2) return;
+
+    float worstError = 0.0f;
+    int worstKey = -1;
+    for (int k = first + 1; k < last; k++) {
+        float e = error(first, last, k);
+        if (e > worstError) {
+            worstError = e;
+            worstKey = k;
+        }
+    }
+
+    if (worstError > tolerance) {
+        keep[worstKey] = true;
+        ReduceKeys(first, worstKey, tolerance, error, keep);
+        ReduceKeys(worstKey, last, tolerance, error, keep);
+    }
+}
+
+// ===================== CompressedClip =====================
+
+int CompressedClip::FindTrack(const std::string& nodeName) const {
+    for (size_t i = 0; i < tracks.size(); i++) {
+        if (tracks[i].nodeName == nodeName) return (int)i;
+    }
+    return -1;
+}
+
+void CompressedClip::Sample(int trackIndex, float animationTime, glm::vec3& position, glm::quat& rotation, glm::vec3& scale) const {
+    const CompressedTrack& track = tracks[trackIndex];
+    float time = duration > 0.0f ? animationTime / duration * 65535.0f : 0.0f;
+    float factor;
+
+    if (track.positionTimes.empty()) {
+        position = glm::vec3(0.0f);
+    } else {
+        unsigned int key = FindSegment(track.positionTimes, time, factor);
+        position = DecodeVector(&track.positionKeys[key * 3], track.positionMin, track.positionExtent);
+        if (factor > 0.0f) {
+            glm::vec3 next = DecodeVector(&track.positionKeys[key * 3 + 3], track.positionMin, track.positionExtent);
+            position += (next - position) * factor;
+        }
+    }
+
+    if (track.rotationTimes.empty()) {
+        rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+    } else {
+        unsigned int key = FindSegment(track.rotationTimes, time, factor);
+        rotation = DecodeRotation(&track.rotationKeys[key * 3]);
+        if (factor > 0.0f) {
+            rotation = BlendRotations(rotation, DecodeRotation(&track.rotationKeys[key * 3 + 3]), factor);
+        }
+    }
+
+    if (track.scaleTimes.empty()) {
+        scale = glm::vec3(1.0f);
+    } else {
+        unsigned int key = FindSegment(track.scaleTimes, time, factor);
+        scale = DecodeVector(&track.scaleKeys[key * 3], track.scaleMin, track.scaleExtent);
+        if (factor > 0.0f) {
+            glm::vec3 next = DecodeVector(&track.scaleKeys[key * 3 + 3], track.scaleMin, track.scaleExtent);
+            scale += (next - scale) * factor;
+        }
+    }
+}
+
+size_t CompressedClip::GetMemoryUsage() const {
+    size_t bytes = 0;
+    for (const auto& track : tracks) {
+        bytes += (track.positionTimes.size() + track.positionKeys.size()) * sizeof(uint16_t);
+        bytes += (track.rotationTimes.size() + track.rotationKeys.size()) * sizeof(uint16_t);
+        bytes += (track.scaleTimes.size() + track.scaleKeys.size()) * sizeof(uint16_t);
+        bytes += 4 * sizeof(glm::vec3);
+    }
+    return bytes;
+}
+
+void CompressedClip::EncodeRotation(const glm::quat& rotation, uint16_t* packed) {
+    glm::quat q = glm::normalize(rotation);
+
+    int largest = 0;
+    for (int i = 1; i < 4; i++) {
+        if (std::fabs(q[i]) > std::fabs(q[largest])) largest = i;
+    }
+    // q and -q are the same rotation, so the dropped component is always positive
+    float sign = q[largest] < 0.0f ? -1.0f : 1.0f;
+
+    uint16_t components[3];
+    int j = 0;
+    for (int i = 0; i < 4; i++) {
+        if (i == largest) continue;
+        float v = q[i] * sign * SQRT2;   // [-1, 1]
+        components[j++] = (uint16_t)glm::clamp((int)((v * 0.5f + 0.5f) * 32767.0f + 0.5f), 0, 32767);
+    }
+
+    packed[0] = components[0] | (uint16_t)((largest >> 1) << 15);
+    packed[1] = components[1] | (uint16_t)((largest & 1) << 15);
+    packed[2] = components[2];
+}
+
+glm::quat CompressedClip::DecodeRotation(const uint16_t* packed) {
+    int largest = ((packed[0] >> 15) << 1) | (packed[1] >> 15);
+
+    float v[3];
+    float sum = 0.0f;
+    for (int k = 0; k < 3; k++) {
+        v[k] = ((packed[k] & 0x7fff) / 32767.0f * 2.0f - 1.0f) / SQRT2;
+        sum += v[k] * v[k];
+    }
+
+    glm::quat q;
+    int j = 0;
+    for (int i = 0; i < 4; i++) {
+        q[i] = i == largest ? std::sqrt(std::max(0.0f, 1.0f - sum)) : v[j++];
+    }
+    return q;
+}
+
+// ===================== ClipCompressor =====================
+
+// Channel of the animation driving each skeleton node, matched by name so
+// clips loaded from other files compress against the same skeleton
+static std::vector<const aiNodeAnim*> FindChannels(const std::vector<SkeletonNode>& skeleton, const aiAnimation* animation) {
+    std::vector<const aiNodeAnim*> channels(skeleton.size(), nullptr);
+    for (size_t i = 0; i < skeleton.size(); i++) {
+        for (unsigned int c = 0; c < animation->mNumChannels; c++) {
+            if (skeleton[i].name == animation->mChannels[c]->mNodeName.C_Str()) {
+                channels[i] = animation->mChannels[c];
+                break;
+            }
+        }
+    }
+    return channels;
+}
+
+ClipCompressor::ClipCompressor(const ClipCompressionSettings& settings) : settings(settings) {}
+
+bool ClipCompressor::Compress(const Model& model, const aiAnimation* animation, CompressedClip& clip, ClipCompressionReport& report) {
+    if (!animation || model.skeleton.empty() || animation->mDuration <= 0.0) {
+        return false;
+    }
+
+    const std::vector<SkeletonNode>& skeleton = model.skeleton;
+    size_t nodeCount = skeleton.size();
+    std::vector<const aiNodeAnim*> channels = FindChannels(skeleton, animation);
+
+    // Bind pose in model space
+    std::vector<glm::mat4> bindGlobals(nodeCount);
+    for (size_t i = 0; i < nodeCount; i++) {
+        const glm::mat4& parent = skeleton[i].parent >= 0 ? bindGlobals[skeleton[i].parent] : model.globalInverseTransform;
+        bindGlobals[i] = parent * skeleton[i].transformation;
+    }
+
+    // Scale of each node's local space in model space and the reach of each
+    // joint: how far a rotation at the joint can move the skin below it.
+    std::vector<float> nodeScales(nodeCount);
+    std::vector<float> reach(nodeCount, settings.virtualVertexDistance);
+    for (size_t i = 0; i < nodeCount; i++) {
+        glm::mat3 basis(bindGlobals[i]);
+        nodeScales[i] = std::max(glm::length(basis[0]), std::max(glm::length(basis[1]), glm::length(basis[2])));
+
+        glm::vec3 position(bindGlobals[i][3]);
+        for (int a = skeleton[i].parent; a >= 0; a = skeleton[a].parent) {
+            float d = glm::length(position - glm::vec3(bindGlobals[a][3])) + settings.virtualVertexDistance;
+            reach[a] = std::max(reach[a], d);
+        }
+    }
+
+    // Errors of animated ancestors add up down the chain, so each bone's
+    // tolerance is split evenly over the animated nodes above it, and every
+    // node takes the tightest budget of anything below it.
+    std::vector<int> chainDepth(nodeCount, 0);
+    std::vector<float> budget(nodeCount);
+    for (size_t i = 0; i < nodeCount; i++) {
+        int parentDepth = skeleton[i].parent >= 0 ? chainDepth[skeleton[i].parent] : 0;
+        chainDepth[i] = parentDepth + (channels[i] ? 1 : 0);
+
+        auto custom = settings.boneTolerances.find(skeleton[i].name);
+        float tolerance = custom != settings.boneTolerances.end() ? custom->second : settings.tolerance;
+        budget[i] = tolerance / std::max(chainDepth[i], 1);
+    }
+    for (size_t i = nodeCount; i-- > 1;) {
+        int parent = skeleton[i].parent;
+        if (parent >= 0) budget[parent] = std::min(budget[parent], budget[i]);
+    }
+
+    clip.name = animation->mName.C_Str();
+    clip.duration = (float)animation->mDuration;
+    clip.ticksPerSecond = animation->mTicksPerSecond != 0 ? (float)animation->mTicksPerSecond : 25.0f;
+    clip.tracks.clear();
+
+    report = ClipCompressionReport();
+    report.clipName = clip.name;
+
+    for (size_t i = 0; i < nodeCount; i++) {
+        const aiNodeAnim* channel = channels[i];
+        if (!channel) continue;
+
+        // Translation, rotation and scale share the node's budget
+        float nodeBudget = budget[i] / 3.0f;
+        float parentScale = skeleton[i].parent >= 0 ? nodeScales[skeleton[i].parent] : 1.0f;
+
+        CompressedTrack track;
+        track.nodeName = skeleton[i].name;
+        CompressPositions(channel, clip.duration, nodeBudget / std::max(parentScale, 1e-6f), track);
+        CompressRotations(channel, clip.duration, nodeBudget / reach[i], track);
+        CompressScales(channel, clip.duration, nodeBudget / reach[i], track);
+        clip.tracks.push_back(track);
+
+        report.rawKeys += channel->mNumPositionKeys + channel->mNumRotationKeys + channel->mNumScalingKeys;
+        report.rawBytes += channel->mNumPositionKeys * sizeof(aiVectorKey) +
+                           channel->mNumRotationKeys * sizeof(aiQuatKey) +
+                           channel->mNumScalingKeys * sizeof(aiVectorKey);
+        report.compressedKeys += track.positionTimes.size() + track.rotationTimes.size() + track.scaleTimes.size();
+    }
+
+    report.compressedBytes = clip.GetMemoryUsage();
+    report.compressionRatio = report.compressedBytes > 0 ? (float)report.rawBytes / report.compressedBytes : 0.0f;
+    MeasureError(model, channels, clip, nodeScales, report);
+    return true;
+}
+
+void ClipCompressor::CompressPositions(const aiNodeAnim* channel, float duration, float tolerance, CompressedTrack& track) {
+    unsigned int count = channel->mNumPositionKeys;
+    track.positionMin = glm::vec3(0.0f);
+    track.positionExtent = glm::vec3(0.0f);
+    if (count == 0) return;
+
+    std::vector<glm::vec3> raw(count);
+    glm::vec3 max;
+    for (unsigned int k = 0; k < count; k++) {
+        const aiVector3D& v = channel->mPositionKeys[k].mValue;
+        raw[k] = glm::vec3(v.x, v.y, v.z);
+        track.positionMin = k == 0 ? raw[k] : glm::min(track.positionMin, raw[k]);
+        max = k == 0 ? raw[k] : glm::max(max, raw[k]);
+    }
+    track.positionExtent = max - track.positionMin;
+
+    std::vector<uint16_t> times(count), keys(count * 3);
+    std::vector<glm::vec3> decoded(count);
+    for (unsigned int k = 0; k < count; k++) {
+        times[k] = QuantizeTime(channel->mPositionKeys[k].mTime, duration);
+        for (int c = 0; c < 3; c++) {
+            keys[k * 3 + c] = QuantizeRange(raw[k][c], track.positionMin[c], track.positionExtent[c]);
+        }
+        decoded[k] = DecodeVector(&keys[k * 3], track.positionMin, track.positionExtent);
+    }
+
+    std::vector<bool> keep(count, false);
+    keep[0] = true;
+    bool constant = true;
+    for (unsigned int k = 1; k < count && constant; k++) {
+        constant = glm::length(raw[k] - decoded[0]) <= tolerance;
+    }
+    if (!constant) {
+        keep[count - 1] = true;
+        ReduceKeys(0, (int)count - 1, tolerance, [&](int a, int b, int k) {
+            float span = (float)(times[b] - times[a]);
+            float factor = span > 0.0f ? (times[k] - times[a]) / span : 0.0f;
+            return glm::length(decoded[a] + (decoded[b] - decoded[a]) * factor - raw[k]);
+        }, keep);
+    }
+
+    for (unsigned int k = 0; k < count; k++) {
+        if (!keep[k]) continue;
+        track.positionTimes.push_back(times[k]);
+        track.positionKeys.insert(track.positionKeys.end(), &keys[k * 3], &keys[k * 3] + 3);
+    }
+}
+
+void ClipCompressor::CompressRotations(const aiNodeAnim* channel, float duration, float tolerance, CompressedTrack& track) {
+    unsigned int count = channel->mNumRotationKeys;
+    if (count == 0) return;
+
+    std::vector<glm::quat> raw(count), decoded(count);
+    std::vector<uint16_t> times(count), keys(count * 3);
+    for (unsigned int k = 0; k < count; k++) {
+        const aiQuaternion& q = channel->mRotationKeys[k].mValue;
+        raw[k] = glm::normalize(glm::quat(q.w, q.x, q.y, q.z));
+        times[k] = QuantizeTime(channel->mRotationKeys[k].mTime, duration);
+        CompressedClip::EncodeRotation(raw[k], &keys[k * 3]);
+        decoded[k] = CompressedClip::DecodeRotation(&keys[k * 3]);
+    }
+
+    std::vector<bool> keep(count, false);
+    keep[0] = true;
+    bool constant = true;
+    for (unsigned int k = 1; k < count && constant; k++) {
+        constant = RotationAngle(raw[k], decoded[0]) <= tolerance;
+    }
+    if (!constant) {
+        keep[count - 1] = true;
+        ReduceKeys(0, (int)count - 1, tolerance, [&](int a, int b, int k) {
+            float span = (float)(times[b] - times[a]);
+            float factor = span > 0.0f ? (times[k] - times[a]) / span : 0.0f;
+            return RotationAngle(BlendRotations(decoded[a], decoded[b], factor), raw[k]);
+        }, keep);
+    }
+
+    for (unsigned int k = 0; k < count; k++) {
+        if (!keep[k]) continue;
+        track.rotationTimes.push_back(times[k]);
+        track.rotationKeys.insert(track.rotationKeys.end(), &keys[k * 3], &keys[k * 3] + 3);
+    }
+}
+
+void ClipCompressor::CompressScales(const aiNodeAnim* channel, float duration, float tolerance, CompressedTrack& track) {
+    unsigned int count = channel->mNumScalingKeys;
+    track.scaleMin = glm::vec3(1.0f);
+    track.scaleExtent = glm::vec3(0.0f);
+    if (count == 0) return;
+
+    std::vector<glm::vec3> raw(count);
+    glm::vec3 max;
+    for (unsigned int k = 0; k < count; k++) {
+        const aiVector3D& v = channel->mScalingKeys[k].mValue;
+        raw[k] = glm::vec3(v.x, v.y, v.z);
+        track.scaleMin = k == 0 ? raw[k] : glm::min(track.scaleMin, raw[k]);
+        max = k == 0 ? raw[k] : glm::max(max, raw[k]);
+    }
+    track.scaleExtent = max - track.scaleMin;
+
+    std::vector<uint16_t> times(count), keys(count * 3);
+    std::vector<glm::vec3> decoded(count);
+    for (unsigned int k = 0; k < count; k++) {
+        times[k] = QuantizeTime(channel->mScalingKeys[k].mTime, duration);
+        for (int c = 0; c < 3; c++) {
+            keys[k * 3 + c] = QuantizeRange(raw[k][c], track.scaleMin[c], track.scaleExtent[c]);
+        }
+        decoded[k] = DecodeVector(&keys[k * 3], track.scaleMin, track.scaleExtent);
+    }
+
+    std::vector<bool> keep(count, false);
+    keep[0] = true;
+    bool constant = true;
+    for (unsigned int k = 1; k < count && constant; k++) {
+        constant = MaxComponent(raw[k] - decoded[0]) <= tolerance;
+    }
+    if (!constant) {
+        keep[count - 1] = true;
+        ReduceKeys(0, (int)count - 1, tolerance, [&](int a, int b, int k) {
+            float span = (float)(times[b] - times[a]);
+            float factor = span > 0.0f ? (times[k] - times[a]) / span : 0.0f;
+            return MaxComponent(decoded[a] + (decoded[b] - decoded[a]) * factor - raw[k]);
+        }, keep);
+    }
+
+    for (unsigned int k = 0; k < count; k++) {
+        if (!keep[k]) continue;
+        track.scaleTimes.push_back(times[k]);
+        track.scaleKeys.insert(track.scaleKeys.end(), &keys[k * 3], &keys[k * 3] + 3);
+    }
+}
+
+// Evaluates the raw and compressed clip side by side and records the largest
+// model-space distance between a joint (or its virtual skin vertices) in the
+// two poses.
+void ClipCompressor::MeasureError(const Model& model, const std::vector<const aiNodeAnim*>& channels, const CompressedClip& clip,
+                                  const std::vector<float>& nodeScales, ClipCompressionReport& report) {
+    const std::vector<SkeletonNode>& skeleton = model.skeleton;
+    size_t nodeCount = skeleton.size();
+
+    std::vector<int> tracks(nodeCount);
+    unsigned int maxKeys = 2;
+    for (size_t i = 0; i < nodeCount; i++) {
+        tracks[i] = clip.FindTrack(skeleton[i].name);
+        const aiNodeAnim* channel = channels[i];
+        if (channel) {
+            maxKeys = std::max(maxKeys, std::max(channel->mNumPositionKeys, channel->mNumRotationKeys));
+        }
+    }
+
+    std::vector<glm::mat4> rawGlobals(nodeCount), compressedGlobals(nodeCount);
+    unsigned int samples = maxKeys * 2;
+
+    for (unsigned int s = 0; s < samples; s++) {
+        float time = clip.duration * s / samples;
+
+        for (size_t i = 0; i < nodeCount; i++) {
+            const SkeletonNode& node = skeleton[i];
+            glm::mat4 rawLocal = node.transformation;
+            glm::mat4 compressedLocal = node.transformation;
+
+            if (channels[i] && tracks[i] >= 0) {
+                rawLocal = glm::translate(glm::mat4(1.0f), model.InterpolatePosition(time, channels[i])) *
+                           glm::mat4_cast(model.InterpolateRotation(time, channels[i])) *
+                           glm::scale(glm::mat4(1.0f), model.InterpolateScale(time, channels[i]));
+
+                glm::vec3 position, scale;
+                glm::quat rotation;
+                clip.Sample(tracks[i], time, position, rotation, scale);
+                compressedLocal = glm::translate(glm::mat4(1.0f), position) *
+                                  glm::mat4_cast(rotation) *
+                                  glm::scale(glm::mat4(1.0f), scale);
+            }
+
+            const glm::mat4& rawParent = node.parent >= 0 ? rawGlobals[node.parent] : model.globalInverseTransform;
+            const glm::mat4& compressedParent = node.parent >= 0 ? compressedGlobals[node.parent] : model.globalInverseTransform;
+            rawGlobals[i] = rawParent * rawLocal;
+            compressedGlobals[i] = compressedParent * compressedLocal;
+
+            if (node.boneIndex < 0) continue;
+
+            // Joint plus one virtual vertex along each local axis
+            float offset = settings.virtualVertexDistance / std::max(nodeScales[i], 1e-6f);
+            glm::vec4 points[4] = {
+                glm::vec4(0.0f, 0.0f, 0.0f, 1.0f),
+                glm::vec4(offset, 0.0f, 0.0f, 1.0f),
+                glm::vec4(0.0f, offset, 0.0f, 1.0f),
+                glm::vec4(0.0f, 0.0f, offset, 1.0f)
+            };
+            for (int p = 0; p < 4; p++) {
+                float error = glm::length(glm::vec3(rawGlobals[i] * points[p]) - glm::vec3(compressedGlobals[i] * points[p]));
+                if (error > report.maxError) {
+                    report.maxError = error;
+                    report.maxErrorBone = node.name;
+                }
+            }
+        }
+    }
+}
+
+void PrintCompressionReport(const ClipCompressionReport& report) {
+    std::cout << "Clip compression: " << report.clipName << std::endl;
+    std::cout << "  Keys: " << report.rawKeys << " -> " << report.compressedKeys << std::endl;
+    std::cout << "  Size: " << report.rawBytes << " -> " << report.compressedBytes << " bytes ("
+              << std::fixed << std::setprecision(2) << report.compressionRatio << ":1)" << std::endl;
+    std::cout << "  Max error: " << std::setprecision(4) << report.maxError
+              << " (" << report.maxErrorBone << ")" << std::defaultfloat << std::endl;
+}
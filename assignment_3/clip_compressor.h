@@ -0,0 +1,89 @@
+#ifndef CLIP_COMPRESSOR_H
+#define CLIP_COMPRESSOR_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <assimp/scene.h>
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+class Model;
+
+struct ClipCompressionSettings {
+    // Maximum model-space error allowed on any bone, in model units
+    // (Mixamo exports are in centimetres).
+    float tolerance = 0.1f;
+    // Per-bone overrides of tolerance, keyed by node name
+    std::map<std::string, float> boneTolerances;
+    // Distance of a virtual skin vertex from its joint, used to turn rotation
+    // and scale error into a displacement
+    float virtualVertexDistance = 3.0f;
+    // Free the importer's full precision keys once the clip is compressed
+    bool releaseSourceKeys = true;
+};
+
+struct ClipCompressionReport {
+    std::string clipName;
+    size_t rawKeys = 0;
+    size_t compressedKeys = 0;
+    size_t rawBytes = 0;
+    size_t compressedBytes = 0;
+    float compressionRatio = 0.0f;
+    float maxError = 0.0f;
+    std::string maxErrorBone;
+};
+
+// Key times are quantized to 16 bits over the clip duration. Rotations are
+// stored smallest-three (2-bit index + 3 x 15 bits), translations and scales
+// as 16 bits per component within the track's own range.
+struct CompressedTrack {
+    std::string nodeName;
+    std::vector<uint16_t> positionTimes;
+    std::vector<uint16_t> positionKeys;     // 3 per key
+    glm::vec3 positionMin;
+    glm::vec3 positionExtent;
+    std::vector<uint16_t> rotationTimes;
+    std::vector<uint16_t> rotationKeys;     // 3 per key
+    std::vector<uint16_t> scaleTimes;
+    std::vector<uint16_t> scaleKeys;        // 3 per key
+    glm::vec3 scaleMin;
+    glm::vec3 scaleExtent;
+};
+
+class CompressedClip {
+public:
+    std::string name;
+    float duration = 0.0f;
+    float ticksPerSecond = 25.0f;
+    std::vector<CompressedTrack> tracks;
+
+    int FindTrack(const std::string& nodeName) const;
+    void Sample(int track, float animationTime, glm::vec3& position, glm::quat& rotation, glm::vec3& scale) const;
+    size_t GetMemoryUsage() const;
+
+    static void EncodeRotation(const glm::quat& rotation, uint16_t* packed);
+    static glm::quat DecodeRotation(const uint16_t* packed);
+};
+
+class ClipCompressor {
+public:
+    ClipCompressor(const ClipCompressionSettings& settings);
+
+    bool Compress(const Model& model, const aiAnimation* animation, CompressedClip& clip, ClipCompressionReport& report);
+
+private:
+    ClipCompressionSettings settings;
+
+    void CompressPositions(const aiNodeAnim* channel, float duration, float tolerance, CompressedTrack& track);
+    void CompressRotations(const aiNodeAnim* channel, float duration, float tolerance, CompressedTrack& track);
+    void CompressScales(const aiNodeAnim* channel, float duration, float tolerance, CompressedTrack& track);
+    void MeasureError(const Model& model, const std::vector<const aiNodeAnim*>& channels, const CompressedClip& clip,
+                      const std::vector<float>& nodeScales, ClipCompressionReport& report);
+};
+
+void PrintCompressionReport(const ClipCompressionReport& report);
+
+#endif
@@ -0,0 +1,206 @@
+#include "clip_streamer.h"
+#include "model.h"
+
+#include <assimp/Importer.hpp>
+#include <assimp/scene.h>
+
+#include <chrono>
+#include <cmath>
+#include <iostream>
+
+float StreamedClip::AdvanceTime(float animationTime, float deltaTime) const {
+    if (clip.duration <= 0.0f) return animationTime;
+    return fmod(animationTime + deltaTime * clip.ticksPerSecond, clip.duration);
+}
+
+ClipStreamer::ClipStreamer(const Model& model, size_t memoryBudget, const ClipCompressionSettings& settings)
+    : model(model), settings(settings) {
+    stats.budgetBytes = memoryBudget;
+    loader = std::thread(&ClipStreamer::LoaderLoop, this);
+}
+
+ClipStreamer::~ClipStreamer() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        quit = true;
+    }
+    work.notify_all();
+    loader.join();
+}
+
+int ClipStreamer::Register(const std::string& name, const std::string& path, unsigned int animationIndex) {
+    std::lock_guard<std::mutex> lock(mutex);
+    Entry entry;
+    entry.name = name;
+    entry.path = path;
+    entry.animationIndex = animationIndex;
+    entry.state = ClipState::Unloaded;
+    entry.bytes = 0;
+    entry.lruPosition = lru.end();
+    entries.push_back(entry);
+    return (int)entries.size() - 1;
+}
+
+int ClipStreamer::Find(const std::string& name) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (size_t i = 0; i < entries.size(); i++) {
+        if (entries[i].name == name) return (int)i;
+    }
+    return -1;
+}
+
+void ClipStreamer::Prefetch(int clip) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (clip < 0 || clip >= (int)entries.size()) return;
+    Entry& entry = entries[clip];
+    if (entry.state == ClipState::Unloaded) {
+        entry.state = ClipState::Queued;
+        queue.push_back(clip);
+        work.notify_one();
+    }
+    else if (entry.state == ClipState::Resident) {
+        lru.splice(lru.begin(), lru, entry.lruPosition);
+    }
+}
+
+std::shared_ptr<const StreamedClip> ClipStreamer::Get(int clip) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return RequestLocked(clip);
+}
+
+std::shared_ptr<const StreamedClip> ClipStreamer::Acquire(int clip) {
+    std::unique_lock<std::mutex> lock(mutex);
+    std::shared_ptr<const StreamedClip> result = RequestLocked(clip);
+    if (result || clip < 0 || clip >= (int)entries.size() || entries[clip].state == ClipState::Failed) {
+        return result;
+    }
+
+    auto start = std::chrono::high_resolution_clock::now();
+    while (entries[clip].state != ClipState::Resident && entries[clip].state != ClipState::Failed) {
+        // Another load may have evicted it again before this thread woke up;
+        // entries is indexed each time since Register() may grow it meanwhile
+        if (entries[clip].state == ClipState::Unloaded) {
+            entries[clip].state = ClipState::Queued;
+            queue.push_back(clip);
+            work.notify_one();
+        }
+        loaded.wait(lock);
+    }
+    stats.stalls++;
+    stats.stallMilliseconds += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    return entries[clip].clip;
+}
+
+void ClipStreamer::SetMemoryBudget(size_t bytes) {
+    std::lock_guard<std::mutex> lock(mutex);
+    stats.budgetBytes = bytes;
+    EvictLocked(-1);
+}
+
+ClipStreamerStats ClipStreamer::GetStats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return stats;
+}
+
+// Returns the clip if resident, otherwise queues it and returns null
+std::shared_ptr<const StreamedClip> ClipStreamer::RequestLocked(int clip) {
+    if (clip < 0 || clip >= (int)entries.size()) return nullptr;
+    stats.requests++;
+
+    Entry& entry = entries[clip];
+    if (entry.state == ClipState::Resident) {
+        stats.hits++;
+        lru.splice(lru.begin(), lru, entry.lruPosition);
+        return entry.clip;
+    }
+    if (entry.state == ClipState::Unloaded) {
+        entry.state = ClipState::Queued;
+        queue.push_back(clip);
+        work.notify_one();
+    }
+    return nullptr;
+}
+
+// Drops least recently used clips until the budget holds, never the one just loaded
+void ClipStreamer::EvictLocked(int keep) {
+    while (stats.residentBytes > stats.budgetBytes) {
+        auto victim = lru.end();
+        do {
+            if (victim == lru.begin()) return;
+            --victim;
+        } while (*victim == keep);
+
+        Entry& entry = entries[*victim];
+        stats.residentBytes -= entry.bytes;
+        stats.evictions++;
+        entry.clip.reset();
+        entry.bytes = 0;
+        entry.state = ClipState::Unloaded;
+        entry.lruPosition = lru.end();
+        lru.erase(victim);
+    }
+}
+
+void ClipStreamer::LoaderLoop() {
+    while (true) {
+        int clip;
+        std::string path;
+        unsigned int animationIndex;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            work.wait(lock, [this] { return quit || !queue.empty(); });
+            if (quit) return;
+            clip = queue.front();
+            queue.pop_front();
+            path = entries[clip].path;
+            animationIndex = entries[clip].animationIndex;
+        }
+
+        std::shared_ptr<StreamedClip> result = LoadClip(path, animationIndex);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        Entry& entry = entries[clip];
+        if (!result) {
+            stats.failures++;
+            entry.state = ClipState::Failed;
+        }
+        else {
+            result->serial = nextSerial++;
+            stats.loads++;
+            entry.clip = result;
+            entry.bytes = result->clip.GetMemoryUsage();
+            entry.state = ClipState::Resident;
+            lru.push_front(clip);
+            entry.lruPosition = lru.begin();
+            stats.residentBytes += entry.bytes;
+            EvictLocked(clip);
+        }
+        loaded.notify_all();
+    }
+}
+
+// Runs on the loader thread: imports the file, compresses the clip against
+// the model's skeleton and lets the importer free the raw keys
+std::shared_ptr<StreamedClip> ClipStreamer::LoadClip(const std::string& path, unsigned int animationIndex) {
+    Assimp::Importer importer;
+    const aiScene* clipScene = importer.ReadFile(path, 0);
+    if (!clipScene || animationIndex >= clipScene->mNumAnimations) {
+        std::cout << "ERROR::CLIP_STREAMER::LOAD_FAILED: " << path << " [" << animationIndex << "] "
+                  << importer.GetErrorString() << std::endl;
+        return nullptr;
+    }
+
+    std::shared_ptr<StreamedClip> result(new StreamedClip());
+    ClipCompressionReport report;
+    ClipCompressor compressor(settings);
+    if (!compressor.Compress(model, clipScene->mAnimations[animationIndex], result->clip, report)) {
+        std::cout << "ERROR::CLIP_STREAMER::COMPRESSION_FAILED: " << path << std::endl;
+        return nullptr;
+    }
+
+    result->nodeTracks.resize(model.skeleton.size());
+    for (size_t i = 0; i < model.skeleton.size(); i++) {
+        result->nodeTracks[i] = result->clip.FindTrack(model.skeleton[i].name);
+    }
+    return result;
+}
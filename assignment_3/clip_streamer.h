@@ -0,0 +1,101 @@
+#ifndef CLIP_STREAMER_H
+#define CLIP_STREAMER_H
+
+#include "clip_compressor.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class Model;
+
+// A clip loaded by ClipStreamer, compressed and bound to the streamer's
+// skeleton. Instances keep it alive through shared_ptr even after the
+// streamer evicts it.
+struct StreamedClip {
+    uint64_t serial = 0;            // unique per load, so reloads never alias
+    CompressedClip clip;
+    std::vector<int> nodeTracks;    // track for each Model::skeleton node, -1 if not animated
+
+    float AdvanceTime(float animationTime, float deltaTime) const;
+};
+
+struct ClipStreamerStats {
+    unsigned long long requests = 0;
+    unsigned long long hits = 0;        // requested while resident
+    unsigned long long loads = 0;
+    unsigned long long failures = 0;
+    unsigned long long evictions = 0;
+    unsigned long long stalls = 0;      // Acquire calls that had to wait for a load
+    double stallMilliseconds = 0.0;
+    size_t residentBytes = 0;
+    size_t budgetBytes = 0;
+};
+
+// Loads animation clips on first use instead of with the model. Each clip is
+// a separate file, or one animation of a pack file holding several. Loads
+// run on a background thread, and resident clips are kept in an LRU under a
+// memory budget. Gameplay code calls Prefetch() for clips it expects to need
+// soon ("about to start running"), so Get() finds them resident; Acquire()
+// blocks for clips needed right away and counts the wait as a stall.
+class ClipStreamer {
+public:
+    ClipStreamer(const Model& model, size_t memoryBudget,
+                 const ClipCompressionSettings& settings = ClipCompressionSettings());
+    ~ClipStreamer();
+
+    int Register(const std::string& name, const std::string& path, unsigned int animationIndex = 0);
+    int Find(const std::string& name) const;
+
+    void Prefetch(int clip);
+    std::shared_ptr<const StreamedClip> Get(int clip);
+    std::shared_ptr<const StreamedClip> Acquire(int clip);
+
+    void SetMemoryBudget(size_t bytes);
+    ClipStreamerStats GetStats() const;
+
+private:
+    enum class ClipState {
+        Unloaded,
+        Queued,
+        Resident,
+        Failed
+    };
+
+    struct Entry {
+        std::string name;
+        std::string path;
+        unsigned int animationIndex;
+        ClipState state;
+        std::shared_ptr<const StreamedClip> clip;
+        size_t bytes;
+        std::list<int>::iterator lruPosition;
+    };
+
+    const Model& model;
+    ClipCompressionSettings settings;
+    std::vector<Entry> entries;
+    std::list<int> lru;             // resident clips, most recently used first
+    std::deque<int> queue;
+    ClipStreamerStats stats;
+    uint64_t nextSerial = 1;
+
+    mutable std::mutex mutex;
+    std::condition_variable work;
+    std::condition_variable loaded;
+    bool quit = false;
+    std::thread loader;
+
+    void LoaderLoop();
+    std::shared_ptr<StreamedClip> LoadClip(const std::string& path, unsigned int animationIndex);
+    std::shared_ptr<const StreamedClip> RequestLocked(int clip);
+    void EvictLocked(int keep);
+};
+
+#endif
@@ -0,0 +1,381 @@
+#include "cpu_skinning.h"
+#include "model.h"
+
+#include <glm/gtc/quaternion.hpp>
+
+#include <algorithm>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CPU_SKINNING_X86
+#include <immintrin.h>
+#endif
+
+namespace {
+
+const unsigned int SKINNING_GRAIN = 1024;
+
+// Resolves a vertex's influences the way the shaders do: empty slots and
+// bones outside the palette add nothing, and whatever weight the others do
+// not cover stays in the rest pose, so a vertex without influences is left
+// where it is. Returns that rest weight. Slots that add nothing get bone 0
+// with weight 0 so the vector kernels can blend all four unconditionally;
+// the palette must not be empty.
+inline float ResolveInfluences(const Vertex& vertex, unsigned int boneCount, int* ids, float* weights) {
+    float totalWeight = 0.0f;
+    for (int i = 0; i < MAX_BONE_INFLUENCE; i++) {
+        int id = vertex.BoneIDs[i];
+        if (id < 0 || (unsigned int)id >= boneCount) {
+            ids[i] = 0;
+            weights[i] = 0.0f;
+            continue;
+        }
+        ids[i] = id;
+        weights[i] = vertex.Weights[i];
+        totalWeight += vertex.Weights[i];
+    }
+    return 1.0f - totalWeight;
+}
+
+// An empty palette leaves every vertex in the rest pose
+void CopyRestPose(const Vertex* vertices, unsigned int count, glm::vec3* positions, glm::vec3* normals) {
+    for (unsigned int v = 0; v < count; v++) {
+        positions[v] = vertices[v].Position;
+        normals[v] = vertices[v].Normal;
+    }
+}
+
+void SkinLinearScalar(const Vertex* vertices, unsigned int count, const glm::mat4* palette,
+                      unsigned int boneCount, glm::vec3* positions, glm::vec3* normals) {
+    for (unsigned int v = 0; v < count; v++) {
+        const Vertex& vertex = vertices[v];
+        int ids[MAX_BONE_INFLUENCE];
+        float weights[MAX_BONE_INFLUENCE];
+        float restWeight = ResolveInfluences(vertex, boneCount, ids, weights);
+
+        glm::vec3 totalPosition = vertex.Position * restWeight;
+        glm::vec3 totalNormal = vertex.Normal * restWeight;
+        for (int i = 0; i < MAX_BONE_INFLUENCE; i++) {
+            const glm::mat4& bone = palette[ids[i]];
+            totalPosition += glm::vec3(bone * glm::vec4(vertex.Position, 1.0f)) * weights[i];
+            totalNormal += (glm::mat3(bone) * vertex.Normal) * weights[i];
+        }
+        positions[v] = totalPosition;
+        normals[v] = totalNormal;
+    }
+}
+
+// Every bone is blended in the hemisphere of the first slot's, and the rest
+// weight blends in the identity, as in the shader
+void SkinDualQuaternionScalar(const Vertex* vertices, unsigned int count, const glm::vec4* dualQuaternions,
+                              unsigned int boneCount, glm::vec3* positions, glm::vec3* normals) {
+    for (unsigned int v = 0; v < count; v++) {
+        const Vertex& vertex = vertices[v];
+        int ids[MAX_BONE_INFLUENCE];
+        float weights[MAX_BONE_INFLUENCE];
+        float restWeight = ResolveInfluences(vertex, boneCount, ids, weights);
+
+        const glm::vec4& pivot = dualQuaternions[ids[0] * 2];
+        glm::vec4 blendReal = pivot * weights[0];
+        glm::vec4 blendDual = dualQuaternions[ids[0] * 2 + 1] * weights[0];
+        for (int i = 1; i < MAX_BONE_INFLUENCE; i++) {
+            const glm::vec4& real = dualQuaternions[ids[i] * 2];
+            const glm::vec4& dual = dualQuaternions[ids[i] * 2 + 1];
+            float weight = glm::dot(real, pivot) < 0.0f ? -weights[i] : weights[i];
+            blendReal += real * weight;
+            blendDual += dual * weight;
+        }
+        blendReal.w += restWeight;
+
+        float len = glm::length(blendReal);
+        glm::vec3 r = glm::vec3(blendReal) / len;
+        float w = blendReal.w / len;
+        glm::vec3 d = glm::vec3(blendDual) / len;
+        float dw = blendDual.w / len;
+        glm::vec3 translation = 2.0f * (w * d - dw * r + glm::cross(r, d));
+        positions[v] = vertex.Position + 2.0f * glm::cross(r, glm::cross(r, vertex.Position) + w * vertex.Position) + translation;
+        normals[v] = vertex.Normal + 2.0f * glm::cross(r, glm::cross(r, vertex.Normal) + w * vertex.Normal);
+    }
+}
+
+#ifdef CPU_SKINNING_X86
+
+// Four vertices per iteration in structure-of-arrays form: lane k of every
+// register belongs to vertex v + k. Bone matrices are column-major, so each
+// influence loads one column of the four lanes' bones and a transpose turns
+// it into one register per row; the blended matrices then transform all
+// four positions and normals at once. The bottom row is never needed, and
+// the rest weight goes on the diagonal. Leftover vertices go through the
+// scalar kernel.
+__attribute__((target("sse2")))
+void SkinLinearSSE(const Vertex* vertices, unsigned int count, const glm::mat4* palette,
+                   unsigned int boneCount, glm::vec3* positions, glm::vec3* normals) {
+    unsigned int v = 0;
+    for (; v + 4 <= count; v += 4) {
+        int ids[4][MAX_BONE_INFLUENCE];
+        float weights[4][MAX_BONE_INFLUENCE];
+        float restWeights[4];
+        for (int k = 0; k < 4; k++) {
+            restWeights[k] = ResolveInfluences(vertices[v + k], boneCount, ids[k], weights[k]);
+        }
+
+        // blended[column][row], rows 0 to 2, starting from the rest weight times the identity
+        __m128 blended[4][3];
+        __m128 rest = _mm_loadu_ps(restWeights);
+        for (int c = 0; c < 4; c++) {
+            for (int r = 0; r < 3; r++) blended[c][r] = c == r ? rest : _mm_setzero_ps();
+        }
+        for (int i = 0; i < MAX_BONE_INFLUENCE; i++) {
+            const float* bones[4];
+            float laneWeights[4];
+            for (int k = 0; k < 4; k++) {
+                bones[k] = &palette[ids[k][i]][0][0];
+                laneWeights[k] = weights[k][i];
+            }
+            __m128 weight = _mm_loadu_ps(laneWeights);
+            for (int c = 0; c < 4; c++) {
+                __m128 row0 = _mm_loadu_ps(bones[0] + c * 4);
+                __m128 row1 = _mm_loadu_ps(bones[1] + c * 4);
+                __m128 row2 = _mm_loadu_ps(bones[2] + c * 4);
+                __m128 row3 = _mm_loadu_ps(bones[3] + c * 4);
+                _MM_TRANSPOSE4_PS(row0, row1, row2, row3);
+                blended[c][0] = _mm_add_ps(blended[c][0], _mm_mul_ps(row0, weight));
+                blended[c][1] = _mm_add_ps(blended[c][1], _mm_mul_ps(row1, weight));
+                blended[c][2] = _mm_add_ps(blended[c][2], _mm_mul_ps(row2, weight));
+            }
+        }
+
+        const Vertex* quad = vertices + v;
+        __m128 px = _mm_setr_ps(quad[0].Position.x, quad[1].Position.x, quad[2].Position.x, quad[3].Position.x);
+        __m128 py = _mm_setr_ps(quad[0].Position.y, quad[1].Position.y, quad[2].Position.y, quad[3].Position.y);
+        __m128 pz = _mm_setr_ps(quad[0].Position.z, quad[1].Position.z, quad[2].Position.z, quad[3].Position.z);
+        __m128 nx = _mm_setr_ps(quad[0].Normal.x, quad[1].Normal.x, quad[2].Normal.x, quad[3].Normal.x);
+        __m128 ny = _mm_setr_ps(quad[0].Normal.y, quad[1].Normal.y, quad[2].Normal.y, quad[3].Normal.y);
+        __m128 nz = _mm_setr_ps(quad[0].Normal.z, quad[1].Normal.z, quad[2].Normal.z, quad[3].Normal.z);
+
+        float outPositions[3][4], outNormals[3][4];
+        for (int r = 0; r < 3; r++) {
+            __m128 position = _mm_add_ps(_mm_add_ps(_mm_mul_ps(blended[0][r], px), _mm_mul_ps(blended[1][r], py)),
+                                         _mm_add_ps(_mm_mul_ps(blended[2][r], pz), blended[3][r]));
+            __m128 normal = _mm_add_ps(_mm_add_ps(_mm_mul_ps(blended[0][r], nx), _mm_mul_ps(blended[1][r], ny)),
+                                       _mm_mul_ps(blended[2][r], nz));
+            _mm_storeu_ps(outPositions[r], position);
+            _mm_storeu_ps(outNormals[r], normal);
+        }
+        for (int k = 0; k < 4; k++) {
+            positions[v + k] = glm::vec3(outPositions[0][k], outPositions[1][k], outPositions[2][k]);
+            normals[v + k] = glm::vec3(outNormals[0][k], outNormals[1][k], outNormals[2][k]);
+        }
+    }
+
+    if (v < count) {
+        SkinLinearScalar(vertices + v, count - v, palette, boneCount, positions + v, normals + v);
+    }
+}
+
+// Loads column c of two bones, lane a's in the low and lane b's in the high
+// 128-bit half
+__attribute__((target("avx2,fma")))
+inline __m256 LoadColumnPair(const float* a, const float* b, int c) {
+    return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(a + c * 4)), _mm_loadu_ps(b + c * 4), 1);
+}
+
+// The SSE kernel at eight vertices per iteration. Register j of a column
+// holds lane j's bone column in its low half and lane j + 4's in its high
+// half; the unpacks and shuffles work within halves, so one 4x4 transpose
+// gives rows with lanes 0 to 7 in order.
+__attribute__((target("avx2,fma")))
+void SkinLinearAVX2(const Vertex* vertices, unsigned int count, const glm::mat4* palette,
+                    unsigned int boneCount, glm::vec3* positions, glm::vec3* normals) {
+    unsigned int v = 0;
+    for (; v + 8 <= count; v += 8) {
+        int ids[8][MAX_BONE_INFLUENCE];
+        float weights[8][MAX_BONE_INFLUENCE];
+        float restWeights[8];
+        for (int k = 0; k < 8; k++) {
+            restWeights[k] = ResolveInfluences(vertices[v + k], boneCount, ids[k], weights[k]);
+        }
+
+        // blended[column][row], rows 0 to 2, starting from the rest weight times the identity
+        __m256 blended[4][3];
+        __m256 rest = _mm256_loadu_ps(restWeights);
+        for (int c = 0; c < 4; c++) {
+            for (int r = 0; r < 3; r++) blended[c][r] = c == r ? rest : _mm256_setzero_ps();
+        }
+        for (int i = 0; i < MAX_BONE_INFLUENCE; i++) {
+            const float* bones[8];
+            float laneWeights[8];
+            for (int k = 0; k < 8; k++) {
+                bones[k] = &palette[ids[k][i]][0][0];
+                laneWeights[k] = weights[k][i];
+            }
+            __m256 weight = _mm256_loadu_ps(laneWeights);
+            for (int c = 0; c < 4; c++) {
+                __m256 column0 = LoadColumnPair(bones[0], bones[4], c);
+                __m256 column1 = LoadColumnPair(bones[1], bones[5], c);
+                __m256 column2 = LoadColumnPair(bones[2], bones[6], c);
+                __m256 column3 = LoadColumnPair(bones[3], bones[7], c);
+                __m256 low01 = _mm256_unpacklo_ps(column0, column1);    // x0 x1 y0 y1
+                __m256 high01 = _mm256_unpackhi_ps(column0, column1);   // z0 z1 w0 w1
+                __m256 low23 = _mm256_unpacklo_ps(column2, column3);
+                __m256 high23 = _mm256_unpackhi_ps(column2, column3);
+                __m256 row0 = _mm256_shuffle_ps(low01, low23, _MM_SHUFFLE(1, 0, 1, 0));
+                __m256 row1 = _mm256_shuffle_ps(low01, low23, _MM_SHUFFLE(3, 2, 3, 2));
+                __m256 row2 = _mm256_shuffle_ps(high01, high23, _MM_SHUFFLE(1, 0, 1, 0));
+                blended[c][0] = _mm256_fmadd_ps(row0, weight, blended[c][0]);
+                blended[c][1] = _mm256_fmadd_ps(row1, weight, blended[c][1]);
+                blended[c][2] = _mm256_fmadd_ps(row2, weight, blended[c][2]);
+            }
+        }
+
+        const Vertex* group = vertices + v;
+        float px[8], py[8], pz[8], nx[8], ny[8], nz[8];
+        for (int k = 0; k < 8; k++) {
+            px[k] = group[k].Position.x;
+            py[k] = group[k].Position.y;
+            pz[k] = group[k].Position.z;
+            nx[k] = group[k].Normal.x;
+            ny[k] = group[k].Normal.y;
+            nz[k] = group[k].Normal.z;
+        }
+        __m256 positionX = _mm256_loadu_ps(px), positionY = _mm256_loadu_ps(py), positionZ = _mm256_loadu_ps(pz);
+        __m256 normalX = _mm256_loadu_ps(nx), normalY = _mm256_loadu_ps(ny), normalZ = _mm256_loadu_ps(nz);
+
+        float outPositions[3][8], outNormals[3][8];
+        for (int r = 0; r < 3; r++) {
+            __m256 position = _mm256_fmadd_ps(blended[0][r], positionX, blended[3][r]);
+            position = _mm256_fmadd_ps(blended[1][r], positionY, position);
+            position = _mm256_fmadd_ps(blended[2][r], positionZ, position);
+            __m256 normal = _mm256_mul_ps(blended[0][r], normalX);
+            normal = _mm256_fmadd_ps(blended[1][r], normalY, normal);
+            normal = _mm256_fmadd_ps(blended[2][r], normalZ, normal);
+            _mm256_storeu_ps(outPositions[r], position);
+            _mm256_storeu_ps(outNormals[r], normal);
+        }
+        for (int k = 0; k < 8; k++) {
+            positions[v + k] = glm::vec3(outPositions[0][k], outPositions[1][k], outPositions[2][k]);
+            normals[v + k] = glm::vec3(outNormals[0][k], outNormals[1][k], outNormals[2][k]);
+        }
+    }
+
+    if (v < count) {
+        SkinLinearSSE(vertices + v, count - v, palette, boneCount, positions + v, normals + v);
+    }
+}
+
+#endif
+
+}
+
+void DualQuaternionFromMatrix(const glm::mat4& m, glm::vec4& real, glm::vec4& dual) {
+    glm::mat3 basis(m);
+    basis[0] = glm::normalize(basis[0]);
+    basis[1] = glm::normalize(basis[1]);
+    basis[2] = glm::normalize(basis[2]);
+    glm::quat rotation = glm::normalize(glm::quat_cast(basis));
+    glm::vec3 t(m[3]);
+    glm::quat translated = (glm::quat(0.0f, t.x, t.y, t.z) * rotation) * 0.5f;
+    real = glm::vec4(rotation.x, rotation.y, rotation.z, rotation.w);
+    dual = glm::vec4(translated.x, translated.y, translated.z, translated.w);
+}
+
+CpuSkinner::CpuSkinner(unsigned int threadCount) : jobs(threadCount), kernel(DetectKernel()) {
+}
+
+void CpuSkinner::SkinMesh(const Mesh& mesh, const glm::mat4* palette, unsigned int boneCount,
+                          SkinningMode mode, SkinnedVertices& out) {
+    unsigned int count = (unsigned int)mesh.vertices.size();
+    out.positions.resize(count);
+    out.normals.resize(count);
+    const Vertex* vertices = mesh.vertices.data();
+    glm::vec3* positions = out.positions.data();
+    glm::vec3* normals = out.normals.data();
+
+    // Vertices index the mesh's own palette; bones outside the model's
+    // palette add nothing, leaving their weight in the rest pose
+    meshPalette.resize(mesh.bones.size());
+    for (size_t i = 0; i < mesh.bones.size(); i++) {
+        if (mesh.bones[i] >= boneCount) {
+            meshPalette.resize(i);
+            break;
+        }
+        meshPalette[i] = palette[mesh.bones[i]];
+    }
+    palette = meshPalette.data();
+    boneCount = (unsigned int)meshPalette.size();
+    if (boneCount == 0) {
+        CopyRestPose(vertices, count, positions, normals);
+        return;
+    }
+
+    if (mode == SkinningMode::DualQuaternion) {
+        dualQuaternions.resize(boneCount * 2);
+        for (unsigned int b = 0; b < boneCount; b++) {
+            DualQuaternionFromMatrix(palette[b], dualQuaternions[b * 2], dualQuaternions[b * 2 + 1]);
+        }
+        const glm::vec4* bones = dualQuaternions.data();
+        jobs.ParallelFor(count, SKINNING_GRAIN, [=](unsigned int begin, unsigned int end, unsigned int) {
+            SkinDualQuaternionScalar(vertices + begin, end - begin, bones, boneCount, positions + begin, normals + begin);
+        });
+        return;
+    }
+
+    void (*skin)(const Vertex*, unsigned int, const glm::mat4*, unsigned int, glm::vec3*, glm::vec3*) = SkinLinearScalar;
+#ifdef CPU_SKINNING_X86
+    if (kernel == SkinningKernel::AVX2) skin = SkinLinearAVX2;
+    else if (kernel == SkinningKernel::SSE) skin = SkinLinearSSE;
+#endif
+    jobs.ParallelFor(count, SKINNING_GRAIN, [=](unsigned int begin, unsigned int end, unsigned int) {
+        skin(vertices + begin, end - begin, palette, boneCount, positions + begin, normals + begin);
+    });
+}
+
+void CpuSkinner::SkinModel(const Model& model, const glm::mat4* palette, unsigned int boneCount,
+                           std::vector<SkinnedVertices>& out) {
+    out.resize(model.meshes.size());
+    for (size_t i = 0; i < model.meshes.size(); i++) {
+        SkinMesh(model.meshes[i], palette, boneCount, model.skinningMode, out[i]);
+    }
+}
+
+void CpuSkinner::SetKernel(SkinningKernel requested) {
+    kernel = std::min(requested, DetectKernel());
+}
+
+SkinningKernel CpuSkinner::GetKernel() const {
+    return kernel;
+}
+
+SkinningKernel CpuSkinner::DetectKernel() {
+#ifdef CPU_SKINNING_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) return SkinningKernel::AVX2;
+    if (__builtin_cpu_supports("sse2")) return SkinningKernel::SSE;
+#endif
+    return SkinningKernel::Scalar;
+}
+
+const char* CpuSkinner::GetKernelName(SkinningKernel kernel) {
+    switch (kernel) {
+        case SkinningKernel::AVX2: return "AVX2";
+        case SkinningKernel::SSE: return "SSE";
+        default: return "scalar";
+    }
+}
+
+void CpuSkinner::SkinVerticesReference(const Vertex* vertices, unsigned int count, const glm::mat4* palette,
+                                       unsigned int boneCount, SkinningMode mode,
+                                       glm::vec3* positions, glm::vec3* normals) {
+    if (boneCount == 0) {
+        CopyRestPose(vertices, count, positions, normals);
+        return;
+    }
+    if (mode == SkinningMode::DualQuaternion) {
+        std::vector<glm::vec4> bones(boneCount * 2);
+        for (unsigned int b = 0; b < boneCount; b++) {
+            DualQuaternionFromMatrix(palette[b], bones[b * 2], bones[b * 2 + 1]);
+        }
+        SkinDualQuaternionScalar(vertices, count, bones.data(), boneCount, positions, normals);
+        return;
+    }
+    SkinLinearScalar(vertices, count, palette, boneCount, positions, normals);
+}
@@ -0,0 +1,65 @@
+#ifndef CPU_SKINNING_H
+#define CPU_SKINNING_H
+
+#include <glm/glm.hpp>
+
+#include "job_system.h"
+#include "mesh.h"
+
+#include <vector>
+
+class Model;
+
+enum class SkinningKernel {
+    Scalar,
+    SSE,
+    AVX2
+};
+
+struct SkinnedVertices {
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec3> normals;
+};
+
+// Converts a rigid bone matrix into the dual quaternion the shaders blend:
+// real part is the rotation, dual part is 0.5 * translation * rotation.
+void DualQuaternionFromMatrix(const glm::mat4& m, glm::vec4& real, glm::vec4& dual);
+
+// Applies a bone palette to mesh vertices on the CPU with the same math as
+// the vertex shaders in main.cpp and pre_skinner.cpp, so deformed positions
+// are available to gameplay code and to machines without a GPU. Weight the
+// influences do not cover, including that of bones outside the palette,
+// stays in the rest pose. Vertices are split into chunks across a worker
+// pool; linear blend chunks run on SSE (four vertices per iteration) or
+// AVX2 + FMA (eight vertices per iteration) when the CPU has them. SkinMesh
+// takes the model's palette and gathers the mesh's own bones (Mesh::bones)
+// itself. SkinVerticesReference is the plain scalar version of the shader,
+// taking a palette already in mesh order, and is what the vector kernels
+// are checked against.
+class CpuSkinner {
+public:
+    explicit CpuSkinner(unsigned int threadCount = 0);
+
+    void SkinMesh(const Mesh& mesh, const glm::mat4* palette, unsigned int boneCount,
+                  SkinningMode mode, SkinnedVertices& out);
+    void SkinModel(const Model& model, const glm::mat4* palette, unsigned int boneCount,
+                   std::vector<SkinnedVertices>& out);
+
+    // Defaults to the best kernel the CPU supports; unsupported requests fall back
+    void SetKernel(SkinningKernel kernel);
+    SkinningKernel GetKernel() const;
+
+    static SkinningKernel DetectKernel();
+    static const char* GetKernelName(SkinningKernel kernel);
+    static void SkinVerticesReference(const Vertex* vertices, unsigned int count, const glm::mat4* palette,
+                                      unsigned int boneCount, SkinningMode mode,
+                                      glm::vec3* positions, glm::vec3* normals);
+
+private:
+    JobSystem jobs;
+    SkinningKernel kernel;
+    std::vector<glm::mat4> meshPalette;
+    std::vector<glm::vec4> dualQuaternions;   // real and dual part per bone
+};
+
+#endif
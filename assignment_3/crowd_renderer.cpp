@@ -0,0 +1,63 @@
+#include "crowd_renderer.h"
+#include "gl_state.h"
+
+#include <cstddef>
+
+CrowdRenderer::CrowdRenderer(Model* model, const BakedAnimation& animation)
+    : model(model), animation(animation) {
+    glGenBuffers(1, &instanceVBO);
+    glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+
+    for (auto& mesh : model->meshes) {
+        GLStateCache::Get().BindVertexArray(mesh.VAO);
+        // A mat4 attribute takes four consecutive locations
+        for (int column = 0; column < 4; column++) {
+            glEnableVertexAttribArray(5 + column);
+            glVertexAttribPointer(5 + column, 4, GL_FLOAT, GL_FALSE, sizeof(CrowdInstance),
+                                  (void*)(offsetof(CrowdInstance, transform) + column * sizeof(glm::vec4)));
+            glVertexAttribDivisor(5 + column, 1);
+        }
+        glEnableVertexAttribArray(9);
+        glVertexAttribPointer(9, 1, GL_FLOAT, GL_FALSE, sizeof(CrowdInstance), (void*)offsetof(CrowdInstance, timeOffset));
+        glVertexAttribDivisor(9, 1);
+    }
+
+    GLStateCache::Get().BindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+CrowdRenderer::~CrowdRenderer() {
+    glDeleteBuffers(1, &instanceVBO);
+}
+
+void CrowdRenderer::SetInstances(const std::vector<CrowdInstance>& instances) {
+    instanceCount = (unsigned int)instances.size();
+    std::vector<CrowdInstance> packed(instances);
+    for (auto& instance : packed) {
+        instance.transform = ShaderVariants::PackInstanceTransform(instance.transform);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+    glBufferData(GL_ARRAY_BUFFER, packed.size() * sizeof(CrowdInstance), packed.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void CrowdRenderer::Draw(ShaderVariants& shaders, unsigned int key) {
+    if (instanceCount == 0 || !animation.texture) return;
+
+    GLStateCache::Get().BindTexture(BAKED_ANIMATION_TEXTURE_UNIT, GL_TEXTURE_2D, animation.texture);
+
+    for (size_t i = 0; i < model->meshes.size() && i < animation.meshBoneOffsets.size(); i++) {
+        Mesh& mesh = model->meshes[i];
+        Shader& shader = shaders.Get(ShaderVariants::ForMesh(key | SHADER_SKINNED | SHADER_INSTANCED, mesh));
+        shader.use();
+        shader.setInt("bakedBones", BAKED_ANIMATION_TEXTURE_UNIT);
+        shader.setInt("frameCount", animation.frameCount);
+        shader.setFloat("frameRate", animation.frameRate);
+        shader.setInt("boneOffset", animation.meshBoneOffsets[i]);
+        mesh.DrawInstanced(shader, instanceCount);
+    }
+}
+
+unsigned int CrowdRenderer::GetInstanceCount() const {
+    return instanceCount;
+}
@@ -0,0 +1,41 @@
+#ifndef CROWD_RENDERER_H
+#define CROWD_RENDERER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "animation_baker.h"
+#include "model.h"
+#include "shader.h"
+#include "shader_variants.h"
+
+#include <vector>
+
+struct CrowdInstance {
+    glm::mat4 transform;
+    float timeOffset;   // seconds added to the shared playback time
+};
+
+// Draws many copies of one model playing a baked animation with one
+// instanced call per mesh. Per-instance transforms and time offsets live in
+// a vertex buffer attached to the model's VAOs at locations 5-9; the crowd
+// shader samples and interpolates the baked frames itself, at the time in
+// the Frame uniform block. Each mesh is drawn with the skinned, instanced
+// variant of the key that fits it.
+class CrowdRenderer {
+public:
+    CrowdRenderer(Model* model, const BakedAnimation& animation);
+    ~CrowdRenderer();
+
+    void SetInstances(const std::vector<CrowdInstance>& instances);
+    void Draw(ShaderVariants& shaders, unsigned int key);
+    unsigned int GetInstanceCount() const;
+
+private:
+    Model* model;
+    BakedAnimation animation;
+    unsigned int instanceVBO = 0;
+    unsigned int instanceCount = 0;
+};
+
+#endif
@@ -0,0 +1,56 @@
+#include "frustum.h"
+
+Frustum::Frustum() {
+    // Planes that accept everything until a real view is extracted
+    for (int i = 0; i < 6; i++) {
+        planes[i] = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+    }
+}
+
+Frustum::Frustum(const glm::mat4& viewProjection) {
+    Extract(viewProjection);
+}
+
+void Frustum::Extract(const glm::mat4& m) {
+    // Gribb-Hartmann: each plane is the fourth row of the matrix plus or
+    // minus one of the other rows (glm is column-major, so row i is m[*][i])
+    glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+    glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+    glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+    glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+
+    planes[0] = row3 + row0;   // left
+    planes[1] = row3 - row0;   // right
+    planes[2] = row3 + row1;   // bottom
+    planes[3] = row3 - row1;   // top
+    planes[4] = row3 + row2;   // near
+    planes[5] = row3 - row2;   // far
+
+    for (int i = 0; i < 6; i++) {
+        float length = glm::length(glm::vec3(planes[i]));
+        if (length > 0.0f) planes[i] = planes[i] / length;
+    }
+}
+
+bool Frustum::IntersectsSphere(const glm::vec3& center, float radius) const {
+    for (int i = 0; i < 6; i++) {
+        if (glm::dot(glm::vec3(planes[i]), center) + planes[i].w < -radius) {
+            return false;
+        }
+    }
+    return true;
+}
+
+FrustumTest Frustum::TestBox(const glm::vec3& min, const glm::vec3& max) const {
+    glm::vec3 center = (min + max) * 0.5f;
+    glm::vec3 extent = (max - min) * 0.5f;
+    FrustumTest result = FrustumTest::Inside;
+    for (int i = 0; i < 6; i++) {
+        glm::vec3 normal(planes[i]);
+        float distance = glm::dot(normal, center) + planes[i].w;
+        float reach = glm::dot(glm::abs(normal), extent);
+        if (distance < -reach) return FrustumTest::Outside;
+        if (distance < reach) result = FrustumTest::Intersects;
+    }
+    return result;
+}
@@ -0,0 +1,26 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include <glm/glm.hpp>
+
+enum class FrustumTest {
+    Outside,
+    Intersects,
+    Inside
+};
+
+// View frustum as six inward-facing planes (xyz = normal, w = distance),
+// extracted from a projection * view matrix.
+struct Frustum {
+    glm::vec4 planes[6];
+
+    Frustum();
+    explicit Frustum(const glm::mat4& viewProjection);
+
+    void Extract(const glm::mat4& viewProjection);
+    bool IntersectsSphere(const glm::vec3& center, float radius) const;
+    // Conservative: boxes near a corner may report Intersects while outside
+    FrustumTest TestBox(const glm::vec3& min, const glm::vec3& max) const;
+};
+
+#endif
@@ -0,0 +1,220 @@
+#include "frustum_culler.h"
+
+#include <algorithm>
+#include <cfloat>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define FRUSTUM_CULLER_X86
+#include <immintrin.h>
+#endif
+
+// A sphere is inside unless it lies entirely behind one plane:
+// dot(normal, center) + w >= -radius for all six planes. Padding slots have
+// radius -FLT_MAX and fail every test.
+
+#ifdef FRUSTUM_CULLER_X86
+__attribute__((target("sse2")))
+static unsigned int TestSpheresSSE(const float* x, const float* y, const float* z, const float* r,
+                                   const glm::vec4* planes) {
+    unsigned int mask = 0;
+    for (int half = 0; half < 2; half++) {
+        __m128 px = _mm_loadu_ps(x + half * 4);
+        __m128 py = _mm_loadu_ps(y + half * 4);
+        __m128 pz = _mm_loadu_ps(z + half * 4);
+        __m128 negativeRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(r + half * 4));
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (int p = 0; p < 6; p++) {
+            __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(px, _mm_set1_ps(planes[p].x)),
+                                                    _mm_mul_ps(py, _mm_set1_ps(planes[p].y))),
+                                         _mm_add_ps(_mm_mul_ps(pz, _mm_set1_ps(planes[p].z)), _mm_set1_ps(planes[p].w)));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negativeRadius));
+        }
+        mask |= (unsigned int)_mm_movemask_ps(inside) << (half * 4);
+    }
+    return mask;
+}
+
+__attribute__((target("avx")))
+static unsigned int TestSpheresAVX(const float* x, const float* y, const float* z, const float* r,
+                                   const glm::vec4* planes) {
+    __m256 px = _mm256_loadu_ps(x);
+    __m256 py = _mm256_loadu_ps(y);
+    __m256 pz = _mm256_loadu_ps(z);
+    __m256 negativeRadius = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(r));
+    __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+    for (int p = 0; p < 6; p++) {
+        __m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(px, _mm256_set1_ps(planes[p].x)),
+                                                      _mm256_mul_ps(py, _mm256_set1_ps(planes[p].y))),
+                                        _mm256_add_ps(_mm256_mul_ps(pz, _mm256_set1_ps(planes[p].z)), _mm256_set1_ps(planes[p].w)));
+        inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, negativeRadius, _CMP_GE_OQ));
+    }
+    return (unsigned int)_mm256_movemask_ps(inside);
+}
+#else
+static unsigned int TestSpheresScalar(const float* x, const float* y, const float* z, const float* r,
+                                      const glm::vec4* planes) {
+    unsigned int mask = 0;
+    for (unsigned int i = 0; i < FrustumCuller::LEAF_SIZE; i++) {
+        bool inside = true;
+        for (int p = 0; p < 6 && inside; p++) {
+            inside = x[i] * planes[p].x + y[i] * planes[p].y + z[i] * planes[p].z + planes[p].w >= -r[i];
+        }
+        if (inside) mask |= 1u << i;
+    }
+    return mask;
+}
+#endif
+
+FrustumCuller::FrustumCuller() {
+#ifdef FRUSTUM_CULLER_X86
+    useAVX = __builtin_cpu_supports("avx");
+#endif
+}
+
+void FrustumCuller::Build(const std::vector<glm::vec4>& spheres) {
+    nodes.clear();
+    centerX.clear();
+    centerY.clear();
+    centerZ.clear();
+    radius.clear();
+    slotObjects.clear();
+    objectSlots.assign(spheres.size(), 0);
+    if (spheres.empty()) return;
+
+    std::vector<unsigned int> order(spheres.size());
+    for (unsigned int i = 0; i < order.size(); i++) order[i] = i;
+    nodes.resize(1);
+    BuildNode(0, order, 0, (unsigned int)order.size(), spheres);
+}
+
+void FrustumCuller::BuildNode(unsigned int node, std::vector<unsigned int>& order, unsigned int begin,
+                              unsigned int end, const std::vector<glm::vec4>& spheres) {
+    glm::vec3 lower(FLT_MAX), upper(-FLT_MAX);
+    glm::vec3 centerLower(FLT_MAX), centerUpper(-FLT_MAX);
+    for (unsigned int i = begin; i < end; i++) {
+        const glm::vec4& sphere = spheres[order[i]];
+        glm::vec3 center(sphere);
+        lower = glm::min(lower, center - glm::vec3(sphere.w));
+        upper = glm::max(upper, center + glm::vec3(sphere.w));
+        centerLower = glm::min(centerLower, center);
+        centerUpper = glm::max(centerUpper, center);
+    }
+    nodes[node].min = lower;
+    nodes[node].max = upper;
+
+    if (end - begin <= LEAF_SIZE) {
+        unsigned int first = (unsigned int)slotObjects.size();
+        for (unsigned int i = 0; i < LEAF_SIZE; i++) {
+            bool used = begin + i < end;
+            unsigned int object = used ? order[begin + i] : NO_OBJECT;
+            centerX.push_back(used ? spheres[object].x : 0.0f);
+            centerY.push_back(used ? spheres[object].y : 0.0f);
+            centerZ.push_back(used ? spheres[object].z : 0.0f);
+            radius.push_back(used ? spheres[object].w : -FLT_MAX);
+            slotObjects.push_back(object);
+            if (used) objectSlots[object] = first + i;
+        }
+        nodes[node].first = first;
+        nodes[node].count = LEAF_SIZE;
+        return;
+    }
+
+    // Median split along the axis where the centers spread the most
+    glm::vec3 spread = centerUpper - centerLower;
+    int axis = spread.x > spread.y ? (spread.x > spread.z ? 0 : 2) : (spread.y > spread.z ? 1 : 2);
+    unsigned int middle = begin + (end - begin) / 2;
+    std::nth_element(order.begin() + begin, order.begin() + middle, order.begin() + end,
+                     [&spheres, axis](unsigned int a, unsigned int b) { return spheres[a][axis] < spheres[b][axis]; });
+
+    unsigned int left = (unsigned int)nodes.size();
+    nodes.resize(nodes.size() + 2);
+    nodes[node].left = left;
+    BuildNode(left, order, begin, middle, spheres);
+    BuildNode(left + 1, order, middle, end, spheres);
+    nodes[node].first = nodes[left].first;
+    nodes[node].count = nodes[left].count + nodes[left + 1].count;
+}
+
+void FrustumCuller::SetSphere(unsigned int object, const glm::vec3& center, float sphereRadius) {
+    unsigned int slot = objectSlots[object];
+    centerX[slot] = center.x;
+    centerY[slot] = center.y;
+    centerZ[slot] = center.z;
+    radius[slot] = sphereRadius;
+}
+
+void FrustumCuller::Refit() {
+    // Children are always stored after their parent
+    for (size_t i = nodes.size(); i-- > 0;) {
+        Node& node = nodes[i];
+        if (node.left) {
+            node.min = glm::min(nodes[node.left].min, nodes[node.left + 1].min);
+            node.max = glm::max(nodes[node.left].max, nodes[node.left + 1].max);
+            continue;
+        }
+        node.min = glm::vec3(FLT_MAX);
+        node.max = glm::vec3(-FLT_MAX);
+        for (unsigned int slot = node.first; slot < node.first + node.count; slot++) {
+            if (slotObjects[slot] == NO_OBJECT) continue;
+            glm::vec3 center(centerX[slot], centerY[slot], centerZ[slot]);
+            node.min = glm::min(node.min, center - glm::vec3(radius[slot]));
+            node.max = glm::max(node.max, center + glm::vec3(radius[slot]));
+        }
+    }
+}
+
+void FrustumCuller::Cull(const Frustum& frustum, std::vector<unsigned int>& visible) {
+    visible.clear();
+    stats = FrustumCullerStats();
+    if (!nodes.empty()) {
+        CullNode(nodes[0], frustum, visible);
+    }
+    stats.visible = (unsigned int)visible.size();
+    stats.culled = (unsigned int)objectSlots.size() - stats.visible;
+}
+
+void FrustumCuller::CullNode(const Node& node, const Frustum& frustum, std::vector<unsigned int>& visible) {
+    stats.nodesVisited++;
+    FrustumTest test = frustum.TestBox(node.min, node.max);
+    if (test == FrustumTest::Outside) return;
+
+    if (test == FrustumTest::Inside) {
+        for (unsigned int slot = node.first; slot < node.first + node.count; slot++) {
+            if (slotObjects[slot] != NO_OBJECT) visible.push_back(slotObjects[slot]);
+        }
+        return;
+    }
+
+    if (node.left) {
+        CullNode(nodes[node.left], frustum, visible);
+        CullNode(nodes[node.left + 1], frustum, visible);
+        return;
+    }
+
+    unsigned int mask = TestLeaf(node.first, frustum);
+    for (unsigned int i = 0; i < LEAF_SIZE; i++) {
+        if (mask & (1u << i)) visible.push_back(slotObjects[node.first + i]);
+        if (slotObjects[node.first + i] != NO_OBJECT) stats.spheresTested++;
+    }
+}
+
+unsigned int FrustumCuller::TestLeaf(unsigned int first, const Frustum& frustum) const {
+    const float* x = &centerX[first];
+    const float* y = &centerY[first];
+    const float* z = &centerZ[first];
+    const float* r = &radius[first];
+#ifdef FRUSTUM_CULLER_X86
+    if (useAVX) return TestSpheresAVX(x, y, z, r, frustum.planes);
+    return TestSpheresSSE(x, y, z, r, frustum.planes);
+#else
+    return TestSpheresScalar(x, y, z, r, frustum.planes);
+#endif
+}
+
+const FrustumCullerStats& FrustumCuller::GetStats() const {
+    return stats;
+}
+
+unsigned int FrustumCuller::GetObjectCount() const {
+    return (unsigned int)objectSlots.size();
+}
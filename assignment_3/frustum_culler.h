@@ -0,0 +1,70 @@
+#ifndef FRUSTUM_CULLER_H
+#define FRUSTUM_CULLER_H
+
+#include <glm/glm.hpp>
+
+#include "frustum.h"
+
+#include <vector>
+
+struct FrustumCullerStats {
+    unsigned int visible = 0;
+    unsigned int culled = 0;
+    unsigned int nodesVisited = 0;
+    unsigned int spheresTested = 0;   // the rest were accepted or rejected with their node
+};
+
+// Frustum culling of many bounding spheres through a bounding volume
+// hierarchy. Nodes entirely outside the frustum are skipped and nodes
+// entirely inside accept their whole subtree; only leaves the frustum
+// crosses test their spheres, eight at a time from structure-of-arrays
+// storage (one AVX or two SSE passes per leaf, six plane tests each).
+//
+// The hierarchy is built once by median splits along the widest axis.
+// Leaves are laid out depth first in blocks of LEAF_SIZE slots, padded with
+// spheres no plane accepts, so a subtree's spheres are one contiguous range.
+// Moving spheres only needs SetSphere() and Refit(); the tree gets looser
+// but stays correct.
+class FrustumCuller {
+public:
+    static const unsigned int LEAF_SIZE = 8;
+
+    FrustumCuller();
+
+    // One sphere per object, xyz = center, w = radius
+    void Build(const std::vector<glm::vec4>& spheres);
+    void SetSphere(unsigned int object, const glm::vec3& center, float radius);
+    // Recomputes node bounds after SetSphere()
+    void Refit();
+
+    // Fills visible with the indices of the objects inside the frustum
+    void Cull(const Frustum& frustum, std::vector<unsigned int>& visible);
+    const FrustumCullerStats& GetStats() const;   // of the last Cull()
+    unsigned int GetObjectCount() const;
+
+private:
+    static const unsigned int NO_OBJECT = ~0u;
+
+    struct Node {
+        glm::vec3 min, max;
+        unsigned int left = 0;    // children at left and left + 1; 0 for leaves
+        unsigned int first = 0;   // slot range of the subtree
+        unsigned int count = 0;
+    };
+
+    std::vector<Node> nodes;
+    // Spheres in slot order
+    std::vector<float> centerX, centerY, centerZ, radius;
+    std::vector<unsigned int> slotObjects;   // object of each slot, NO_OBJECT for padding
+    std::vector<unsigned int> objectSlots;   // slot of each object
+    FrustumCullerStats stats;
+    bool useAVX = false;
+
+    void BuildNode(unsigned int node, std::vector<unsigned int>& order, unsigned int begin, unsigned int end,
+                   const std::vector<glm::vec4>& spheres);
+    void CullNode(const Node& node, const Frustum& frustum, std::vector<unsigned int>& visible);
+    // Bit i is set if slot first + i is inside
+    unsigned int TestLeaf(unsigned int first, const Frustum& frustum) const;
+};
+
+#endif
@@ -0,0 +1,161 @@
+#include "gl_state.h"
+
+#include <cstring>
+
+unsigned int GLStateStats::GetIssued() const {
+    return programs.issued + vertexArrays.issued + textures.issued + uniforms.issued;
+}
+
+unsigned int GLStateStats::GetElided() const {
+    return programs.elided + vertexArrays.elided + textures.elided + uniforms.elided;
+}
+
+GLStateCache& GLStateCache::Get() {
+    static GLStateCache cache;
+    return cache;
+}
+
+GLStateCache::GLStateCache() {
+    Invalidate();
+}
+
+void GLStateCache::UseProgram(unsigned int id) {
+    if (id == program) {
+        current.programs.elided++;
+        return;
+    }
+    glUseProgram(id);
+    program = id;
+    currentUniforms = &uniformValues[id];
+    current.programs.issued++;
+}
+
+void GLStateCache::BindVertexArray(unsigned int id) {
+    if (id == vertexArray) {
+        current.vertexArrays.elided++;
+        return;
+    }
+    glBindVertexArray(id);
+    vertexArray = id;
+    current.vertexArrays.issued++;
+}
+
+void GLStateCache::ActiveTexture(unsigned int unit) {
+    if (unit == activeUnit) {
+        current.textures.elided++;
+        return;
+    }
+    glActiveTexture(GL_TEXTURE0 + unit);
+    activeUnit = unit;
+    current.textures.issued++;
+}
+
+void GLStateCache::BindTexture(GLenum target, unsigned int texture) {
+    unsigned int* slot = FindTextureSlot(activeUnit, target);
+    if (slot && *slot == texture) {
+        current.textures.elided++;
+        return;
+    }
+    glBindTexture(target, texture);
+    if (slot) *slot = texture;
+    current.textures.issued++;
+}
+
+void GLStateCache::BindTexture(unsigned int unit, GLenum target, unsigned int texture) {
+    unsigned int* slot = FindTextureSlot(unit, target);
+    if (slot && *slot == texture) {
+        current.textures.elided++;
+        return;
+    }
+    ActiveTexture(unit);
+    BindTexture(target, texture);
+}
+
+void GLStateCache::SetUniform(int location, int value) {
+    if (!UniformChanged(location, &value, sizeof(value))) return;
+    glUniform1i(location, value);
+}
+
+void GLStateCache::SetUniform(int location, float value) {
+    if (!UniformChanged(location, &value, sizeof(value))) return;
+    glUniform1f(location, value);
+}
+
+void GLStateCache::SetUniform(int location, const glm::vec3& value) {
+    if (!UniformChanged(location, &value[0], sizeof(float) * 3)) return;
+    glUniform3fv(location, 1, &value[0]);
+}
+
+void GLStateCache::SetUniform(int location, const glm::mat4& value) {
+    if (!UniformChanged(location, &value[0][0], sizeof(float) * 16)) return;
+    glUniformMatrix4fv(location, 1, GL_FALSE, &value[0][0]);
+}
+
+void GLStateCache::Invalidate() {
+    program = ~0u;
+    vertexArray = ~0u;
+    activeUnit = ~0u;
+    for (unsigned int i = 0; i < TRACKED_UNITS; i++) {
+        textures2D[i] = ~0u;
+        textureBuffers[i] = ~0u;
+    }
+    uniformValues.clear();
+    currentUniforms = nullptr;
+}
+
+void GLStateCache::EndFrame() {
+    const GLStateCounter* from[4] = { &current.programs, &current.vertexArrays, &current.textures, &current.uniforms };
+    GLStateCounter* to[4] = { &total.programs, &total.vertexArrays, &total.textures, &total.uniforms };
+    for (int i = 0; i < 4; i++) {
+        to[i]->issued += from[i]->issued;
+        to[i]->elided += from[i]->elided;
+    }
+    lastFrame = current;
+    current = GLStateStats();
+    frames++;
+}
+
+const GLStateStats& GLStateCache::GetFrameStats() const {
+    return lastFrame;
+}
+
+const GLStateStats& GLStateCache::GetTotalStats() const {
+    return total;
+}
+
+unsigned int GLStateCache::GetFrameCount() const {
+    return frames;
+}
+
+unsigned int* GLStateCache::FindTextureSlot(unsigned int unit, GLenum target) {
+    if (unit >= TRACKED_UNITS) return nullptr;
+    if (target == GL_TEXTURE_2D) return &textures2D[unit];
+    if (target == GL_TEXTURE_BUFFER) return &textureBuffers[unit];
+    return nullptr;
+}
+
+// Records the value and returns whether it has to be sent to GL. Locations
+// of -1 are dropped here, as glUniform* would ignore them anyway.
+bool GLStateCache::UniformChanged(int location, const void* data, unsigned int size) {
+    if (location < 0) {
+        current.uniforms.elided++;
+        return false;
+    }
+    if (!currentUniforms || location >= TRACKED_LOCATIONS) {
+        current.uniforms.issued++;
+        return true;
+    }
+
+    if ((int)currentUniforms->size() <= location) {
+        currentUniforms->resize(location + 1);
+    }
+    UniformValue& cached = (*currentUniforms)[location];
+    if (cached.size == size && std::memcmp(cached.data, data, size) == 0) {
+        current.uniforms.elided++;
+        return false;
+    }
+    cached.size = size;
+    std::memcpy(cached.data, data, size);
+    current.uniforms.issued++;
+    return true;
+}
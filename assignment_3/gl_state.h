@@ -0,0 +1,87 @@
+#ifndef GL_STATE_H
+#define GL_STATE_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <unordered_map>
+#include <vector>
+
+// Issued and elided calls of one kind of state change
+struct GLStateCounter {
+    unsigned int issued = 0;
+    unsigned int elided = 0;
+};
+
+struct GLStateStats {
+    GLStateCounter programs;
+    GLStateCounter vertexArrays;
+    GLStateCounter textures;   // texture binds and active unit switches
+    GLStateCounter uniforms;
+
+    unsigned int GetIssued() const;
+    unsigned int GetElided() const;
+};
+
+// Shadow copy of the GL state the renderer touches: bound program, VAO,
+// active texture unit, 2D and buffer textures per unit, and the uniform
+// values of every program. Calls that would not change anything are not
+// passed to GL. All code binds these through the cache, including setup
+// code, so the shadow copy never goes stale; code that changes them behind
+// its back or deletes a program, VAO or texture must call Invalidate(),
+// since GL reuses deleted names.
+//
+// Uniform setters apply to the program bound through UseProgram, like
+// glUniform* itself.
+class GLStateCache {
+public:
+    static GLStateCache& Get();
+
+    void UseProgram(unsigned int program);
+    void BindVertexArray(unsigned int vertexArray);
+    void ActiveTexture(unsigned int unit);
+    void BindTexture(GLenum target, unsigned int texture);
+    // Binds texture to unit, switching the active unit only when needed
+    void BindTexture(unsigned int unit, GLenum target, unsigned int texture);
+
+    void SetUniform(int location, int value);
+    void SetUniform(int location, float value);
+    void SetUniform(int location, const glm::vec3& value);
+    void SetUniform(int location, const glm::mat4& value);
+
+    void Invalidate();
+    // Moves this frame's counters into the totals and starts a new frame
+    void EndFrame();
+    const GLStateStats& GetFrameStats() const;   // last finished frame
+    const GLStateStats& GetTotalStats() const;
+    unsigned int GetFrameCount() const;
+
+private:
+    static const unsigned int TRACKED_UNITS = 16;
+    static const int TRACKED_LOCATIONS = 1024;
+
+    struct UniformValue {
+        unsigned int size = 0;   // bytes in data, 0 if unknown
+        float data[16];
+    };
+
+    // Unknown values are ~0u, so the first call always goes through
+    unsigned int program = ~0u;
+    unsigned int vertexArray = ~0u;
+    unsigned int activeUnit = ~0u;
+    unsigned int textures2D[TRACKED_UNITS];
+    unsigned int textureBuffers[TRACKED_UNITS];
+    std::unordered_map<unsigned int, std::vector<UniformValue>> uniformValues;
+    std::vector<UniformValue>* currentUniforms = nullptr;
+
+    GLStateStats current;
+    GLStateStats lastFrame;
+    GLStateStats total;
+    unsigned int frames = 0;
+
+    GLStateCache();
+    unsigned int* FindTextureSlot(unsigned int unit, GLenum target);
+    bool UniformChanged(int location, const void* data, unsigned int size);
+};
+
+#endif
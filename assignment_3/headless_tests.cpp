@@ -0,0 +1,221 @@
+// Headless checks of the vectorized code paths against their plain
+// versions and of the software occlusion culler against known scenes; no
+// window or GL context is needed. Exits with 1 if any check fails.
+//
+//   make test
+
+#include "cpu_skinning.h"
+#include "mesh.h"
+#include "occlusion_culler.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+int failures = 0;
+
+void report(const char* name, bool passed, const std::string& detail) {
+    std::cout << (passed ? "PASS " : "FAIL ") << name;
+    if (!detail.empty()) std::cout << ": " << detail;
+    std::cout << std::endl;
+    if (!passed) failures++;
+}
+
+// ===================== CPU Skinning =====================
+
+// Rigid bones with a little scale, like an animated palette
+std::vector<glm::mat4> makePalette(unsigned int boneCount, std::mt19937& random) {
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    std::vector<glm::mat4> palette(boneCount);
+    for (auto& bone : palette) {
+        glm::vec3 axis(unit(random), unit(random), unit(random));
+        if (glm::length(axis) < 0.01f) axis = glm::vec3(0.0f, 1.0f, 0.0f);
+        bone = glm::translate(glm::mat4(1.0f), glm::vec3(unit(random), unit(random), unit(random)) * 5.0f);
+        bone = glm::rotate(bone, unit(random) * 3.14159f, glm::normalize(axis));
+        bone = glm::scale(bone, glm::vec3(1.0f + 0.1f * unit(random)));
+    }
+    return palette;
+}
+
+// Every influence case the kernels resolve: full and partial slots, weights
+// that cover only part of the vertex, zero total weight, and bones past the
+// palette, whose weight stays in the rest pose. The count is not a multiple
+// of eight, so the kernels' tails run too.
+Mesh makeSkinnedMesh(unsigned int vertexCount, unsigned int boneCount, std::mt19937& random) {
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    std::uniform_int_distribution<int> bone(0, (int)boneCount - 1);
+    std::vector<Vertex> vertices(vertexCount);
+    for (unsigned int v = 0; v < vertexCount; v++) {
+        Vertex& vertex = vertices[v];
+        vertex.Position = glm::vec3(unit(random), unit(random), unit(random)) * 2.0f;
+        vertex.Normal = glm::normalize(glm::vec3(unit(random), unit(random), unit(random)) + glm::vec3(0.0f, 0.0f, 0.01f));
+
+        int influences = (int)(v % (MAX_BONE_INFLUENCE + 1));
+        float total = 0.0f;
+        for (int i = 0; i < influences; i++) {
+            vertex.BoneIDs[i] = bone(random);
+            vertex.Weights[i] = 0.1f + 0.5f * (unit(random) + 1.0f);
+            total += vertex.Weights[i];
+        }
+        for (int i = 0; i < influences; i++) vertex.Weights[i] /= total;
+        if (v % 7 == 0) {
+            for (int i = 0; i < influences; i++) vertex.Weights[i] *= 0.6f;
+        }
+        if (v % 13 == 0 && influences > 0) vertex.BoneIDs[0] = (int)boneCount + 2;
+        if (v % 17 == 0) {
+            for (int i = 0; i < influences; i++) vertex.Weights[i] = 0.0f;
+        }
+    }
+
+    Mesh mesh(vertices, std::vector<unsigned int>(), std::vector<Texture>(), false);
+    for (unsigned int b = 0; b < boneCount; b++) mesh.bones.push_back(b);
+    return mesh;
+}
+
+// Largest difference from the reference, relative to the reference's size
+float compareVertices(const std::vector<glm::vec3>& reference, const std::vector<glm::vec3>& result) {
+    float worst = 0.0f;
+    for (size_t i = 0; i < reference.size(); i++) {
+        glm::vec3 difference = glm::abs(reference[i] - result[i]);
+        float scale = 1.0f + std::max(std::abs(reference[i].x), std::max(std::abs(reference[i].y), std::abs(reference[i].z)));
+        worst = std::max(worst, std::max(difference.x, std::max(difference.y, difference.z)) / scale);
+    }
+    return worst;
+}
+
+// The rule every skinning path shares, on values worked out by hand: one
+// bone moving by (4, 0, 0) with weight 0.25 and a bone past the palette
+// with weight 0.5 move the vertex by a quarter of that
+void testRestPoseRule() {
+    std::vector<glm::mat4> palette(1, glm::translate(glm::mat4(1.0f), glm::vec3(4.0f, 0.0f, 0.0f)));
+    Vertex vertex;
+    vertex.Position = glm::vec3(1.0f, 2.0f, 3.0f);
+    vertex.Normal = glm::vec3(0.0f, 1.0f, 0.0f);
+    vertex.BoneIDs[0] = 0;
+    vertex.Weights[0] = 0.25f;
+    vertex.BoneIDs[1] = 5;
+    vertex.Weights[1] = 0.5f;
+    const glm::vec3 expected(2.0f, 2.0f, 3.0f);
+
+    const SkinningMode modes[2] = { SkinningMode::Linear, SkinningMode::DualQuaternion };
+    const char* names[2] = { "cpu skinning, rest pose rule, linear", "cpu skinning, rest pose rule, dual quaternion" };
+    for (int m = 0; m < 2; m++) {
+        std::vector<glm::vec3> position(1), normal(1);
+        CpuSkinner::SkinVerticesReference(&vertex, 1, palette.data(), 1, modes[m], position.data(), normal.data());
+        float error = std::max(compareVertices(std::vector<glm::vec3>(1, expected), position),
+                               compareVertices(std::vector<glm::vec3>(1, vertex.Normal), normal));
+        report(names[m], error <= 1e-5f, "largest relative error " + std::to_string(error));
+    }
+}
+
+void testCpuSkinning() {
+    const unsigned int boneCount = 64;
+    const unsigned int vertexCount = 4099;
+    const float tolerance = 1e-5f;
+    std::mt19937 random(1234);
+    std::vector<glm::mat4> palette = makePalette(boneCount, random);
+    Mesh mesh = makeSkinnedMesh(vertexCount, boneCount, random);
+
+    std::vector<glm::vec3> referencePositions(vertexCount), referenceNormals(vertexCount);
+    CpuSkinner::SkinVerticesReference(mesh.vertices.data(), vertexCount, palette.data(), boneCount,
+                                      SkinningMode::Linear, referencePositions.data(), referenceNormals.data());
+
+    const SkinningKernel kernels[3] = { SkinningKernel::Scalar, SkinningKernel::SSE, SkinningKernel::AVX2 };
+    CpuSkinner skinner(4);
+    SkinnedVertices skinned;
+    for (SkinningKernel kernel : kernels) {
+        std::string name = std::string("cpu skinning, ") + CpuSkinner::GetKernelName(kernel);
+        if (kernel > CpuSkinner::DetectKernel()) {
+            std::cout << "SKIP " << name << ": not supported by this CPU" << std::endl;
+            continue;
+        }
+        skinner.SetKernel(kernel);
+        skinner.SkinMesh(mesh, palette.data(), boneCount, SkinningMode::Linear, skinned);
+        float error = std::max(compareVertices(referencePositions, skinned.positions),
+                               compareVertices(referenceNormals, skinned.normals));
+        report(name.c_str(), error <= tolerance, "largest relative error " + std::to_string(error));
+    }
+}
+
+// ===================== Occlusion Culling =====================
+
+BoundingVolume makeBounds(const glm::vec3& min, const glm::vec3& max) {
+    BoundingVolume bounds;
+    bounds.min = min;
+    bounds.max = max;
+    bounds.center = (min + max) * 0.5f;
+    bounds.radius = glm::length(max - min) * 0.5f;
+    return bounds;
+}
+
+// The eye sits at the origin looking down -z with a 0.1 near plane. A wall
+// five units away hides what is straight behind it and nothing else.
+void testOcclusionCuller() {
+    const glm::mat4 viewProjection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 100.0f);
+    OccluderMesh wall = OccluderMesh::MakeBox(glm::vec3(-2.0f, -2.0f, -6.0f), glm::vec3(2.0f, 2.0f, -5.0f));
+    std::vector<Occluder> occluders = { { &wall, glm::mat4(1.0f) } };
+
+    struct Case {
+        const char* name;
+        BoundingVolume box;
+        bool visible;
+    };
+    const Case cases[] = {
+        { "behind the wall", makeBounds(glm::vec3(-0.5f, -0.5f, -12.0f), glm::vec3(0.5f, 0.5f, -11.0f)), false },
+        { "beside the wall", makeBounds(glm::vec3(6.0f, -0.5f, -12.0f), glm::vec3(7.0f, 0.5f, -11.0f)), true },
+        { "partly behind the wall", makeBounds(glm::vec3(1.0f, -0.5f, -12.0f), glm::vec3(6.0f, 0.5f, -11.0f)), true },
+        { "in front of the wall", makeBounds(glm::vec3(-0.5f, -0.5f, -4.0f), glm::vec3(0.5f, 0.5f, -3.0f)), true },
+        { "crossing the near plane", makeBounds(glm::vec3(-0.5f, -0.5f, -1.0f), glm::vec3(0.5f, 0.5f, 1.0f)), true }
+    };
+    const unsigned int caseCount = sizeof(cases) / sizeof(cases[0]);
+
+    OcclusionCuller culler(2);
+    culler.Render(viewProjection, occluders);
+    report("occlusion, wall rasterized", culler.GetStats().occluderTriangles > 0,
+           std::to_string(culler.GetStats().occluderTriangles) + " triangles");
+    for (unsigned int i = 0; i < caseCount; i++) {
+        std::string name = std::string("occlusion, box ") + cases[i].name;
+        bool visible = culler.IsVisible(cases[i].box);
+        report(name.c_str(), visible == cases[i].visible, visible ? "visible" : "occluded");
+    }
+
+    // The threaded path must agree with the synchronous one
+    std::vector<BoundingVolume> boxes;
+    for (unsigned int i = 0; i < caseCount; i++) boxes.push_back(cases[i].box);
+    culler.Begin(viewProjection, occluders, boxes);
+    const std::vector<unsigned char>& visibility = culler.Finish();
+    bool agrees = visibility.size() == caseCount;
+    for (unsigned int i = 0; agrees && i < caseCount; i++) agrees = (visibility[i] != 0) == cases[i].visible;
+    report("occlusion, Begin/Finish", agrees, "");
+
+    // A wall between the eye and the near plane lies outside the frustum
+    // even though its w is positive, so it must hide nothing
+    OccluderMesh closeWall = OccluderMesh::MakeBox(glm::vec3(-1.0f, -1.0f, -0.08f), glm::vec3(1.0f, 1.0f, -0.06f));
+    std::vector<Occluder> closeOccluders = { { &closeWall, glm::mat4(1.0f) } };
+    culler.Render(viewProjection, closeOccluders);
+    report("occlusion, wall before the near plane skipped", culler.GetStats().occluderTriangles == 0,
+           std::to_string(culler.GetStats().occluderTriangles) + " triangles");
+    report("occlusion, box behind a wall before the near plane", culler.IsVisible(cases[0].box), "");
+}
+
+}
+
+int main() {
+    testRestPoseRule();
+    testCpuSkinning();
+    testOcclusionCuller();
+
+    if (failures > 0) {
+        std::cout << failures << " check(s) failed" << std::endl;
+        return 1;
+    }
+    std::cout << "All checks passed" << std::endl;
+    return 0;
+}
@@ -0,0 +1,95 @@
+#include "job_system.h"
+
+#include <algorithm>
+
+JobSystem::JobSystem(unsigned int threadCount) : busyWorkers(0) {
+    if (threadCount == 0) {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+    workerCount = threadCount;
+    slices.reset(new Slice[workerCount]);
+    for (unsigned int i = 0; i < workerCount; i++) {
+        slices[i].next.store(0);
+        slices[i].end = 0;
+    }
+
+    // Worker 0 is the thread calling ParallelFor
+    for (unsigned int i = 1; i < workerCount; i++) {
+        threads.push_back(std::thread(&JobSystem::WorkerLoop, this, i));
+    }
+}
+
+JobSystem::~JobSystem() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        quit = true;
+    }
+    wake.notify_all();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+unsigned int JobSystem::GetWorkerCount() const {
+    return workerCount;
+}
+
+void JobSystem::ParallelFor(unsigned int count, unsigned int grainSize, const RangeJob& job) {
+    if (count == 0) return;
+    grainSize = std::max(1u, grainSize);
+
+    if (threads.empty() || count <= grainSize) {
+        job(0, count, 0);
+        return;
+    }
+
+    unsigned int perWorker = (count + workerCount - 1) / workerCount;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (unsigned int i = 0; i < workerCount; i++) {
+            unsigned int begin = std::min(count, i * perWorker);
+            slices[i].next.store(begin, std::memory_order_relaxed);
+            slices[i].end = std::min(count, begin + perWorker);
+        }
+        currentJob = &job;
+        grain = grainSize;
+        busyWorkers.store((unsigned int)threads.size(), std::memory_order_relaxed);
+        generation++;
+    }
+    wake.notify_all();
+
+    RunSlices(0);
+
+    while (busyWorkers.load(std::memory_order_acquire) != 0) {
+        std::this_thread::yield();
+    }
+}
+
+void JobSystem::WorkerLoop(unsigned int worker) {
+    unsigned int seenGeneration = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [&] { return quit || generation != seenGeneration; });
+            if (quit) return;
+            seenGeneration = generation;
+        }
+
+        RunSlices(worker);
+        busyWorkers.fetch_sub(1, std::memory_order_release);
+    }
+}
+
+void JobSystem::RunSlices(unsigned int worker) {
+    const RangeJob& job = *currentJob;
+
+    // Own slice first, then steal from the others in a fixed order
+    for (unsigned int i = 0; i < workerCount; i++) {
+        Slice& slice = slices[(worker + i) % workerCount];
+        while (true) {
+            unsigned int begin = slice.next.fetch_add(grain, std::memory_order_relaxed);
+            if (begin >= slice.end) break;
+            job(begin, std::min(begin + grain, slice.end), worker);
+        }
+    }
+}
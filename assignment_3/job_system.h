@@ -0,0 +1,51 @@
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed pool of worker threads running data-parallel loops. Each ParallelFor
+// splits the range into one slice per worker; a worker claims chunks from its
+// own slice with an atomic increment and steals chunks from other slices once
+// it runs dry, so no locks are taken while items are being processed.
+class JobSystem {
+public:
+    // Called with a [begin, end) chunk and the index of the worker running it
+    typedef std::function<void(unsigned int begin, unsigned int end, unsigned int worker)> RangeJob;
+
+    // threadCount includes the calling thread; 0 uses every hardware thread
+    explicit JobSystem(unsigned int threadCount = 0);
+    ~JobSystem();
+
+    unsigned int GetWorkerCount() const;
+    void ParallelFor(unsigned int count, unsigned int grainSize, const RangeJob& job);
+
+private:
+    struct Slice {
+        std::atomic<unsigned int> next;
+        unsigned int end;
+        char padding[64 - sizeof(std::atomic<unsigned int>) - sizeof(unsigned int)];
+    };
+
+    std::vector<std::thread> threads;
+    std::unique_ptr<Slice[]> slices;
+    unsigned int workerCount;
+
+    const RangeJob* currentJob = nullptr;
+    unsigned int grain = 1;
+    unsigned int generation = 0;
+    bool quit = false;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::atomic<unsigned int> busyWorkers;
+
+    void WorkerLoop(unsigned int worker);
+    void RunSlices(unsigned int worker);
+};
+
+#endif
@@ -1,478 +1,1103 @@
-#include <glad/glad.h>
-#include <GLFW/glfw3.h>
-#include <glm/glm.hpp>
-#include <glm/gtc/matrix_transform.hpp>
-#include <glm/gtc/type_ptr.hpp>
-
-#include "shader.h"
-#include "mesh.h"
-#include "model.h"
-
-#include <iostream>
-#include <vector>
-#include <cstdlib>
-#include <ctime>
-
-// ===================== Game Object =====================
-struct GameObject {
-    glm::vec3 position;
-    glm::vec3 scale;
-    float rotation;
-    Model* model;
-    float boundingRadius;
-    bool active;
-    
-    GameObject(Model* m, glm::vec3 pos, float rad = 1.0f) 
-    : model(m), position(pos), scale(1.0f), rotation(0.0f), boundingRadius(rad), active(true) {}
-    
-    void draw(Shader& shader) {
-        if (!active) return;
-        
-        glm::mat4 modelMat = glm::mat4(1.0f);
-        modelMat = glm::translate(modelMat, position);
-        modelMat = glm::rotate(modelMat, rotation, glm::vec3(0.0f, 1.0f, 0.0f));
-        modelMat = glm::scale(modelMat, scale);
-        shader.setMat4("model", modelMat);
-        model->Draw(shader);
-    }
-    
-    bool checkCollision(const GameObject& other) {
-        if (!active || !other.active) return false;
-        float distance = glm::length(position - other.position);
-        return distance < (boundingRadius + other.boundingRadius);
-    }
-};
-
-// ===================== Camera =====================
-class Camera {
-public:
-    glm::vec3 position;
-    glm::vec3 target;
-    glm::vec3 up;
-    float distance;
-    float height;
-    
-    Camera(glm::vec3 pos = glm::vec3(0.0f, 5.0f, 10.0f)) 
-    : position(pos), target(0.0f), up(0.0f, 1.0f, 0.0f), distance(10.0f), height(5.0f) {}
-    
-    void followTarget(glm::vec3 targetPos) {
-        target = targetPos;
-        position = target - glm::vec3(0.0f, -height, distance);
-    }
-    
-    glm::mat4 getViewMatrix() {
-        return glm::lookAt(position, target, up);
-    }
-};
-
-// ===================== Global Variables =====================
-const unsigned int SCR_WIDTH = 1280;
-const unsigned int SCR_HEIGHT = 720;
-float deltaTime = 0.0f;
-float lastFrame = 0.0f;
-
-// Input
-bool keys[1024];
-void key_callback(GLFWwindow* window, int key, int scancode, int action, int mode) {
-    if (key >= 0 && key < 1024) {
-        if (action == GLFW_PRESS) keys[key] = true;
-        else if (action == GLFW_RELEASE) keys[key] = false;
-    }
-}
-
-// ===================== Simple Cube Model Generator =====================
-Model* createCubeModel() {
-    std::vector<Vertex> vertices;
-    std::vector<unsigned int> indices;
-    
-    // Simple cube vertices
-    float cubeVertices[] = {
-        -0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  0.0f, 0.0f,
-         0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  1.0f, 0.0f,
-         0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  1.0f, 1.0f,
-        -0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  0.0f, 1.0f,
-        
-        -0.5f, -0.5f,  0.5f,  0.0f,  0.0f,  1.0f,  0.0f, 0.0f,
-         0.5f, -0.5f,  0.5f,  0.0f,  0.0f,  1.0f,  1.0f, 0.0f,
-         0.5f,  0.5f,  0.5f,  0.0f,  0.0f,  1.0f,  1.0f, 1.0f,
-        -0.5f,  0.5f,  0.5f,  0.0f,  0.0f,  1.0f,  0.0f, 1.0f
-    };
-    
-    for (int i = 0; i < 8; i++) {
-        Vertex v;
-        v.Position = glm::vec3(cubeVertices[i*8], cubeVertices[i*8+1], cubeVertices[i*8+2]);
-        v.Normal = glm::vec3(cubeVertices[i*8+3], cubeVertices[i*8+4], cubeVertices[i*8+5]);
-        v.TexCoords = glm::vec2(cubeVertices[i*8+6], cubeVertices[i*8+7]);
-        vertices.push_back(v);
-    }
-    
-    unsigned int cubeIndices[] = {
-        0, 1, 2, 2, 3, 0,
-        4, 5, 6, 6, 7, 4,
-        0, 1, 5, 5, 4, 0,
-        2, 3, 7, 7, 6, 2,
-        0, 3, 7, 7, 4, 0,
-        1, 2, 6, 6, 5, 1
-    };
-    
-    for (int i = 0; i < 36; i++) {
-        indices.push_back(cubeIndices[i]);
-    }
-    
-    std::vector<Texture> textures;
-    std::vector<Mesh> meshes;
-    meshes.push_back(Mesh(vertices, indices, textures));
-    
-    Model* model = new Model("");
-    model->meshes = meshes;
-    return model;
-}
-
-Model* loadModelFromFile(const char* filepath) {
-    std::cout << "========================================" << std::endl;
-    std::cout << "Attempting to load model from: " << filepath << std::endl;
-    
-    Model* model = nullptr;
-    try {
-        model = new Model(filepath);
-        
-        if (model->meshes.empty()) {
-            std::cout << "ERROR: Model loaded but contains no meshes!" << std::endl;
-            delete model;
-            model = nullptr;
-        } else {
-            std::cout << "SUCCESS: Model loaded!" << std::endl;
-            std::cout << "Number of meshes: " << model->meshes.size() << std::endl;
-            return model;
-        }
-    }
-    catch (const std::exception& e) {
-        std::cout << "ERROR: Exception while loading model: " << e.what() << std::endl;
-        if (model) delete model;
-        model = nullptr;
-    }
-    
-    std::cout << "Creating fallback cube model..." << std::endl;
-    return createCubeModel();
-}
-
-// ===================== Main Function =====================
-int main() {
-    srand(time(NULL));
-    
-    // Initialize GLFW
-    glfwInit();
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-    
-    GLFWwindow* window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "3D Adventure Game", NULL, NULL);
-    if (window == NULL) {
-        std::cout << "Failed to create GLFW window" << std::endl;
-        glfwTerminate();
-        return -1;
-    }
-    glfwMakeContextCurrent(window);
-    glfwSetKeyCallback(window, key_callback);
-    
-    // Initialize GLAD
-    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
-        std::cout << "Failed to initialize GLAD" << std::endl;
-        return -1;
-    }
-    
-    glEnable(GL_DEPTH_TEST);
-    
-    // Create shader
-    const char* vertexShaderSource = R"(
-        #version 330 core
-        layout (location = 0) in vec3 aPos;
-        layout (location = 1) in vec3 aNormal;
-        layout (location = 2) in vec2 aTexCoords;
-        layout (location = 3) in ivec4 aBoneIDs;
-        layout (location = 4) in vec4 aWeights;
-        
-        out vec3 FragPos;
-        out vec3 Normal;
-        out vec2 TexCoords;
-        
-        uniform mat4 model;
-        uniform mat4 view;
-        uniform mat4 projection;
-        uniform mat4 boneTransforms[100];
-        uniform bool hasAnimation;
-        
-        void main() {
-            vec4 totalPosition = vec4(0.0);
-            vec3 totalNormal = vec3(0.0);
-            float totalWeight = 0.0;
-            
-            if(hasAnimation) {
-                for(int i = 0; i < 4; i++) {
-                    if(aBoneIDs[i] == -1) continue;
-                    if(aBoneIDs[i] >= 100) {
-                        totalPosition = vec4(aPos, 1.0);
-                        totalNormal = aNormal;
-                        totalWeight = 1.0;
-                        break;
-                    }
-                    vec4 localPosition = boneTransforms[aBoneIDs[i]] * vec4(aPos, 1.0);
-                    totalPosition += localPosition * aWeights[i];
-                    vec3 localNormal = mat3(boneTransforms[aBoneIDs[i]]) * aNormal;
-                    totalNormal += localNormal * aWeights[i];
-                    totalWeight += aWeights[i];
-                }
-                
-                if(totalWeight == 0.0) {
-                    totalPosition = vec4(aPos, 1.0);
-                    totalNormal = aNormal;
-                }
-            } else {
-                totalPosition = vec4(aPos, 1.0);
-                totalNormal = aNormal;
-            }
-            
-            FragPos = vec3(model * totalPosition);
-            Normal = mat3(transpose(inverse(model))) * totalNormal;
-            TexCoords = aTexCoords;
-            gl_Position = projection * view * vec4(FragPos, 1.0);
-        }
-    )";
-    
-    const char* fragmentShaderSource = R"(
-        #version 330 core
-        out vec4 FragColor;
-        
-        in vec3 FragPos;
-        in vec3 Normal;
-        in vec2 TexCoords;
-        
-        uniform vec3 objectColor;
-        uniform vec3 lightPos;
-        uniform vec3 viewPos;
-        uniform sampler2D texture_diffuse;
-        uniform bool useTexture;
-        
-        void main() {
-            vec3 baseColor;
-            if (useTexture) {
-                baseColor = texture(texture_diffuse, TexCoords).rgb;
-            } else {
-                baseColor = objectColor;
-            }
-            
-            vec3 ambient = 0.3 * baseColor;
-            
-            vec3 norm = normalize(Normal);
-            vec3 lightDir = normalize(lightPos - FragPos);
-            float diff = max(dot(norm, lightDir), 0.0);
-            vec3 diffuse = diff * baseColor;
-            
-            vec3 viewDir = normalize(viewPos - FragPos);
-            vec3 reflectDir = reflect(-lightDir, norm);
-            float spec = pow(max(dot(viewDir, reflectDir), 0.0), 32);
-            vec3 specular = 0.5 * spec * vec3(1.0);
-            
-            vec3 result = ambient + diffuse + specular;
-            FragColor = vec4(result, 1.0);
-        }
-    )";
-    
-    unsigned int vertexShader = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertexShader, 1, &vertexShaderSource, NULL);
-    glCompileShader(vertexShader);
-    
-    unsigned int fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragmentShader, 1, &fragmentShaderSource, NULL);
-    glCompileShader(fragmentShader);
-    
-    unsigned int shaderProgram = glCreateProgram();
-    glAttachShader(shaderProgram, vertexShader);
-    glAttachShader(shaderProgram, fragmentShader);
-    glLinkProgram(shaderProgram);
-    
-    glDeleteShader(vertexShader);
-    glDeleteShader(fragmentShader);
-    
-    // Create simple cube model
-    Model* cubeModel = createCubeModel();
-    
-    // Create game objects
-    Model* playerModel = loadModelFromFile("Swimming.dae");
-    GameObject player(playerModel, glm::vec3(0.0f, 0.5f, 0.0f), 0.8f);
-    player.scale = glm::vec3(0.01f, 0.01f, 0.01f);
-
-    std::cout << "Player model loaded. Meshes: " << playerModel->meshes.size() << std::endl;
-    std::cout << "Textures loaded: " << playerModel->textures_loaded.size() << std::endl;
-    
-    std::vector<GameObject> obstacles;
-    obstacles.push_back(GameObject(cubeModel, glm::vec3(5.0f, 0.5f, 0.0f), 1.0f));
-    obstacles.push_back(GameObject(cubeModel, glm::vec3(-5.0f, 0.5f, 5.0f), 1.0f));
-    obstacles.push_back(GameObject(cubeModel, glm::vec3(0.0f, 0.5f, -8.0f), 1.0f));
-    
-    std::vector<GameObject> collectibles;
-    for (int i = 0; i < 5; i++) {
-        float x = (rand() % 20 - 10);
-        float z = (rand() % 20 - 10);
-        collectibles.push_back(GameObject(cubeModel, glm::vec3(x, 0.5f, z), 0.5f));
-        collectibles.back().scale = glm::vec3(0.5f);
-    }
-    
-    // Create ground
-    GameObject ground(cubeModel, glm::vec3(0.0f, -1.0f, 0.0f), 0.0f);
-    ground.scale = glm::vec3(30.0f, 0.5f, 30.0f);
-    
-    // Camera
-    Camera camera;
-    
-    int score = 0;
-    float playerSpeed = 5.0f;
-    
-    // Game loop
-    while (!glfwWindowShouldClose(window)) {
-        float currentFrame = glfwGetTime();
-        deltaTime = currentFrame - lastFrame;
-        lastFrame = currentFrame;
-        
-        // Update player animation
-        playerModel->UpdateAnimation(deltaTime);
-        
-        // Input processing (camera-relative movement)
-        glm::vec3 moveDirection(0.0f);
-
-        // Calculate camera's forward and right vectors
-        glm::vec3 cameraForward = glm::normalize(player.position - camera.position);
-        cameraForward.y = 0.0f;
-        if (glm::length(cameraForward) > 0.0f) {
-            cameraForward = glm::normalize(cameraForward);
-        }
-        glm::vec3 cameraRight = glm::normalize(glm::cross(cameraForward, glm::vec3(0.0f, 1.0f, 0.0f)));
-
-        // ESC to exit
-        if (keys[GLFW_KEY_ESCAPE]) {
-            glfwSetWindowShouldClose(window, true);
-        }
-
-        // WASD movement relative to camera
-        if (keys[GLFW_KEY_W]) moveDirection += cameraForward;
-        if (keys[GLFW_KEY_S]) moveDirection -= cameraForward;
-        if (keys[GLFW_KEY_A]) moveDirection -= cameraRight;
-        if (keys[GLFW_KEY_D]) moveDirection += cameraRight;
-
-        // Apply movement
-        if (glm::length(moveDirection) > 0.0f) {
-            moveDirection = glm::normalize(moveDirection);
-            glm::vec3 newPos = player.position + moveDirection * playerSpeed * deltaTime;
-
-            // Check collision with obstacles
-            bool collision = false;
-            GameObject tempPlayer = player;
-            tempPlayer.position = newPos;
-
-            for (auto& obstacle : obstacles) {
-                if (tempPlayer.checkCollision(obstacle)) {
-                    collision = true;
-                    break;
-                }
-            }
-
-            if (!collision) {
-                player.position = newPos;
-            }
-
-            // Rotate player to face movement direction
-            player.rotation = atan2(moveDirection.x, moveDirection.z);
-        }
-
-        // Check collectibles
-        for (auto& collectible : collectibles) {
-            if (player.checkCollision(collectible)) {
-                collectible.active = false;
-                score++;
-                std::cout << "Score: " << score << std::endl;
-            }
-        }
-
-        // Update camera
-        camera.followTarget(player.position);
-        
-        // Rendering
-        glClearColor(0.1f, 0.1f, 0.15f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        
-        glUseProgram(shaderProgram);
-        
-        glm::mat4 projection = glm::perspective(glm::radians(45.0f), 
-            (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-        glm::mat4 view = camera.getViewMatrix();
-        
-        glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
-        glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "view"), 1, GL_FALSE, glm::value_ptr(view));
-        glUniform3fv(glGetUniformLocation(shaderProgram, "lightPos"), 1, glm::value_ptr(glm::vec3(10.0f, 10.0f, 10.0f)));
-        glUniform3fv(glGetUniformLocation(shaderProgram, "viewPos"), 1, glm::value_ptr(camera.position));
-        
-        // Draw ground
-        glUniform3f(glGetUniformLocation(shaderProgram, "objectColor"), 0.3f, 0.5f, 0.3f);
-        glUniform1i(glGetUniformLocation(shaderProgram, "hasAnimation"), false);
-        glUniform1i(glGetUniformLocation(shaderProgram, "useTexture"), false);
-        glm::mat4 model = glm::mat4(1.0f);
-        model = glm::translate(model, ground.position);
-        model = glm::scale(model, ground.scale);
-        glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "model"), 1, GL_FALSE, glm::value_ptr(model));
-        ground.model->Draw(*((Shader*)&shaderProgram));
-        
-        // Draw player with animation
-        glUniform3f(glGetUniformLocation(shaderProgram, "objectColor"), 0.2f, 0.5f, 0.9f);
-        glUniform1i(glGetUniformLocation(shaderProgram, "hasAnimation"), true);
-        
-        // Set bone transforms
-        std::vector<glm::mat4>& transforms = playerModel->GetBoneTransforms();
-        for (unsigned int i = 0; i < transforms.size(); i++) {
-            std::string uniformName = "boneTransforms[" + std::to_string(i) + "]";
-            glUniformMatrix4fv(glGetUniformLocation(shaderProgram, uniformName.c_str()), 1, GL_FALSE, glm::value_ptr(transforms[i]));
-        }
-        
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, player.position);
-        model = glm::rotate(model, player.rotation, glm::vec3(0.0f, 1.0f, 0.0f));
-        model = glm::scale(model, player.scale);
-        glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "model"), 1, GL_FALSE, glm::value_ptr(model));
-        player.model->Draw(*((Shader*)&shaderProgram));
-        
-        // Draw obstacles
-        glUniform1i(glGetUniformLocation(shaderProgram, "hasAnimation"), false);
-        glUniform1i(glGetUniformLocation(shaderProgram, "useTexture"), false);
-        glUniform3f(glGetUniformLocation(shaderProgram, "objectColor"), 0.8f, 0.2f, 0.2f);
-        for (auto& obstacle : obstacles) {
-            model = glm::mat4(1.0f);
-            model = glm::translate(model, obstacle.position);
-            model = glm::scale(model, obstacle.scale);
-            glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "model"), 1, GL_FALSE, glm::value_ptr(model));
-            obstacle.model->Draw(*((Shader*)&shaderProgram));
-        }
-        
-        // Draw collectibles
-        glUniform3f(glGetUniformLocation(shaderProgram, "objectColor"), 1.0f, 0.8f, 0.0f);
-        for (auto& collectible : collectibles) {
-            if (collectible.active) {
-                collectible.rotation += deltaTime * 2.0f;
-                model = glm::mat4(1.0f);
-                model = glm::translate(model, collectible.position);
-                model = glm::rotate(model, collectible.rotation, glm::vec3(0.0f, 1.0f, 0.0f));
-                model = glm::scale(model, collectible.scale);
-                glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "model"), 1, GL_FALSE, glm::value_ptr(model));
-                collectible.model->Draw(*((Shader*)&shaderProgram));
-            }
-        }
-        
-        glfwSwapBuffers(window);
-        glfwPollEvents();
-    }
-    
-    // Cleanup
-    delete cubeModel;
-    delete playerModel;
-    
-    glfwTerminate();
-    return 0;
-}
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "shader.h"
+#include "shader_variants.h"
+#include "mesh.h"
+#include "model.h"
+#include "animation_system.h"
+#include "bone_palette.h"
+#include "cpu_skinning.h"
+#include "animation_baker.h"
+#include "crowd_renderer.h"
+#include "clip_streamer.h"
+#include "pre_skinner.h"
+#include "gl_state.h"
+#include "mesh_pool.h"
+#include "render_queue.h"
+#include "frustum_culler.h"
+#include "stream_buffer.h"
+#include "uniform_blocks.h"
+#include "occlusion_culler.h"
+#include "program_cache.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <iostream>
+#include <vector>
+#include <cstdlib>
+#include <ctime>
+
+// ===================== Game Object =====================
+struct GameObject {
+    glm::vec3 position;
+    glm::vec3 scale;
+    float rotation;
+    Model* model;
+    float boundingRadius;
+    bool active;
+    BoundingVolume poseBounds;   // model-space bounds of the current pose, empty for static objects
+    
+    GameObject(Model* m, glm::vec3 pos, float rad = 1.0f) 
+    : model(m), position(pos), scale(1.0f), rotation(0.0f), boundingRadius(rad), active(true) {}
+    
+    // Sphere around the object for culling, from the radius of its model
+    glm::vec4 getCullingSphere(float modelRadius) const {
+        float largestScale = std::max(scale.x, std::max(scale.y, scale.z));
+        return glm::vec4(position, modelRadius * largestScale);
+    }
+    
+    glm::mat4 getModelMatrix() const {
+        glm::mat4 modelMat = glm::mat4(1.0f);
+        modelMat = glm::translate(modelMat, position);
+        modelMat = glm::rotate(modelMat, rotation, glm::vec3(0.0f, 1.0f, 0.0f));
+        modelMat = glm::scale(modelMat, scale);
+        return modelMat;
+    }
+    
+    void draw(Shader& shader, UniformBlocks& uniformBlocks) {
+        if (!active) return;
+        
+        ObjectBlock object;
+        object.SetModel(getModelMatrix());
+        uniformBlocks.SetObject(object);
+        model->Draw(shader);
+    }
+    
+    bool checkCollision(const GameObject& other) {
+        if (!active || !other.active) return false;
+        // Animated objects collide with the box around their current pose
+        if (!poseBounds.IsEmpty()) {
+            return poseBounds.Transform(getModelMatrix()).IntersectsSphere(other.position, other.boundingRadius);
+        }
+        if (!other.poseBounds.IsEmpty()) {
+            return other.poseBounds.Transform(other.getModelMatrix()).IntersectsSphere(position, boundingRadius);
+        }
+        float distance = glm::length(position - other.position);
+        return distance < (boundingRadius + other.boundingRadius);
+    }
+};
+
+// ===================== Camera =====================
+class Camera {
+public:
+    glm::vec3 position;
+    glm::vec3 target;
+    glm::vec3 up;
+    float distance;
+    float height;
+    
+    Camera(glm::vec3 pos = glm::vec3(0.0f, 5.0f, 10.0f)) 
+    : position(pos), target(0.0f), up(0.0f, 1.0f, 0.0f), distance(10.0f), height(5.0f) {}
+    
+    void followTarget(glm::vec3 targetPos) {
+        target = targetPos;
+        position = target - glm::vec3(0.0f, -height, distance);
+    }
+    
+    glm::mat4 getViewMatrix() {
+        return glm::lookAt(position, target, up);
+    }
+};
+
+// ===================== Global Variables =====================
+const unsigned int SCR_WIDTH = 1280;
+const unsigned int SCR_HEIGHT = 720;
+// Bytes of uniform blocks per stream buffer region
+const unsigned int STREAM_REGION_SIZE = 4 * 1024 * 1024;
+// Starting bytes of render queue instances per frame; grows with the scene
+const unsigned int INSTANCE_REGION_SIZE = 1024 * 1024;
+// Bytes of bone palettes per frame; less where the texture buffer limit is lower
+const unsigned int PALETTE_REGION_SIZE = 1024 * 1024;
+float deltaTime = 0.0f;
+float lastFrame = 0.0f;
+
+// Input
+bool keys[1024];
+void key_callback(GLFWwindow* window, int key, int scancode, int action, int mode) {
+    if (key >= 0 && key < 1024) {
+        if (action == GLFW_PRESS) keys[key] = true;
+        else if (action == GLFW_RELEASE) keys[key] = false;
+    }
+}
+
+// Distance of the farthest vertex from the model origin
+float getModelRadius(const Model* model) {
+    float radius = 0.0f;
+    for (const auto& mesh : model->meshes) {
+        for (const auto& vertex : mesh.vertices) {
+            radius = std::max(radius, glm::length(vertex.Position));
+        }
+    }
+    return radius;
+}
+
+// Model-space box around all of a model's vertices
+BoundingVolume getModelBounds(const Model* model) {
+    BoundingVolume bounds;
+    bounds.min = glm::vec3(FLT_MAX);
+    bounds.max = glm::vec3(-FLT_MAX);
+    for (const auto& mesh : model->meshes) {
+        for (const auto& vertex : mesh.vertices) {
+            bounds.min = glm::min(bounds.min, vertex.Position);
+            bounds.max = glm::max(bounds.max, vertex.Position);
+        }
+    }
+    bounds.center = (bounds.min + bounds.max) * 0.5f;
+    bounds.radius = glm::length(bounds.max - bounds.center);
+    return bounds;
+}
+
+// ===================== Simple Cube Model Generator =====================
+Model* createCubeModel() {
+    std::vector<Vertex> vertices;
+    std::vector<unsigned int> indices;
+    
+    // Simple cube vertices
+    float cubeVertices[] = {
+        -0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  0.0f, 0.0f,
+         0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  1.0f, 0.0f,
+         0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  1.0f, 1.0f,
+        -0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  0.0f, 1.0f,
+        
+        -0.5f, -0.5f,  0.5f,  0.0f,  0.0f,  1.0f,  0.0f, 0.0f,
+         0.5f, -0.5f,  0.5f,  0.0f,  0.0f,  1.0f,  1.0f, 0.0f,
+         0.5f,  0.5f,  0.5f,  0.0f,  0.0f,  1.0f,  1.0f, 1.0f,
+        -0.5f,  0.5f,  0.5f,  0.0f,  0.0f,  1.0f,  0.0f, 1.0f
+    };
+    
+    for (int i = 0; i < 8; i++) {
+        Vertex v;
+        v.Position = glm::vec3(cubeVertices[i*8], cubeVertices[i*8+1], cubeVertices[i*8+2]);
+        v.Normal = glm::vec3(cubeVertices[i*8+3], cubeVertices[i*8+4], cubeVertices[i*8+5]);
+        v.TexCoords = glm::vec2(cubeVertices[i*8+6], cubeVertices[i*8+7]);
+        vertices.push_back(v);
+    }
+    
+    unsigned int cubeIndices[] = {
+        0, 1, 2, 2, 3, 0,
+        4, 5, 6, 6, 7, 4,
+        0, 1, 5, 5, 4, 0,
+        2, 3, 7, 7, 6, 2,
+        0, 3, 7, 7, 4, 0,
+        1, 2, 6, 6, 5, 1
+    };
+    
+    for (int i = 0; i < 36; i++) {
+        indices.push_back(cubeIndices[i]);
+    }
+    
+    std::vector<Texture> textures;
+    std::vector<Mesh> meshes;
+    meshes.push_back(Mesh(vertices, indices, textures));
+    
+    Model* model = new Model("");
+    model->meshes = meshes;
+    return model;
+}
+
+Model* loadModelFromFile(const char* filepath) {
+    std::cout << "========================================" << std::endl;
+    std::cout << "Attempting to load model from: " << filepath << std::endl;
+    
+    Model* model = nullptr;
+    try {
+        model = new Model(filepath);
+        
+        if (model->meshes.empty()) {
+            std::cout << "ERROR: Model loaded but contains no meshes!" << std::endl;
+            delete model;
+            model = nullptr;
+        } else {
+            std::cout << "SUCCESS: Model loaded!" << std::endl;
+            std::cout << "Number of meshes: " << model->meshes.size() << std::endl;
+            return model;
+        }
+    }
+    catch (const std::exception& e) {
+        std::cout << "ERROR: Exception while loading model: " << e.what() << std::endl;
+        if (model) delete model;
+        model = nullptr;
+    }
+    
+    std::cout << "Creating fallback cube model..." << std::endl;
+    return createCubeModel();
+}
+
+// ===================== Command Line =====================
+int getIntArgument(int argc, char** argv, const char* name, int fallback) {
+    for (int i = 1; i + 1 < argc; i++) {
+        if (std::string(argv[i]) == name) return atoi(argv[i + 1]);
+    }
+    return fallback;
+}
+
+const char* getStringArgument(int argc, char** argv, const char* name, const char* fallback) {
+    for (int i = 1; i + 1 < argc; i++) {
+        if (std::string(argv[i]) == name) return argv[i + 1];
+    }
+    return fallback;
+}
+
+// Per-frame averages of a stream buffer, if it saw any frames
+void printStreamStats(const char* name, const StreamBuffer& stream) {
+    if (stream.GetFrameCount() == 0) return;
+    const StreamBufferStats& stats = stream.GetTotalStats();
+    std::cout << name << ": " << stats.bytes / stream.GetFrameCount() / 1024 << " KB per frame, "
+              << stats.fenceWaits << " fence waits (" << stats.waitMilliseconds << " ms), "
+              << stats.orphans << " orphans" << std::endl;
+}
+
+// ===================== Skinning Benchmark =====================
+// Draws the model once per skinning mode with the rasterizer disabled, so the
+// GPU timer only sees vertex work, and reports the palette upload size.
+void runSkinningBenchmark(ShaderVariants& shaders, Model* model, const glm::mat4* palette, unsigned int boneCount,
+                          BonePaletteBuffer* bonePalette, UniformBlocks& uniformBlocks, StreamBuffer& stream) {
+    const int frames = 200;
+    const SkinningMode modes[2] = { SkinningMode::Linear, SkinningMode::DualQuaternion };
+    const char* names[2] = { "Linear blend   ", "Dual quaternion" };
+    
+    unsigned int query;
+    glGenQueries(1, &query);
+    uniformBlocks.SetCamera(CameraBlock());
+    uniformBlocks.SetObject(ObjectBlock());
+    glEnable(GL_RASTERIZER_DISCARD);
+    std::vector<unsigned int> meshTexels(model->meshes.size());
+    
+    std::cout << "Skinning benchmark: " << boneCount << " bones, " << frames << " frames" << std::endl;
+    unsigned int meshBones = 0;
+    for (const auto& mesh : model->meshes) meshBones += (unsigned int)mesh.bones.size();
+    std::cout << "  mat4 uniforms  : " << boneCount * sizeof(glm::mat4) << " bytes/frame" << std::endl;
+    std::cout << "  per-mesh bones : " << meshBones << " uploaded for " << model->meshes.size() << " meshes" << std::endl;
+    for (int m = 0; m < 2; m++) {
+        GLuint64 totalTime = 0;
+        for (int frame = 0; frame < frames; frame++) {
+            stream.BeginFrame();
+            uniformBlocks.BeginFrame();
+            bonePalette->Begin();
+            for (size_t i = 0; i < model->meshes.size(); i++) {
+                meshTexels[i] = bonePalette->Add(palette, model->meshes[i].bones, modes[m]);
+            }
+            bonePalette->Finish();
+            bonePalette->Bind();
+            unsigned int key = ShaderVariants::MakeKey(modes[m] == SkinningMode::DualQuaternion ? SHADER_DUAL_QUATERNION : 0);
+            
+            glBeginQuery(GL_TIME_ELAPSED, query);
+            model->DrawSkinned(shaders, key, meshTexels.data());
+            glEndQuery(GL_TIME_ELAPSED);
+            
+            GLuint64 elapsed = 0;
+            glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsed);
+            totalTime += elapsed;
+        }
+        std::cout << "  " << names[m] << ": " << bonePalette->GetUploadedBytes() << " bytes/frame, "
+                  << (double)totalTime / frames / 1.0e6 << " ms vertex stage" << std::endl;
+    }
+    
+    glDisable(GL_RASTERIZER_DISCARD);
+    glDeleteQueries(1, &query);
+}
+
+// Times every CPU skinning kernel on the model and reports its largest
+// deviation from the scalar reference.
+void runCpuSkinningBenchmark(const Model* model, const glm::mat4* palette, unsigned int boneCount) {
+    const int runs = 50;
+    const SkinningMode modes[2] = { SkinningMode::Linear, SkinningMode::DualQuaternion };
+    const SkinningKernel kernels[3] = { SkinningKernel::Scalar, SkinningKernel::SSE, SkinningKernel::AVX2 };
+    CpuSkinner skinner;
+    SkinnedVertices skinned;
+    std::vector<glm::vec3> referencePositions, referenceNormals;
+    std::vector<glm::mat4> meshPalette;
+    
+    std::cout << "CPU skinning (best kernel: " << CpuSkinner::GetKernelName(CpuSkinner::DetectKernel()) << ")" << std::endl;
+    for (int m = 0; m < 2; m++) {
+        for (int k = 0; k < 3; k++) {
+            skinner.SetKernel(kernels[k]);
+            if (skinner.GetKernel() != kernels[k]) continue;
+            
+            double totalTime = 0.0;
+            float maxError = 0.0f;
+            for (const Mesh& mesh : model->meshes) {
+                unsigned int count = (unsigned int)mesh.vertices.size();
+                referencePositions.resize(count);
+                referenceNormals.resize(count);
+                mesh.GatherBonePalette(palette, meshPalette);
+                CpuSkinner::SkinVerticesReference(mesh.vertices.data(), count, meshPalette.data(),
+                                                  (unsigned int)meshPalette.size(), modes[m],
+                                                  referencePositions.data(), referenceNormals.data());
+                
+                auto start = std::chrono::high_resolution_clock::now();
+                for (int run = 0; run < runs; run++) {
+                    skinner.SkinMesh(mesh, palette, boneCount, modes[m], skinned);
+                }
+                totalTime += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+                
+                for (unsigned int v = 0; v < count; v++) {
+                    maxError = std::max(maxError, glm::length(skinned.positions[v] - referencePositions[v]));
+                    maxError = std::max(maxError, glm::length(skinned.normals[v] - referenceNormals[v]));
+                }
+            }
+            std::cout << "  " << (modes[m] == SkinningMode::Linear ? "Linear blend   " : "Dual quaternion") << " "
+                      << CpuSkinner::GetKernelName(kernels[k]) << ": " << totalTime / runs << " ms, max error "
+                      << maxError << std::endl;
+        }
+    }
+}
+
+// ===================== Main Function =====================
+int main(int argc, char** argv) {
+    srand(time(NULL));
+    
+    // Initialize GLFW
+    glfwInit();
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    
+    GLFWwindow* window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "3D Adventure Game", NULL, NULL);
+    if (window == NULL) {
+        std::cout << "Failed to create GLFW window" << std::endl;
+        glfwTerminate();
+        return -1;
+    }
+    glfwMakeContextCurrent(window);
+    glfwSetKeyCallback(window, key_callback);
+    
+    // Initialize GLAD
+    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
+        std::cout << "Failed to initialize GLAD" << std::endl;
+        return -1;
+    }
+    // glad stops at 3.3; multi-draw indirect is loaded separately on 4.3 contexts
+    if (MeshPool::LoadMultiDraw((GLADloadproc)glfwGetProcAddress)) {
+        std::cout << "Static meshes: glMultiDrawElementsIndirect" << std::endl;
+    } else {
+        std::cout << "Static meshes: glDrawElementsInstancedBaseVertex per mesh" << std::endl;
+    }
+    // Per-frame data goes through one ring buffer, persistently mapped on 4.4
+    if (StreamBuffer::LoadBufferStorage((GLADloadproc)glfwGetProcAddress)) {
+        std::cout << "Streaming: persistently mapped buffer" << std::endl;
+    } else {
+        std::cout << "Streaming: unsynchronized mapping with orphaning" << std::endl;
+    }
+    StreamBuffer* streamBuffer = new StreamBuffer(STREAM_REGION_SIZE);
+    // Linked programs are kept on disk, so later launches skip compiling GLSL
+    const char* programCacheDirectory = getStringArgument(argc, argv, "--program-cache", "shader_cache");
+    if (ProgramCache::Get().Init((GLADloadproc)glfwGetProcAddress, programCacheDirectory)) {
+        std::cout << "Program cache: " << programCacheDirectory << std::endl;
+    } else {
+        std::cout << "Program cache: no program binaries, compiling from source" << std::endl;
+    }
+    
+    glEnable(GL_DEPTH_TEST);
+    
+    // Scene shaders; ShaderVariants compiles them once per combination of
+    // SKINNED, DUAL_QUATERNION, TEXTURED, INSTANCED, BONE_INFLUENCES and
+    // LIGHT_COUNT that is drawn
+    const char* vertexShaderSource = R"(
+        #version 330 core
+        layout (location = 0) in vec3 aPos;
+        layout (location = 1) in vec3 aNormal;
+        layout (location = 2) in vec2 aTexCoords;
+        layout (location = 3) in ivec4 aBoneIDs;
+        layout (location = 4) in vec4 aWeights;
+        layout (location = 10) in mat4 aInstanceModel;   // RenderQueue instances
+        layout (location = 14) in vec4 aInstanceColor;
+        
+        out vec3 FragPos;
+        out vec3 Normal;
+        out vec2 TexCoords;
+        out vec4 InstanceColor;
+        
+        #ifdef SKINNED
+        uniform samplerBuffer boneTransforms;  // bone palette, see BonePaletteBuffer
+        uniform int boneTexelOffset;           // first texel of this mesh's palette
+        
+        // Unused slots hold bone -1 with weight 0; bone 0 reads valid data
+        // from the mesh's own palette and the weight cancels it. Bone ids are
+        // below the palette size by construction (Model::RemapBonesToMesh).
+        int getBone(int slot) {
+            return max(aBoneIDs[slot], 0);
+        }
+        
+        #ifndef DUAL_QUATERNION
+        mat4 getBoneTransform(int bone) {
+            int texel = boneTexelOffset + bone * 3;
+            vec4 row0 = texelFetch(boneTransforms, texel);
+            vec4 row1 = texelFetch(boneTransforms, texel + 1);
+            vec4 row2 = texelFetch(boneTransforms, texel + 2);
+            return mat4(row0.x, row1.x, row2.x, 0.0,
+                        row0.y, row1.y, row2.y, 0.0,
+                        row0.z, row1.z, row2.z, 0.0,
+                        row0.w, row1.w, row2.w, 1.0);
+        }
+        
+        // Weight the influences do not cover stays in the rest pose, so
+        // vertices without any are left where they are
+        void skin(inout vec4 position, inout vec3 normal) {
+            vec4 totalPosition = vec4(0.0);
+            vec3 totalNormal = vec3(0.0);
+            float totalWeight = 0.0;
+            
+            for(int i = 0; i < BONE_INFLUENCES; i++) {
+                mat4 boneTransform = getBoneTransform(getBone(i));
+                totalPosition += boneTransform * position * aWeights[i];
+                totalNormal += mat3(boneTransform) * normal * aWeights[i];
+                totalWeight += aWeights[i];
+            }
+            
+            position = totalPosition + position * (1.0 - totalWeight);
+            normal = totalNormal + normal * (1.0 - totalWeight);
+        }
+        #else
+        // Uncovered weight blends in the identity, as above
+        void skin(inout vec4 position, inout vec3 normal) {
+            // Every bone is blended in the hemisphere of the first one
+            int texel = boneTexelOffset + getBone(0) * 2;
+            vec4 pivot = texelFetch(boneTransforms, texel);
+            vec4 blendReal = pivot * aWeights[0];
+            vec4 blendDual = texelFetch(boneTransforms, texel + 1) * aWeights[0];
+            float totalWeight = aWeights[0];
+            
+            for(int i = 1; i < BONE_INFLUENCES; i++) {
+                texel = boneTexelOffset + getBone(i) * 2;
+                vec4 real = texelFetch(boneTransforms, texel);
+                vec4 dual = texelFetch(boneTransforms, texel + 1);
+                float weight = dot(real, pivot) < 0.0 ? -aWeights[i] : aWeights[i];
+                blendReal += real * weight;
+                blendDual += dual * weight;
+                totalWeight += aWeights[i];
+            }
+            blendReal.w += 1.0 - totalWeight;
+            
+            float len = length(blendReal);
+            vec3 r = blendReal.xyz / len;
+            float w = blendReal.w / len;
+            vec3 d = blendDual.xyz / len;
+            float dw = blendDual.w / len;
+            vec3 translation = 2.0 * (w * d - dw * r + cross(r, d));
+            position = vec4(aPos + 2.0 * cross(r, cross(r, aPos) + w * aPos) + translation, 1.0);
+            normal = aNormal + 2.0 * cross(r, cross(r, aNormal) + w * aNormal);
+        }
+        #endif
+        #endif
+        
+        void main() {
+            vec4 position = vec4(aPos, 1.0);
+            vec3 normal = aNormal;
+        #ifdef SKINNED
+            skin(position, normal);
+        #endif
+            
+        #ifdef INSTANCED
+            FragPos = vec3(instanceModel(aInstanceModel) * position);
+            Normal = instanceNormalMatrix(aInstanceModel) * normal;
+            InstanceColor = aInstanceColor;
+        #else
+            FragPos = vec3(model * position);
+            Normal = mat3(normalMatrix) * normal;
+            InstanceColor = vec4(1.0);
+        #endif
+            TexCoords = aTexCoords;
+            gl_Position = viewProjection * vec4(FragPos, 1.0);
+        }
+    )";
+    
+    const char* fragmentShaderSource = R"(
+        #version 330 core
+        out vec4 FragColor;
+        
+        in vec3 FragPos;
+        in vec3 Normal;
+        in vec2 TexCoords;
+        in vec4 InstanceColor;
+        
+        #ifdef TEXTURED
+        uniform sampler2D texture_diffuse;
+        #endif
+        
+        void main() {
+        #ifdef TEXTURED
+            vec3 baseColor = texture(texture_diffuse, TexCoords).rgb;
+        #else
+            vec3 baseColor = objectColor.rgb;
+        #endif
+            baseColor *= InstanceColor.rgb;
+            
+            vec3 result = 0.3 * baseColor;
+            vec3 norm = normalize(Normal);
+            vec3 viewDir = normalize(cameraPosition.xyz - FragPos);
+            for (int i = 0; i < LIGHT_COUNT; i++) {
+                vec3 lightDir = normalize(lightPositions[i].xyz - FragPos);
+                float diff = max(dot(norm, lightDir), 0.0);
+                vec3 reflectDir = reflect(-lightDir, norm);
+                float spec = pow(max(dot(viewDir, reflectDir), 0.0), 32);
+                result += (diff * baseColor + 0.5 * spec) * lightColors[i].rgb;
+            }
+            FragColor = vec4(result, objectColor.a * InstanceColor.a);
+        }
+    )";
+    
+    // Crowds replay a baked animation: bone matrices come from a texture row
+    // per frame, and each instance brings its own transform and time offset
+    const char* crowdVertexShaderSource = R"(
+        #version 330 core
+        layout (location = 0) in vec3 aPos;
+        layout (location = 1) in vec3 aNormal;
+        layout (location = 2) in vec2 aTexCoords;
+        layout (location = 3) in ivec4 aBoneIDs;
+        layout (location = 4) in vec4 aWeights;
+        layout (location = 5) in mat4 aInstanceModel;
+        layout (location = 9) in float aTimeOffset;
+        
+        out vec3 FragPos;
+        out vec3 Normal;
+        out vec2 TexCoords;
+        out vec4 InstanceColor;
+        
+        #ifdef SKINNED
+        uniform sampler2D bakedBones;  // one row per frame, three texels per bone
+        uniform int boneOffset;        // first bone of this mesh in a row
+        uniform int frameCount;
+        uniform float frameRate;
+        
+        mat4 getBakedBone(int bone, int frame) {
+            int texel = (boneOffset + bone) * 3;
+            vec4 row0 = texelFetch(bakedBones, ivec2(texel, frame), 0);
+            vec4 row1 = texelFetch(bakedBones, ivec2(texel + 1, frame), 0);
+            vec4 row2 = texelFetch(bakedBones, ivec2(texel + 2, frame), 0);
+            return mat4(row0.x, row1.x, row2.x, 0.0,
+                        row0.y, row1.y, row2.y, 0.0,
+                        row0.z, row1.z, row2.z, 0.0,
+                        row0.w, row1.w, row2.w, 1.0);
+        }
+        #endif
+        
+        void main() {
+            vec4 totalPosition = vec4(aPos, 1.0);
+            vec3 totalNormal = aNormal;
+        #ifdef SKINNED
+            float frame = mod((time + aTimeOffset) * frameRate, float(frameCount));
+            int frame0 = int(frame);
+            int frame1 = (frame0 + 1) % frameCount;
+            float blend = fract(frame);
+            
+            // Unused slots read bone 0 with weight 0, and weight the
+            // influences do not cover stays in the rest pose, as in the scene
+            // shader
+            vec4 skinnedPosition = vec4(0.0);
+            vec3 skinnedNormal = vec3(0.0);
+            float restWeight = 1.0;
+            for(int i = 0; i < BONE_INFLUENCES; i++) {
+                int bone = max(aBoneIDs[i], 0);
+                mat4 boneTransform = getBakedBone(bone, frame0) * (1.0 - blend)
+                                   + getBakedBone(bone, frame1) * blend;
+                skinnedPosition += boneTransform * totalPosition * aWeights[i];
+                skinnedNormal += mat3(boneTransform) * totalNormal * aWeights[i];
+                restWeight -= aWeights[i];
+            }
+            totalPosition = skinnedPosition + totalPosition * restWeight;
+            totalNormal = skinnedNormal + totalNormal * restWeight;
+        #endif
+            
+            FragPos = vec3(instanceModel(aInstanceModel) * totalPosition);
+            Normal = instanceNormalMatrix(aInstanceModel) * totalNormal;
+            TexCoords = aTexCoords;
+            InstanceColor = vec4(1.0);
+            gl_Position = viewProjection * vec4(FragPos, 1.0);
+        }
+    )";
+    
+    // Every variant reads camera, lights and object data from the shared blocks
+    UniformBlocks* uniformBlocks = new UniformBlocks(*streamBuffer);
+    ShaderVariants sceneShaders(vertexShaderSource, fragmentShaderSource);
+    ShaderVariants crowdShaders(crowdVertexShaderSource, fragmentShaderSource);
+    
+    // One white light over the arena; it never moves, so it is uploaded once
+    LightBlock lights;
+    lights.positions[0] = glm::vec4(10.0f, 10.0f, 10.0f, 1.0f);
+    lights.colors[0] = glm::vec4(1.0f);
+    lights.count = 1;
+    uniformBlocks->SetLights(lights);
+    // Scene draws use the variants for this many lights
+    unsigned int sceneVariant = ShaderVariants::MakeKey(0, 0, lights.count);
+    
+    // Bone palettes of all characters, uploaded once per frame
+    BonePaletteBuffer* bonePalette = new BonePaletteBuffer(PALETTE_REGION_SIZE);
+    sceneShaders.SetSampler("boneTransforms", BONE_PALETTE_TEXTURE_UNIT);
+    
+    // Create simple cube model
+    Model* cubeModel = createCubeModel();
+    
+    // Create game objects
+    Model* playerModel = loadModelFromFile("Swimming.dae");
+    playerModel->CompressAnimation(ClipCompressionSettings());
+    GameObject player(playerModel, glm::vec3(0.0f, 0.5f, 0.0f), 0.8f);
+    player.scale = glm::vec3(0.01f, 0.01f, 0.01f);
+
+    std::cout << "Player model loaded. Meshes: " << playerModel->meshes.size() << std::endl;
+    std::cout << "Textures loaded: " << playerModel->textures_loaded.size() << std::endl;
+    
+    std::vector<GameObject> obstacles;
+    obstacles.push_back(GameObject(cubeModel, glm::vec3(5.0f, 0.5f, 0.0f), 1.0f));
+    obstacles.push_back(GameObject(cubeModel, glm::vec3(-5.0f, 0.5f, 5.0f), 1.0f));
+    obstacles.push_back(GameObject(cubeModel, glm::vec3(0.0f, 0.5f, -8.0f), 1.0f));
+    
+    // --collectibles scales the scene up; the render queue draws them all
+    // with one instanced call
+    int collectibleCount = getIntArgument(argc, argv, "--collectibles", 5);
+    std::vector<GameObject> collectibles;
+    for (int i = 0; i < collectibleCount; i++) {
+        float x = (rand() % 20 - 10);
+        float z = (rand() % 20 - 10);
+        collectibles.push_back(GameObject(cubeModel, glm::vec3(x, 0.5f, z), 0.5f));
+        collectibles.back().scale = glm::vec3(0.5f);
+    }
+    
+    // Create ground
+    GameObject ground(cubeModel, glm::vec3(0.0f, -1.0f, 0.0f), 0.0f);
+    ground.scale = glm::vec3(30.0f, 0.5f, 30.0f);
+    
+    // Static geometry shares one set of buffers so the queue can multi-draw it
+    MeshPool* meshPool = new MeshPool();
+    meshPool->Add(cubeModel);
+    meshPool->Upload();
+    
+    // Surface colors of the scene, all drawn with the scene shader
+    RenderQueue* renderQueue = new RenderQueue(*uniformBlocks, INSTANCE_REGION_SIZE);
+    renderQueue->SetMeshPool(meshPool);
+    Material material;
+    material.shaders = &sceneShaders;
+    material.variant = sceneVariant;
+    material.color = glm::vec3(0.3f, 0.5f, 0.3f);
+    unsigned int groundMaterial = renderQueue->AddMaterial(material);
+    material.color = glm::vec3(0.2f, 0.5f, 0.9f);
+    unsigned int playerMaterial = renderQueue->AddMaterial(material);
+    material.color = glm::vec3(0.3f, 0.7f, 0.7f);
+    unsigned int swimmerMaterial = renderQueue->AddMaterial(material);
+    material.color = glm::vec3(0.8f, 0.2f, 0.2f);
+    unsigned int obstacleMaterial = renderQueue->AddMaterial(material);
+    material.color = glm::vec3(1.0f, 0.8f, 0.0f);
+    unsigned int collectibleMaterial = renderQueue->AddMaterial(material);
+    
+    // The static objects are frustum culled through a BVH over their spheres
+    std::vector<GameObject*> cullObjects;
+    std::vector<unsigned int> cullMaterials;
+    cullObjects.push_back(&ground);
+    cullMaterials.push_back(groundMaterial);
+    for (auto& obstacle : obstacles) {
+        cullObjects.push_back(&obstacle);
+        cullMaterials.push_back(obstacleMaterial);
+    }
+    for (auto& collectible : collectibles) {
+        cullObjects.push_back(&collectible);
+        cullMaterials.push_back(collectibleMaterial);
+    }
+    std::vector<glm::vec4> cullSpheres;
+    for (GameObject* object : cullObjects) {
+        cullSpheres.push_back(object->getCullingSphere(getModelRadius(object->model)));
+    }
+    FrustumCuller frustumCuller;
+    frustumCuller.Build(cullSpheres);
+    std::vector<unsigned int> visibleObjects;
+    unsigned long long visibleTotal = 0, culledTotal = 0;
+    unsigned int cullFrames = 0;
+    
+    // Whatever survives the frustum is then tested against the obstacles,
+    // rasterized on the CPU while the characters animate
+    std::vector<BoundingVolume> cullBounds;
+    for (GameObject* object : cullObjects) {
+        cullBounds.push_back(getModelBounds(object->model));
+    }
+    BoundingVolume cubeBounds = getModelBounds(cubeModel);
+    OccluderMesh obstacleOccluder = OccluderMesh::MakeBox(cubeBounds.min, cubeBounds.max);
+    std::vector<Occluder> occluders;
+    for (const auto& obstacle : obstacles) {
+        Occluder occluder;
+        occluder.mesh = &obstacleOccluder;
+        occluder.transform = obstacle.getModelMatrix();
+        occluders.push_back(occluder);
+    }
+    // Two threads leave the rest of the cores to the animation system
+    OcclusionCuller* occlusionCuller = new OcclusionCuller(2);
+    std::vector<BoundingVolume> visibleBounds;
+    unsigned long long occludedTotal = 0;
+    
+    // Animated characters are evaluated in parallel by the animation system
+    AnimationSystem animationSystem;
+    PoseCacheSettings poseCacheSettings;
+    poseCacheSettings.enabled = true;
+    animationSystem.SetPoseCacheSettings(poseCacheSettings);
+    int playerInstance = animationSystem.AddInstance(playerModel);
+    
+    // Ambient swimmers play the player's clip in four phase groups, so most
+    // of their poses come out of the pose cache
+    int swimmerCount = getIntArgument(argc, argv, "--swimmers", 0);
+    std::vector<GameObject> swimmers;
+    std::vector<int> swimmerInstances;
+    const aiAnimation* swimAnimation = playerModel->GetAnimation();
+    for (int i = 0; i < swimmerCount && swimAnimation; i++) {
+        float angle = (float)i / swimmerCount * 2.0f * 3.14159265f;
+        swimmers.push_back(GameObject(playerModel, glm::vec3(cos(angle) * 12.0f, 0.5f, sin(angle) * 12.0f), 0.8f));
+        swimmers.back().scale = player.scale;
+        swimmers.back().rotation = -angle;
+        
+        float phase = (float)(i % 4) / 4.0f * (float)swimAnimation->mDuration;
+        int instance = animationSystem.AddInstance(playerModel, phase);
+        animationSystem.GetInstance(instance).position = swimmers.back().position;
+        animationSystem.GetInstance(instance).transform = swimmers.back().getModelMatrix();
+        animationSystem.GetInstance(instance).boundingRadius = swimmers.back().boundingRadius;
+        swimmerInstances.push_back(instance);
+    }
+    // Clips beyond the model's own are streamed in on first use; the swimmers
+    // switch to --swimmer-clip once the background load has finished. Without
+    // the option there is nothing to stream and no loader thread is started.
+    ClipStreamer* clipStreamer = nullptr;
+    int swimmerClip = -1;
+    const char* swimmerClipPath = getStringArgument(argc, argv, "--swimmer-clip", nullptr);
+    if (swimmerClipPath && !swimmers.empty()) {
+        clipStreamer = new ClipStreamer(*playerModel, 4 * 1024 * 1024);
+        swimmerClip = clipStreamer->Register("swimmers", swimmerClipPath);
+        clipStreamer->Prefetch(swimmerClip);
+    }
+    
+    std::vector<std::vector<unsigned int>> paletteTexels(animationSystem.GetInstanceCount());
+    std::vector<std::vector<float>> morphWeights;
+    
+    // Characters are skinned once per frame into vertex buffers that every
+    // pass then draws as static geometry
+    PreSkinner* preSkinner = new PreSkinner();
+    int playerSkinTarget = preSkinner->AddTarget(playerModel);
+    std::vector<int> swimmerSkinTargets;
+    for (size_t i = 0; i < swimmers.size(); i++) {
+        swimmerSkinTargets.push_back(preSkinner->AddTarget(swimmers[i].model));
+    }
+    
+    if (argc > 1 && std::string(argv[1]) == "--skinning-benchmark") {
+        animationSystem.Update(0.0f);
+        runSkinningBenchmark(sceneShaders, playerModel, animationSystem.GetPalette(playerInstance),
+                             animationSystem.GetInstance(playerInstance).paletteSize, bonePalette, *uniformBlocks,
+                             *streamBuffer);
+        runCpuSkinningBenchmark(playerModel, animationSystem.GetPalette(playerInstance),
+                                animationSystem.GetInstance(playerInstance).paletteSize);
+        delete occlusionCuller;
+        delete renderQueue;
+        delete uniformBlocks;
+        delete meshPool;
+        delete preSkinner;
+        delete clipStreamer;
+        delete cubeModel;
+        delete playerModel;
+        delete bonePalette;
+        delete streamBuffer;
+        glfwTerminate();
+        return 0;
+    }
+    
+    // Optional crowd of swimmers around the arena, drawn from a baked clip
+    int crowdSize = getIntArgument(argc, argv, "--crowd", 0);
+    BakedAnimation crowdAnimation;
+    CrowdRenderer* crowd = nullptr;
+    if (crowdSize > 0 && AnimationBaker::Bake(*playerModel, 30.0f, crowdAnimation)) {
+        std::vector<CrowdInstance> crowdInstances;
+        for (int i = 0; i < crowdSize; i++) {
+            float angle = (float)i / crowdSize * 2.0f * 3.14159265f;
+            float radius = 18.0f + (rand() % 100) * 0.1f;
+            CrowdInstance instance;
+            instance.transform = glm::translate(glm::mat4(1.0f), glm::vec3(cos(angle) * radius, 0.5f, sin(angle) * radius));
+            instance.transform = glm::rotate(instance.transform, -angle, glm::vec3(0.0f, 1.0f, 0.0f));
+            instance.transform = glm::scale(instance.transform, player.scale);
+            instance.timeOffset = (rand() % 1000) * 0.001f * crowdAnimation.duration;
+            crowdInstances.push_back(instance);
+        }
+        crowd = new CrowdRenderer(playerModel, crowdAnimation);
+        crowd->SetInstances(crowdInstances);
+    }
+    
+    // Camera
+    Camera camera;
+    
+    int score = 0;
+    float playerSpeed = 5.0f;
+    
+    // Game loop
+    while (!glfwWindowShouldClose(window)) {
+        float currentFrame = glfwGetTime();
+        deltaTime = currentFrame - lastFrame;
+        lastFrame = currentFrame;
+        
+        // Move on to the stream buffer region the GPU finished with
+        streamBuffer->BeginFrame();
+        uniformBlocks->BeginFrame();
+        
+        // Input processing (camera-relative movement)
+        glm::vec3 moveDirection(0.0f);
+
+        // Calculate camera's forward and right vectors
+        glm::vec3 cameraForward = glm::normalize(player.position - camera.position);
+        cameraForward.y = 0.0f;
+        if (glm::length(cameraForward) > 0.0f) {
+            cameraForward = glm::normalize(cameraForward);
+        }
+        glm::vec3 cameraRight = glm::normalize(glm::cross(cameraForward, glm::vec3(0.0f, 1.0f, 0.0f)));
+
+        // ESC to exit
+        if (keys[GLFW_KEY_ESCAPE]) {
+            glfwSetWindowShouldClose(window, true);
+        }
+
+        // WASD movement relative to camera
+        if (keys[GLFW_KEY_W]) moveDirection += cameraForward;
+        if (keys[GLFW_KEY_S]) moveDirection -= cameraForward;
+        if (keys[GLFW_KEY_A]) moveDirection -= cameraRight;
+        if (keys[GLFW_KEY_D]) moveDirection += cameraRight;
+
+        // M toggles the player's skinning mode
+        static bool skinningKeyWasDown = false;
+        if (keys[GLFW_KEY_M] && !skinningKeyWasDown) {
+            playerModel->skinningMode = playerModel->skinningMode == SkinningMode::Linear
+                ? SkinningMode::DualQuaternion : SkinningMode::Linear;
+            std::cout << "Skinning: " << (playerModel->skinningMode == SkinningMode::Linear ? "linear blend" : "dual quaternion") << std::endl;
+        }
+        skinningKeyWasDown = keys[GLFW_KEY_M];
+
+        // Apply movement
+        if (glm::length(moveDirection) > 0.0f) {
+            moveDirection = glm::normalize(moveDirection);
+            glm::vec3 newPos = player.position + moveDirection * playerSpeed * deltaTime;
+
+            // Check collision with obstacles
+            bool collision = false;
+            GameObject tempPlayer = player;
+            tempPlayer.position = newPos;
+
+            for (auto& obstacle : obstacles) {
+                if (tempPlayer.checkCollision(obstacle)) {
+                    collision = true;
+                    break;
+                }
+            }
+
+            if (!collision) {
+                player.position = newPos;
+            }
+
+            // Rotate player to face movement direction
+            player.rotation = atan2(moveDirection.x, moveDirection.z);
+        }
+
+        // Check collectibles
+        for (auto& collectible : collectibles) {
+            if (player.checkCollision(collectible)) {
+                collectible.active = false;
+                score++;
+                std::cout << "Score: " << score << std::endl;
+            }
+            collectible.rotation += deltaTime * 2.0f;
+        }
+
+        // Update camera
+        camera.followTarget(player.position);
+        
+        glm::mat4 projection = glm::perspective(glm::radians(45.0f), 
+            (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
+        glm::mat4 view = camera.getViewMatrix();
+        
+        // Hand the streamed clip to the swimmers as soon as it is resident
+        if (swimmerClip >= 0) {
+            std::shared_ptr<const StreamedClip> clip = clipStreamer->Get(swimmerClip);
+            if (clip) {
+                for (int instance : swimmerInstances) {
+                    animationSystem.GetInstance(instance).clip = clip;
+                }
+                swimmerClip = -1;
+            }
+        }
+        
+        // Update character animations (culled and LOD-reduced against the camera)
+        CharacterInstance& playerAnimation = animationSystem.GetInstance(playerInstance);
+        playerAnimation.position = player.position;
+        playerAnimation.boundingRadius = player.boundingRadius;
+        playerAnimation.transform = player.getModelMatrix();
+        Frustum viewFrustum(projection * view);
+        
+        // Start occlusion culling of the static objects inside the frustum;
+        // it finishes on its own threads while the characters animate
+        frustumCuller.Cull(viewFrustum, visibleObjects);
+        visibleBounds.clear();
+        for (unsigned int index : visibleObjects) {
+            visibleBounds.push_back(cullBounds[index].Transform(cullObjects[index]->getModelMatrix()));
+        }
+        occlusionCuller->Begin(projection * view, occluders, visibleBounds);
+        
+        animationSystem.SetViewer(camera.position, viewFrustum);
+        animationSystem.Update(deltaTime);
+        // Collision uses the bounds of the pose just evaluated
+        player.poseBounds = playerAnimation.bounds;
+        // Upload every character's palette in one call, each in its model's skinning mode
+        // Each mesh only uploads the bones it references
+        bonePalette->Begin();
+        for (unsigned int i = 0; i < animationSystem.GetInstanceCount(); i++) {
+            const CharacterInstance& instance = animationSystem.GetInstance(i);
+            const std::vector<Mesh>& meshes = instance.model->meshes;
+            paletteTexels[i].resize(meshes.size());
+            for (size_t m = 0; m < meshes.size(); m++) {
+                paletteTexels[i][m] = bonePalette->Add(animationSystem.GetPalette(i), meshes[m].bones,
+                                                       instance.model->skinningMode);
+            }
+        }
+        bonePalette->Finish();
+        bonePalette->Bind();
+        
+        // Pre-skin the characters that will be drawn; unchanged poses are skipped.
+        // Blend shapes follow each character's own clip time, and the swimmers
+        // share the player's meshes, so the weights go to each skin target
+        playerModel->SampleMorphWeights(playerAnimation.animationTime, morphWeights);
+        preSkinner->SetMorphWeights(playerSkinTarget, morphWeights);
+        preSkinner->Skin(playerSkinTarget, animationSystem.GetPalette(playerInstance), paletteTexels[playerInstance].data());
+        for (size_t i = 0; i < swimmers.size(); i++) {
+            const CharacterInstance& swimmer = animationSystem.GetInstance(swimmerInstances[i]);
+            if (!swimmer.visible) continue;
+            // Streamed clips carry no morph channels
+            if (swimmer.clip) {
+                morphWeights.clear();
+            } else {
+                swimmer.model->SampleMorphWeights(swimmer.animationTime, morphWeights);
+            }
+            preSkinner->SetMorphWeights(swimmerSkinTargets[i], morphWeights);
+            preSkinner->Skin(swimmerSkinTargets[i], animationSystem.GetPalette(swimmerInstances[i]),
+                             paletteTexels[swimmerInstances[i]].data());
+        }
+        
+        // Rendering
+        glClearColor(0.1f, 0.1f, 0.15f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        
+        FrameBlock frame;
+        frame.time = currentFrame;
+        frame.deltaTime = deltaTime;
+        uniformBlocks->SetFrame(frame);
+        CameraBlock cameraBlock;
+        cameraBlock.projection = projection;
+        cameraBlock.view = view;
+        cameraBlock.viewProjection = projection * view;
+        cameraBlock.position = glm::vec4(camera.position, 1.0f);
+        uniformBlocks->SetCamera(cameraBlock);
+        
+        // Submit everything drawn with the scene shader; the queue orders the
+        // draws by state and depth
+        renderQueue->Begin(view);
+        
+        // Static objects that survived frustum and occlusion culling
+        const std::vector<unsigned char>& unoccluded = occlusionCuller->Finish();
+        visibleTotal += frustumCuller.GetStats().visible;
+        culledTotal += frustumCuller.GetStats().culled;
+        occludedTotal += occlusionCuller->GetStats().occluded;
+        cullFrames++;
+        for (size_t i = 0; i < visibleObjects.size(); i++) {
+            GameObject* object = cullObjects[visibleObjects[i]];
+            if (!object->active || !unoccluded[i]) continue;
+            renderQueue->Submit(object->model, cullMaterials[visibleObjects[i]], object->getModelMatrix());
+        }
+        
+        // Characters are drawn from their pre-skinned vertices
+        DrawItem character;
+        character.material = playerMaterial;
+        character.transform = player.getModelMatrix();
+        for (size_t m = 0; m < playerModel->meshes.size(); m++) {
+            character.mesh = &playerModel->meshes[m];
+            character.vertexArray = preSkinner->GetVertexArray(playerSkinTarget, m);
+            renderQueue->Submit(character);
+        }
+        
+        // Only the ambient swimmers that survived culling
+        character.material = swimmerMaterial;
+        for (size_t i = 0; i < swimmers.size(); i++) {
+            if (!animationSystem.GetInstance(swimmerInstances[i]).visible) continue;
+            character.transform = swimmers[i].getModelMatrix();
+            for (size_t m = 0; m < swimmers[i].model->meshes.size(); m++) {
+                character.mesh = &swimmers[i].model->meshes[m];
+                character.vertexArray = preSkinner->GetVertexArray(swimmerSkinTargets[i], m);
+                renderQueue->Submit(character);
+            }
+        }
+        renderQueue->Flush();
+        
+        // Draw the crowd: one instanced call per mesh
+        if (crowd) {
+            ObjectBlock crowdObject;
+            crowdObject.color = glm::vec4(0.4f, 0.6f, 0.8f, 1.0f);
+            uniformBlocks->SetObject(crowdObject);
+            crowd->Draw(crowdShaders, sceneVariant);
+        }
+        
+        GLStateCache::Get().EndFrame();
+        glfwSwapBuffers(window);
+        glfwPollEvents();
+    }
+    
+    PoseCacheStats poseCacheStats = animationSystem.GetPoseCacheStats();
+    std::cout << "Pose cache: " << poseCacheStats.hits << " hits, " << poseCacheStats.misses << " misses, "
+              << poseCacheStats.evictions << " evictions (" << poseCacheStats.GetHitRate() * 100.0f << "% hit rate)" << std::endl;
+    
+    if (clipStreamer) {
+        ClipStreamerStats streamerStats = clipStreamer->GetStats();
+        std::cout << "Clip streaming: " << streamerStats.loads << " loads, " << streamerStats.evictions << " evictions, "
+                  << streamerStats.stalls << " stalls (" << streamerStats.stallMilliseconds << " ms), "
+                  << streamerStats.residentBytes / 1024 << " KB resident" << std::endl;
+    }
+    
+    const PreSkinnerStats& preSkinnerStats = preSkinner->GetStats();
+    std::cout << "Pre-skinning: " << preSkinnerStats.targetsSkinned << " passes, " << preSkinnerStats.targetsSkipped
+              << " skipped with unchanged pose, " << preSkinnerStats.verticesSkinned << " vertices" << std::endl;
+    
+    if (cullFrames > 0) {
+        std::cout << "Frustum culling: " << visibleTotal / cullFrames << " visible, " << culledTotal / cullFrames
+                  << " culled per frame of " << frustumCuller.GetObjectCount() << " static objects" << std::endl;
+        std::cout << "Occlusion culling: " << occludedTotal / cullFrames << " of the visible hidden per frame by "
+                  << occluders.size() << " occluders" << std::endl;
+    }
+    
+    printStreamStats("Streaming", *streamBuffer);
+    printStreamStats("Instance streaming", renderQueue->GetInstanceStream());
+    printStreamStats("Palette streaming", bonePalette->GetStream());
+    
+    std::cout << "Shader variants compiled: " << sceneShaders.GetVariantCount() << " scene, "
+              << crowdShaders.GetVariantCount() << " crowd" << std::endl;
+    if (ProgramCache::Get().IsEnabled()) {
+        const ProgramCacheStats& cacheStats = ProgramCache::Get().GetStats();
+        std::cout << "Program cache: " << cacheStats.loaded << " loaded, " << cacheStats.missed << " built from source ("
+                  << cacheStats.rejected << " rejected binaries), " << cacheStats.stored << " stored" << std::endl;
+    }
+    
+    const GLStateCache& glState = GLStateCache::Get();
+    if (glState.GetFrameCount() > 0) {
+        const GLStateStats& stateStats = glState.GetTotalStats();
+        unsigned int frameCount = glState.GetFrameCount();
+        std::cout << "GL state changes per frame: " << stateStats.GetIssued() / frameCount << " issued, "
+                  << stateStats.GetElided() / frameCount << " elided (programs " << stateStats.programs.elided / frameCount
+                  << ", VAOs " << stateStats.vertexArrays.elided / frameCount << ", textures " << stateStats.textures.elided / frameCount
+                  << ", uniforms " << stateStats.uniforms.elided / frameCount << ")" << std::endl;
+    }
+    
+    // Cleanup
+    delete occlusionCuller;
+    delete renderQueue;
+    delete uniformBlocks;
+    delete meshPool;
+    delete preSkinner;
+    delete clipStreamer;
+    delete crowd;
+    AnimationBaker::Release(crowdAnimation);
+    delete cubeModel;
+    delete playerModel;
+    delete bonePalette;
+    delete streamBuffer;
+    
+    glfwTerminate();
+    return 0;
+}
@@ -1,67 +1,124 @@
-#include "mesh.h"
-
-Vertex::Vertex() {
-    for(int i = 0; i < MAX_BONE_INFLUENCE; i++) {
-        BoneIDs[i] = -1;
-        Weights[i] = 0.0f;
-    }
-}
-
-Mesh::Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<Texture> textures) {
-    this->vertices = vertices;
-    this->indices = indices;
-    this->textures = textures;
-    setupMesh();
-}
-
-void Mesh::Draw(Shader &shader) {
-    // Bind textures if available
-    if (textures.size() > 0) {
-        shader.setBool("useTexture", true);
-        for (unsigned int i = 0; i < textures.size(); i++) {
-            glActiveTexture(GL_TEXTURE0 + i);
-            std::string name = textures[i].type;
-            shader.setInt(name.c_str(), i);
-            glBindTexture(GL_TEXTURE_2D, textures[i].id);
-        }
-    } else {
-        shader.setBool("useTexture", false);
-    }
-    
-    glBindVertexArray(VAO);
-    glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-    glBindVertexArray(0);
-    glActiveTexture(GL_TEXTURE0);
-}
-
-void Mesh::setupMesh() {
-    glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
-    glGenBuffers(1, &EBO);
-    
-    glBindVertexArray(VAO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
-    
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
-    
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
-    
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
-    
-    glEnableVertexAttribArray(2);
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
-    
-    // Bone IDs
-    glEnableVertexAttribArray(3);
-    glVertexAttribIPointer(3, 4, GL_INT, sizeof(Vertex), (void*)offsetof(Vertex, BoneIDs));
-    
-    // Bone Weights
-    glEnableVertexAttribArray(4);
-    glVertexAttribPointer(4, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Weights));
-    
-    glBindVertexArray(0);
-}
+#include "mesh.h"
+#include "gl_state.h"
+
+#include <algorithm>
+#include <cmath>
+
+Vertex::Vertex() {
+    for(int i = 0; i < MAX_BONE_INFLUENCE; i++) {
+        BoneIDs[i] = -1;
+        Weights[i] = 0.0f;
+    }
+}
+
+Mesh::Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<Texture> textures, bool uploadToGPU) {
+    this->vertices = vertices;
+    this->indices = indices;
+    this->textures = textures;
+    for (const auto& vertex : this->vertices) {
+        for (unsigned int i = boneInfluences; i < MAX_BONE_INFLUENCE; i++) {
+            if (vertex.BoneIDs[i] >= 0) boneInfluences = i + 1;
+        }
+    }
+    if (uploadToGPU) setupMesh();
+}
+
+void Mesh::Draw(Shader &shader) {
+    Draw(shader, VAO);
+}
+
+// The VAO and textures stay bound afterwards; the state cache skips them
+// when the next draw uses the same ones
+void Mesh::Draw(Shader &shader, unsigned int vertexArray) {
+    bindTextures(shader);
+    
+    GLStateCache::Get().BindVertexArray(vertexArray);
+    glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
+}
+
+void Mesh::DrawInstanced(Shader &shader, unsigned int instanceCount) {
+    DrawInstanced(shader, instanceCount, VAO);
+}
+
+void Mesh::DrawInstanced(Shader &shader, unsigned int instanceCount, unsigned int vertexArray) {
+    bindTextures(shader);
+    
+    GLStateCache::Get().BindVertexArray(vertexArray);
+    glDrawElementsInstanced(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0, instanceCount);
+}
+
+void Mesh::GatherBonePalette(const glm::mat4* modelPalette, std::vector<glm::mat4>& meshPalette) const {
+    meshPalette.resize(bones.size());
+    for (size_t i = 0; i < bones.size(); i++) {
+        meshPalette[i] = modelPalette[bones[i]];
+    }
+}
+
+void Mesh::SetMorphTargets(const std::vector<MorphTarget>& targets) {
+    morphTargets = targets;
+    morphBegin = (unsigned int)vertices.size();
+    morphEnd = 0;
+    for (const auto& target : targets) {
+        if (target.vertices.empty()) continue;
+        morphBegin = std::min(morphBegin, target.vertices.front());
+        morphEnd = std::max(morphEnd, target.vertices.back() + 1);
+    }
+    if (morphEnd <= morphBegin) morphBegin = morphEnd = 0;
+}
+
+unsigned int Mesh::GetMorphBegin() const {
+    return morphBegin;
+}
+
+unsigned int Mesh::GetMorphEnd() const {
+    return morphEnd;
+}
+
+// Inactive targets are skipped, so meshes whose weights are all zero cost
+// only the loop over them
+void Mesh::AccumulateMorphTargets(const float* weights, glm::vec4* positionOffsets, glm::vec4* normalOffsets) const {
+    for (size_t i = 0; i < morphTargets.size(); i++) {
+        if (std::abs(weights[i]) < MorphTargets::WEIGHT_EPSILON) continue;
+        MorphTargets::Accumulate(morphTargets[i], weights[i], morphBegin, positionOffsets, normalOffsets);
+    }
+}
+
+// Whether they are sampled is up to the shader; see ShaderVariants::ForMesh
+void Mesh::bindTextures(Shader &shader) {
+    for (unsigned int i = 0; i < textures.size(); i++) {
+        shader.setInt(textures[i].type, i);
+        GLStateCache::Get().BindTexture(i, GL_TEXTURE_2D, textures[i].id);
+    }
+}
+
+void Mesh::setupMesh() {
+    glGenVertexArrays(1, &VAO);
+    glGenBuffers(1, &VBO);
+    glGenBuffers(1, &EBO);
+    
+    GLStateCache::Get().BindVertexArray(VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
+    
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+    
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
+    
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
+    
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
+    
+    // Bone IDs
+    glEnableVertexAttribArray(3);
+    glVertexAttribIPointer(3, 4, GL_INT, sizeof(Vertex), (void*)offsetof(Vertex, BoneIDs));
+    
+    // Bone Weights
+    glEnableVertexAttribArray(4);
+    glVertexAttribPointer(4, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Weights));
+    
+    GLStateCache::Get().BindVertexArray(0);
+}
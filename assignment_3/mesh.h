@@ -1,44 +1,77 @@
-#ifndef MESH_H
-#define MESH_H
-
-#include <glad/glad.h>
-#include <glm/glm.hpp>
-#include <glm/gtc/matrix_transform.hpp>
-#include <string>
-#include <vector>
-#include "shader.h"
-
-#define MAX_BONE_INFLUENCE 4
-
-struct Vertex {
-    glm::vec3 Position;
-    glm::vec3 Normal;
-    glm::vec2 TexCoords;
-    int BoneIDs[MAX_BONE_INFLUENCE];
-    float Weights[MAX_BONE_INFLUENCE];
-    
-    Vertex();
-};
-
-struct Texture {
-    unsigned int id;
-    std::string type;
-    std::string path;
-};
-
-class Mesh {
-public:
-    std::vector<Vertex> vertices;
-    std::vector<unsigned int> indices;
-    std::vector<Texture> textures;
-    unsigned int VAO;
-    
-    Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<Texture> textures);
-    void Draw(Shader &shader);
-    
-private:
-    unsigned int VBO, EBO;
-    void setupMesh();
-};
-
-#endif
+#ifndef MESH_H
+#define MESH_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <string>
+#include <vector>
+#include "shader.h"
+#include "morph_targets.h"
+
+#define MAX_BONE_INFLUENCE 4
+
+// How a skinned mesh blends its bone influences. Linear blend skinning uses
+// 3x4 matrices; dual quaternion skinning uses 8 floats per bone and keeps
+// volume around twisting joints (bones must be rigid, no scale).
+enum class SkinningMode {
+    Linear,
+    DualQuaternion
+};
+
+struct Vertex {
+    glm::vec3 Position;
+    glm::vec3 Normal;
+    glm::vec2 TexCoords;
+    int BoneIDs[MAX_BONE_INFLUENCE];
+    float Weights[MAX_BONE_INFLUENCE];
+    
+    Vertex();
+};
+
+struct Texture {
+    unsigned int id;
+    std::string type;
+    std::string path;
+};
+
+class Mesh {
+public:
+    std::vector<Vertex> vertices;
+    std::vector<unsigned int> indices;
+    std::vector<Texture> textures;
+    // Model bone index for each slot of this mesh's palette; Vertex::BoneIDs
+    // index into it, so only the bones the mesh uses need uploading
+    std::vector<unsigned int> bones;
+    // Bone slots in use, the highest of any vertex; slots fill from the
+    // first, so later ones of a vertex may be unused (-1) but never earlier
+    unsigned int boneInfluences = 0;
+    std::string name;
+    // Blend shapes; the vertex buffer always holds the base shape, since
+    // every character using the mesh has weights of its own (see PreSkinner)
+    std::vector<MorphTarget> morphTargets;
+    unsigned int VAO = 0, VBO = 0, EBO = 0;
+    
+    // uploadToGPU = false keeps the data on the CPU only, for tools that run without a GL context
+    Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<Texture> textures, bool uploadToGPU = true);
+    void Draw(Shader &shader);
+    // Draws through another VAO holding this mesh's vertices, such as a pre-skinned copy
+    void Draw(Shader &shader, unsigned int vertexArray);
+    void DrawInstanced(Shader &shader, unsigned int instanceCount);
+    void DrawInstanced(Shader &shader, unsigned int instanceCount, unsigned int vertexArray);
+    void GatherBonePalette(const glm::mat4* modelPalette, std::vector<glm::mat4>& meshPalette) const;
+    void SetMorphTargets(const std::vector<MorphTarget>& targets);
+    // Vertex range touched by any target; empty without targets
+    unsigned int GetMorphBegin() const;
+    unsigned int GetMorphEnd() const;
+    // Adds the targets, one weight each, to offsets for the vertices from
+    // GetMorphBegin() to GetMorphEnd()
+    void AccumulateMorphTargets(const float* weights, glm::vec4* positionOffsets, glm::vec4* normalOffsets) const;
+    
+private:
+    unsigned int morphBegin = 0, morphEnd = 0;   // vertex range touched by any target
+    void setupMesh();
+    void bindTextures(Shader &shader);
+};
+
+#endif
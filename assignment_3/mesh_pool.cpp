@@ -0,0 +1,101 @@
+#include "mesh_pool.h"
+#include "gl_state.h"
+
+#include <cstddef>
+
+#ifndef GL_DRAW_INDIRECT_BUFFER
+#define GL_DRAW_INDIRECT_BUFFER 0x8F3F
+#endif
+
+typedef void (APIENTRYP PFNGLMULTIDRAWELEMENTSINDIRECTPROC)(GLenum mode, GLenum type, const void* indirect,
+                                                             GLsizei drawcount, GLsizei stride);
+static PFNGLMULTIDRAWELEMENTSINDIRECTPROC multiDrawElementsIndirect = nullptr;
+
+MeshPool::MeshPool() {
+    glGenVertexArrays(1, &VAO);
+    glGenBuffers(1, &VBO);
+    glGenBuffers(1, &EBO);
+    glGenBuffers(1, &indirectBuffer);
+}
+
+MeshPool::~MeshPool() {
+    glDeleteVertexArrays(1, &VAO);
+    glDeleteBuffers(1, &VBO);
+    glDeleteBuffers(1, &EBO);
+    glDeleteBuffers(1, &indirectBuffer);
+    GLStateCache::Get().Invalidate();
+}
+
+bool MeshPool::LoadMultiDraw(GLADloadproc load) {
+    multiDrawElementsIndirect = nullptr;
+    if (GLVersion.major > 4 || (GLVersion.major == 4 && GLVersion.minor >= 3)) {
+        multiDrawElementsIndirect = (PFNGLMULTIDRAWELEMENTSINDIRECTPROC)load("glMultiDrawElementsIndirect");
+    }
+    return multiDrawElementsIndirect != nullptr;
+}
+
+bool MeshPool::IsMultiDrawAvailable() {
+    return multiDrawElementsIndirect != nullptr;
+}
+
+void MeshPool::Add(const Mesh* mesh) {
+    if (meshes.count(mesh) || !mesh->morphTargets.empty()) return;
+
+    PooledMesh pooled;
+    pooled.firstIndex = (unsigned int)indices.size();
+    pooled.indexCount = (unsigned int)mesh->indices.size();
+    pooled.baseVertex = (int)vertices.size();
+    vertices.insert(vertices.end(), mesh->vertices.begin(), mesh->vertices.end());
+    indices.insert(indices.end(), mesh->indices.begin(), mesh->indices.end());
+    meshes[mesh] = pooled;
+}
+
+void MeshPool::Add(const Model* model) {
+    for (const auto& mesh : model->meshes) {
+        Add(&mesh);
+    }
+}
+
+void MeshPool::Upload() {
+    if (vertices.empty()) return;
+
+    GLStateCache::Get().BindVertexArray(VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+
+    // Same layout as Mesh::setupMesh
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
+    glEnableVertexAttribArray(3);
+    glVertexAttribIPointer(3, 4, GL_INT, sizeof(Vertex), (void*)offsetof(Vertex, BoneIDs));
+    glEnableVertexAttribArray(4);
+    glVertexAttribPointer(4, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Weights));
+
+    GLStateCache::Get().BindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+const PooledMesh* MeshPool::Find(const Mesh* mesh) const {
+    auto it = meshes.find(mesh);
+    return it == meshes.end() ? nullptr : &it->second;
+}
+
+unsigned int MeshPool::GetVertexArray() const {
+    return VAO;
+}
+
+void MeshPool::MultiDraw(const std::vector<DrawElementsIndirectCommand>& commands) {
+    if (commands.empty() || !multiDrawElementsIndirect) return;
+
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+    glBufferData(GL_DRAW_INDIRECT_BUFFER, commands.size() * sizeof(DrawElementsIndirectCommand),
+                 commands.data(), GL_STREAM_DRAW);
+    multiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, 0, (GLsizei)commands.size(), 0);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
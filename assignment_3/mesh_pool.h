@@ -0,0 +1,64 @@
+#ifndef MESH_POOL_H
+#define MESH_POOL_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "model.h"
+
+#include <unordered_map>
+#include <vector>
+
+// Command layout read by glMultiDrawElementsIndirect
+struct DrawElementsIndirectCommand {
+    unsigned int count;
+    unsigned int instanceCount;
+    unsigned int firstIndex;
+    int baseVertex;
+    unsigned int baseInstance;
+};
+
+struct PooledMesh {
+    unsigned int firstIndex;
+    unsigned int indexCount;
+    int baseVertex;
+};
+
+// Copies of many meshes' vertices and indices in one vertex and index
+// buffer behind one VAO, so draws of different meshes can be issued as a
+// single multi-draw. Meshes are added at load time and Upload() builds the
+// buffers; the meshes keep their own buffers for every other path. Meshes
+// with morph targets are left out, since their vertices change at runtime.
+//
+// MultiDraw() needs glMultiDrawElementsIndirect from GL 4.3, which glad's
+// 3.3 loader does not cover; LoadMultiDraw() fetches it when the context is
+// new enough. Without it, callers draw each command with
+// glDrawElementsInstancedBaseVertex instead.
+class MeshPool {
+public:
+    MeshPool();
+    ~MeshPool();
+
+    static bool LoadMultiDraw(GLADloadproc load);
+    static bool IsMultiDrawAvailable();
+
+    void Add(const Mesh* mesh);
+    void Add(const Model* model);
+    void Upload();
+
+    // Range of the mesh in the pool, or nullptr if it is not pooled
+    const PooledMesh* Find(const Mesh* mesh) const;
+    unsigned int GetVertexArray() const;
+    // Writes the commands to the indirect buffer and draws them in one call;
+    // the pool's VAO must be bound
+    void MultiDraw(const std::vector<DrawElementsIndirectCommand>& commands);
+
+private:
+    std::vector<Vertex> vertices;
+    std::vector<unsigned int> indices;
+    std::unordered_map<const Mesh*, PooledMesh> meshes;
+    unsigned int VAO = 0, VBO = 0, EBO = 0;
+    unsigned int indirectBuffer = 0;
+};
+
+#endif
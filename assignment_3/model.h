@@ -1,61 +1,115 @@
-#ifndef MODEL_H
-#define MODEL_H
-
-#include <glad/glad.h>
-#include <glm/glm.hpp>
-#include <glm/gtc/matrix_transform.hpp>
-#include <glm/gtc/quaternion.hpp>
-#include <stb_image.h>
-#include <assimp/Importer.hpp>
-#include <assimp/scene.h>
-#include <assimp/postprocess.h>
-
-#include "mesh.h"
-#include "shader.h"
-
-#include <string>
-#include <fstream>
-#include <sstream>
-#include <iostream>
-#include <map>
-#include <vector>
-
-struct BoneInfo {
-    int id;
-    glm::mat4 offset;
-};
-
-class Model {
-public:
-    std::vector<Mesh> meshes;
-    std::string directory;
-    std::vector<Texture> textures_loaded;
-    std::map<std::string, BoneInfo> boneInfoMap;
-    int boneCounter = 0;
-    Assimp::Importer importer;
-    const aiScene* scene = nullptr;
-    glm::mat4 globalInverseTransform;
-    std::vector<glm::mat4> boneTransforms;
-    float animationTime = 0.0f;
-    
-    Model(const char *path);
-    void Draw(Shader &shader);
-    void UpdateAnimation(float deltaTime);
-    std::vector<glm::mat4>& GetBoneTransforms();
-    
-private:
-    void loadModel(std::string path);
-    void processNode(aiNode *node, const aiScene *scene);
-    Mesh processMesh(aiMesh *mesh, const aiScene *scene);
-    std::vector<Texture> loadMaterialTextures(aiMaterial *mat, aiTextureType type, std::string typeName);
-    unsigned int TextureFromFile(const char *path, const std::string &directory);
-    void ExtractBoneWeightForVertices(std::vector<Vertex>& vertices, aiMesh* mesh, const aiScene* scene);
-    glm::mat4 ConvertMatrixToGLM(const aiMatrix4x4& from);
-    void ReadNodeHierarchy(float animationTime, const aiNode* node, const glm::mat4& parentTransform);
-    const aiNodeAnim* FindNodeAnim(const aiAnimation* animation, const std::string& nodeName);
-    glm::vec3 InterpolatePosition(float animationTime, const aiNodeAnim* nodeAnim);
-    glm::quat InterpolateRotation(float animationTime, const aiNodeAnim* nodeAnim);
-    glm::vec3 InterpolateScale(float animationTime, const aiNodeAnim* nodeAnim);
-};
-
-#endif
+#ifndef MODEL_H
+#define MODEL_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <stb_image.h>
+#include <assimp/Importer.hpp>
+#include <assimp/scene.h>
+#include <assimp/postprocess.h>
+
+#include "mesh.h"
+#include "shader.h"
+#include "shader_variants.h"
+#include "clip_compressor.h"
+#include "skinned_bounds.h"
+
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <vector>
+
+struct BoneInfo {
+    int id;
+    glm::mat4 offset;
+};
+
+// Node hierarchy flattened at load time so poses can be evaluated without
+// recursion or per-frame name lookups. Parents always precede their children.
+struct SkeletonNode {
+    std::string name;
+    int parent;                 // index into Model::skeleton, -1 for the root
+    glm::mat4 transformation;   // bind-pose local transform
+    int boneIndex;              // index into boneTransforms, -1 if not a bone
+    glm::mat4 offset;           // bone offset matrix when boneIndex >= 0
+    const aiNodeAnim* channel;  // raw channel of the active animation, or nullptr
+    int track;                  // track in Model::compressedClip, or -1
+    bool detail;                // skipped by reduced-skeleton LODs (fingers, end sites)
+};
+
+class Model {
+public:
+    std::vector<Mesh> meshes;
+    std::string directory;
+    std::vector<Texture> textures_loaded;
+    std::map<std::string, BoneInfo> boneInfoMap;
+    int boneCounter = 0;
+    Assimp::Importer importer;
+    const aiScene* scene = nullptr;
+    glm::mat4 globalInverseTransform;
+    std::vector<glm::mat4> boneTransforms;
+    float animationTime = 0.0f;
+    std::vector<SkeletonNode> skeleton;
+    std::unique_ptr<CompressedClip> compressedClip;
+    SkinningMode skinningMode = SkinningMode::Linear;
+    SkinnedBounds skinnedBounds;
+    
+    bool uploadToGPU = true;
+    
+    // uploadToGPU = false loads meshes and animation without touching GL, for
+    // headless tools such as the animation benchmark
+    Model(const char *path, bool uploadToGPU = true);
+    // Builds the model from a scene owned by the caller, e.g. a generated rig
+    Model(const aiScene *scene, bool uploadToGPU = true);
+    void Draw(Shader &shader);
+    void DrawInstanced(Shader &shader, unsigned int instanceCount);
+    void DrawSkinned(ShaderVariants &shaders, unsigned int key, const unsigned int* meshPaletteTexels);
+    void UpdateAnimation(float deltaTime);
+    std::vector<glm::mat4>& GetBoneTransforms();
+    const aiAnimation* GetAnimation() const;
+    float AdvanceAnimationTime(float animationTime, float deltaTime) const;
+    unsigned int EvaluatePose(float animationTime, glm::mat4* nodeGlobals, glm::mat4* palette, bool reducedSkeleton = false) const;
+    unsigned int EvaluatePose(const CompressedClip& clip, const std::vector<int>& nodeTracks, float animationTime,
+                              glm::mat4* nodeGlobals, glm::mat4* palette, bool reducedSkeleton = false) const;
+    void SetDetailBones(const std::vector<std::string>& namePatterns);
+    bool CompressAnimation(const ClipCompressionSettings& settings);
+    // Morph weights of every mesh at animationTime of the model's own clip,
+    // one vector per mesh; meshes without a morph channel get zeros
+    void SampleMorphWeights(float animationTime, std::vector<std::vector<float>>& meshWeights) const;
+    
+    glm::vec3 InterpolatePosition(float animationTime, const aiNodeAnim* nodeAnim) const;
+    glm::quat InterpolateRotation(float animationTime, const aiNodeAnim* nodeAnim) const;
+    glm::vec3 InterpolateScale(float animationTime, const aiNodeAnim* nodeAnim) const;
+    
+private:
+    void loadModel(std::string path);
+    void processScene(const aiScene *scene);
+    void processNode(aiNode *node, const aiScene *scene);
+    Mesh processMesh(aiMesh *mesh, const aiScene *scene);
+    std::vector<Texture> loadMaterialTextures(aiMaterial *mat, aiTextureType type, std::string typeName);
+    unsigned int TextureFromFile(const char *path, const std::string &directory);
+    void ExtractBoneWeightForVertices(std::vector<Vertex>& vertices, aiMesh* mesh, const aiScene* scene);
+    std::vector<unsigned int> RemapBonesToMesh(std::vector<Vertex>& vertices);
+    glm::mat4 ConvertMatrixToGLM(const aiMatrix4x4& from);
+    void BuildSkeleton(const aiNode* node, int parent);
+    const aiNodeAnim* FindNodeAnim(const aiAnimation* animation, const std::string& nodeName);
+    unsigned int EvaluatePose(const CompressedClip* clip, const int* nodeTracks, float animationTime,
+                              glm::mat4* nodeGlobals, glm::mat4* palette, bool reducedSkeleton) const;
+    std::vector<glm::mat4> globalTransforms;
+    
+    // Morph channel of the active animation and the mesh it drives
+    struct MorphChannel {
+        const aiMeshMorphAnim* channel;
+        unsigned int mesh;
+    };
+    std::vector<MorphChannel> morphChannels;
+    std::vector<std::string> meshNodeNames;   // name of the node each mesh hangs from
+    void BindMorphChannels();
+};
+
+#endif
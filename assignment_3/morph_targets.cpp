@@ -0,0 +1,147 @@
+#include "morph_targets.h"
+
+#include <algorithm>
+#include <cmath>
+
+// SSE2 is part of x86-64, so whenever the compiler targets it the kernel is
+// called without a runtime check
+#if defined(__SSE2__)
+#define MORPH_TARGETS_X86
+#include <emmintrin.h>
+#endif
+
+constexpr float MorphTargets::WEIGHT_EPSILON;
+
+namespace {
+
+// Offsets smaller than this (in model units) do not make a vertex part of a target
+const float DELTA_EPSILON = 1e-5f;
+
+#ifndef MORPH_TARGETS_X86
+
+void AccumulateScalar(const MorphTarget& target, float weight, unsigned int firstVertex,
+                      glm::vec4* positions, glm::vec4* normals) {
+    float positionWeight = weight * target.positionScale;
+    float normalWeight = weight * target.normalScale;
+    const int16_t* delta = target.deltas.data();
+    for (size_t i = 0; i < target.vertices.size(); i++, delta += 8) {
+        unsigned int v = target.vertices[i] - firstVertex;
+        positions[v] += glm::vec4(delta[0], delta[1], delta[2], 0.0f) * positionWeight;
+        normals[v] += glm::vec4(delta[4], delta[5], delta[6], 0.0f) * normalWeight;
+    }
+}
+
+#endif
+
+#ifdef MORPH_TARGETS_X86
+
+// Each vertex is one 128-bit load: the low four values are the position
+// offset and the high four the normal offset, sign-extended to 32 bits by
+// unpacking against themselves and shifting right.
+void AccumulateSSE(const MorphTarget& target, float weight, unsigned int firstVertex,
+                   glm::vec4* positions, glm::vec4* normals) {
+    __m128 positionWeight = _mm_set1_ps(weight * target.positionScale);
+    __m128 normalWeight = _mm_set1_ps(weight * target.normalScale);
+    const int16_t* delta = target.deltas.data();
+    for (size_t i = 0; i < target.vertices.size(); i++, delta += 8) {
+        unsigned int v = target.vertices[i] - firstVertex;
+        __m128i packed = _mm_loadu_si128((const __m128i*)delta);
+        __m128 position = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(packed, packed), 16));
+        __m128 normal = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(packed, packed), 16));
+        float* p = &positions[v][0];
+        float* n = &normals[v][0];
+        _mm_storeu_ps(p, _mm_add_ps(_mm_loadu_ps(p), _mm_mul_ps(position, positionWeight)));
+        _mm_storeu_ps(n, _mm_add_ps(_mm_loadu_ps(n), _mm_mul_ps(normal, normalWeight)));
+    }
+}
+
+#endif
+
+int16_t Quantize(float value, float scale) {
+    if (scale <= 0.0f) return 0;
+    return (int16_t)std::max(-32767.0f, std::min(32767.0f, std::round(value / scale)));
+}
+
+}
+
+MorphTarget MorphTargets::Build(const aiMesh* mesh, const aiAnimMesh* animMesh) {
+    MorphTarget target;
+    target.name = animMesh->mName.C_Str();
+
+    std::vector<glm::vec3> positionDeltas, normalDeltas;
+    float maxPosition = 0.0f, maxNormal = 0.0f;
+    unsigned int count = std::min(mesh->mNumVertices, animMesh->mNumVertices);
+    for (unsigned int v = 0; v < count; v++) {
+        glm::vec3 position(0.0f), normal(0.0f);
+        if (animMesh->mVertices) {
+            const aiVector3D& from = mesh->mVertices[v];
+            const aiVector3D& to = animMesh->mVertices[v];
+            position = glm::vec3(to.x - from.x, to.y - from.y, to.z - from.z);
+        }
+        if (animMesh->mNormals && mesh->mNormals) {
+            const aiVector3D& from = mesh->mNormals[v];
+            const aiVector3D& to = animMesh->mNormals[v];
+            normal = glm::vec3(to.x - from.x, to.y - from.y, to.z - from.z);
+        }
+
+        float positionSize = std::max(std::abs(position.x), std::max(std::abs(position.y), std::abs(position.z)));
+        float normalSize = std::max(std::abs(normal.x), std::max(std::abs(normal.y), std::abs(normal.z)));
+        if (positionSize < DELTA_EPSILON && normalSize < DELTA_EPSILON) continue;
+
+        target.vertices.push_back(v);
+        positionDeltas.push_back(position);
+        normalDeltas.push_back(normal);
+        maxPosition = std::max(maxPosition, positionSize);
+        maxNormal = std::max(maxNormal, normalSize);
+    }
+
+    target.positionScale = maxPosition / 32767.0f;
+    target.normalScale = maxNormal / 32767.0f;
+    target.deltas.resize(target.vertices.size() * 8, 0);
+    for (size_t i = 0; i < target.vertices.size(); i++) {
+        int16_t* delta = &target.deltas[i * 8];
+        for (int c = 0; c < 3; c++) {
+            delta[c] = Quantize(positionDeltas[i][c], target.positionScale);
+            delta[4 + c] = Quantize(normalDeltas[i][c], target.normalScale);
+        }
+    }
+    return target;
+}
+
+void MorphTargets::Accumulate(const MorphTarget& target, float weight, unsigned int firstVertex,
+                              glm::vec4* positions, glm::vec4* normals) {
+#ifdef MORPH_TARGETS_X86
+    AccumulateSSE(target, weight, firstVertex, positions, normals);
+#else
+    AccumulateScalar(target, weight, firstVertex, positions, normals);
+#endif
+}
+
+void MorphTargets::SampleWeights(const aiMeshMorphAnim* channel, float animationTime, std::vector<float>& weights) {
+    std::fill(weights.begin(), weights.end(), 0.0f);
+    if (channel->mNumKeys == 0) return;
+
+    unsigned int key = 0;
+    while (key + 1 < channel->mNumKeys && animationTime >= channel->mKeys[key + 1].mTime) {
+        key++;
+    }
+    unsigned int next = std::min(key + 1, channel->mNumKeys - 1);
+    float span = (float)(channel->mKeys[next].mTime - channel->mKeys[key].mTime);
+    float factor = span > 0.0f ? (animationTime - (float)channel->mKeys[key].mTime) / span : 0.0f;
+    factor = std::max(0.0f, std::min(1.0f, factor));
+
+    const aiMeshMorphKey* keys[2] = { &channel->mKeys[key], &channel->mKeys[next] };
+    float keyWeights[2] = { 1.0f - factor, factor };
+    for (int k = 0; k < 2; k++) {
+        for (unsigned int i = 0; i < keys[k]->mNumValuesAndWeights; i++) {
+            unsigned int target = keys[k]->mValues[i];
+            if (target < weights.size()) {
+                weights[target] += (float)keys[k]->mWeights[i] * keyWeights[k];
+            }
+        }
+    }
+}
+
+size_t MorphTargets::GetMemoryUsage(const MorphTarget& target) {
+    return target.vertices.size() * sizeof(unsigned int) + target.deltas.size() * sizeof(int16_t);
+}
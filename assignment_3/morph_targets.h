@@ -0,0 +1,40 @@
+#ifndef MORPH_TARGETS_H
+#define MORPH_TARGETS_H
+
+#include <glm/glm.hpp>
+#include <assimp/scene.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// A blend shape stored as sparse deltas: only the vertices the shape moves,
+// each with its position and normal offset quantized to 16 bits against the
+// largest offset of the target. Eight values per vertex (xyz plus padding for
+// each) so the blend loop reads one 128-bit block per vertex.
+struct MorphTarget {
+    std::string name;
+    std::vector<unsigned int> vertices;
+    std::vector<int16_t> deltas;
+    float positionScale = 0.0f;   // offset = quantized value * scale
+    float normalScale = 0.0f;
+};
+
+class MorphTargets {
+public:
+    // Weights below this are treated as zero and their targets are skipped
+    static constexpr float WEIGHT_EPSILON = 1e-4f;
+
+    // Assimp stores anim meshes as full copies of the vertices; keeps only the
+    // ones that differ from the base mesh
+    static MorphTarget Build(const aiMesh* mesh, const aiAnimMesh* animMesh);
+    // Adds weight * target to accumulators indexed from firstVertex
+    static void Accumulate(const MorphTarget& target, float weight, unsigned int firstVertex,
+                           glm::vec4* positions, glm::vec4* normals);
+    // Target weights of a morph channel at animationTime (ticks), linearly
+    // interpolated between keys; targets without a key get zero
+    static void SampleWeights(const aiMeshMorphAnim* channel, float animationTime, std::vector<float>& weights);
+    static size_t GetMemoryUsage(const MorphTarget& target);
+};
+
+#endif
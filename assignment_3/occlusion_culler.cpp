@@ -0,0 +1,306 @@
+#include "occlusion_culler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define OCCLUSION_CULLER_X86
+#include <emmintrin.h>
+#endif
+
+// Points outside the near plane (z < -w) are rejected, which for ordinary
+// projections keeps w positive; this guards the divide against degenerate ones
+static const float MIN_CLIP_W = 1e-4f;
+// Pixels whose center is this close outside an edge still count as covered
+static const float EDGE_BIAS = 1e-3f;
+
+OccluderMesh OccluderMesh::MakeBox(const glm::vec3& min, const glm::vec3& max) {
+    OccluderMesh box;
+    for (int i = 0; i < 8; i++) {
+        box.vertices.push_back(glm::vec3(i & 1 ? max.x : min.x, i & 2 ? max.y : min.y, i & 4 ? max.z : min.z));
+    }
+    // Two triangles per face; winding does not matter to the rasterizer
+    const unsigned int faces[6][4] = {
+        { 0, 1, 3, 2 }, { 4, 5, 7, 6 },   // -z, +z
+        { 0, 1, 5, 4 }, { 2, 3, 7, 6 },   // -y, +y
+        { 0, 2, 6, 4 }, { 1, 3, 7, 5 }    // -x, +x
+    };
+    for (int f = 0; f < 6; f++) {
+        const unsigned int order[6] = { 0, 1, 2, 0, 2, 3 };
+        for (int i = 0; i < 6; i++) box.indices.push_back(faces[f][order[i]]);
+    }
+    return box;
+}
+
+OcclusionCuller::OcclusionCuller(unsigned int threadCount) : jobs(threadCount) {
+    int width = WIDTH, height = HEIGHT;
+    while (true) {
+        levelWidth.push_back(width);
+        levelHeight.push_back(height);
+        pyramid.push_back(std::vector<float>(width * height, 1.0f));
+        if (width == 1 && height == 1) break;
+        width = (width + 1) / 2;
+        height = (height + 1) / 2;
+    }
+    worker = std::thread(&OcclusionCuller::WorkerLoop, this);
+}
+
+OcclusionCuller::~OcclusionCuller() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        quit = true;
+    }
+    work.notify_one();
+    worker.join();
+}
+
+void OcclusionCuller::Begin(const glm::mat4& viewProjectionMatrix, const std::vector<Occluder>& occluders,
+                            const std::vector<BoundingVolume>& boxes) {
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [this] { return !pending && !busy; });
+    viewProjection = viewProjectionMatrix;
+    pendingOccluders = occluders;
+    pendingBoxes = boxes;
+    pending = true;
+    lock.unlock();
+    work.notify_one();
+}
+
+const std::vector<unsigned char>& OcclusionCuller::Finish() {
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [this] { return !pending && !busy; });
+    return visibility;
+}
+
+void OcclusionCuller::WorkerLoop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        work.wait(lock, [this] { return pending || quit; });
+        if (quit) return;
+        pending = false;
+        busy = true;
+        lock.unlock();
+
+        // Begin() waits for busy to clear, so the pending frame is not touched meanwhile
+        Render(viewProjection, pendingOccluders);
+        TestBoxes(pendingBoxes, visibility);
+
+        lock.lock();
+        busy = false;
+        done.notify_all();
+    }
+}
+
+void OcclusionCuller::Render(const glm::mat4& viewProjectionMatrix, const std::vector<Occluder>& occluders) {
+    auto start = std::chrono::high_resolution_clock::now();
+    viewProjection = viewProjectionMatrix;
+    std::fill(pyramid[0].begin(), pyramid[0].end(), 1.0f);
+    SetupTriangles(occluders);
+
+    const unsigned int bands = (HEIGHT + TILE_ROWS - 1) / TILE_ROWS;
+    jobs.ParallelFor(bands, 1, [this](unsigned int begin, unsigned int end, unsigned int) {
+        for (unsigned int band = begin; band < end; band++) {
+            RasterizeBand(band * TILE_ROWS, std::min((int)(band + 1) * TILE_ROWS, HEIGHT));
+        }
+    });
+    BuildPyramid();
+
+    stats.occluderTriangles = (unsigned int)triangles.size();
+    stats.rasterMilliseconds = std::chrono::duration<double, std::milli>(
+        std::chrono::high_resolution_clock::now() - start).count();
+}
+
+// Projects the occluders and turns each triangle into edge and depth plane
+// equations in pixel space
+void OcclusionCuller::SetupTriangles(const std::vector<Occluder>& occluders) {
+    triangles.clear();
+    std::vector<glm::vec4> projected;
+    for (const auto& occluder : occluders) {
+        glm::mat4 transform = viewProjection * occluder.transform;
+        const OccluderMesh& mesh = *occluder.mesh;
+        projected.resize(mesh.vertices.size());
+        for (size_t i = 0; i < mesh.vertices.size(); i++) {
+            glm::vec4 clip = transform * glm::vec4(mesh.vertices[i], 1.0f);
+            // Between the eye and the near plane, or behind the eye
+            if (clip.z < -clip.w || clip.w < MIN_CLIP_W) {
+                projected[i] = glm::vec4(0.0f, 0.0f, 0.0f, -1.0f);
+                continue;
+            }
+            projected[i] = glm::vec4((clip.x / clip.w * 0.5f + 0.5f) * WIDTH,
+                                     (clip.y / clip.w * 0.5f + 0.5f) * HEIGHT,
+                                     clip.z / clip.w * 0.5f + 0.5f, 1.0f);
+        }
+
+        for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+            glm::vec4 v0 = projected[mesh.indices[i]];
+            glm::vec4 v1 = projected[mesh.indices[i + 1]];
+            glm::vec4 v2 = projected[mesh.indices[i + 2]];
+            if (v0.w < 0.0f || v1.w < 0.0f || v2.w < 0.0f) continue;
+
+            float area = (v1.x - v0.x) * (v2.y - v0.y) - (v1.y - v0.y) * (v2.x - v0.x);
+            if (std::fabs(area) < 1e-6f) continue;
+            if (area < 0.0f) {
+                std::swap(v1, v2);
+                area = -area;
+            }
+
+            Triangle triangle;
+            const glm::vec4* v[3] = { &v0, &v1, &v2 };
+            for (int e = 0; e < 3; e++) {
+                const glm::vec4& a = *v[e];
+                const glm::vec4& b = *v[(e + 1) % 3];
+                triangle.edgeA[e] = a.y - b.y;
+                triangle.edgeB[e] = b.x - a.x;
+                // Moved out by a thousandth of a pixel so rounding cannot open
+                // cracks along edges shared by two triangles
+                triangle.edgeC[e] = -(triangle.edgeA[e] * a.x + triangle.edgeB[e] * a.y) +
+                                    EDGE_BIAS * (std::fabs(triangle.edgeA[e]) + std::fabs(triangle.edgeB[e]));
+            }
+            triangle.depthA = ((v1.z - v0.z) * (v2.y - v0.y) - (v1.y - v0.y) * (v2.z - v0.z)) / area;
+            triangle.depthB = ((v1.x - v0.x) * (v2.z - v0.z) - (v1.z - v0.z) * (v2.x - v0.x)) / area;
+            triangle.depthC = v0.z - triangle.depthA * v0.x - triangle.depthB * v0.y;
+
+            triangle.minX = std::max(0, (int)std::floor(std::min(v0.x, std::min(v1.x, v2.x))));
+            triangle.maxX = std::min(WIDTH - 1, (int)std::ceil(std::max(v0.x, std::max(v1.x, v2.x))));
+            triangle.minY = std::max(0, (int)std::floor(std::min(v0.y, std::min(v1.y, v2.y))));
+            triangle.maxY = std::min(HEIGHT - 1, (int)std::ceil(std::max(v0.y, std::max(v1.y, v2.y))));
+            if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY) continue;
+            triangles.push_back(triangle);
+        }
+    }
+}
+
+// Fills rows [firstRow, endRow) with every triangle, keeping the nearest
+// depth; pixels are sampled at their centers
+void OcclusionCuller::RasterizeBand(int firstRow, int endRow) {
+    float* depth = pyramid[0].data();
+    for (const auto& triangle : triangles) {
+        int rowBegin = std::max(triangle.minY, firstRow);
+        int rowEnd = std::min(triangle.maxY + 1, endRow);
+#ifdef OCCLUSION_CULLER_X86
+        // WIDTH is a multiple of four, so aligned blocks never run past a row
+        int columnBegin = triangle.minX & ~3;
+#endif
+
+        for (int y = rowBegin; y < rowEnd; y++) {
+            float* row = depth + y * WIDTH;
+            float centerY = y + 0.5f;
+#ifdef OCCLUSION_CULLER_X86
+            __m128 offsets = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+            __m128 edgeRow[3], edgeStep[3];
+            for (int e = 0; e < 3; e++) {
+                __m128 a = _mm_set1_ps(triangle.edgeA[e]);
+                edgeRow[e] = _mm_add_ps(_mm_mul_ps(a, _mm_add_ps(_mm_set1_ps((float)columnBegin), offsets)),
+                                        _mm_set1_ps(triangle.edgeB[e] * centerY + triangle.edgeC[e]));
+                edgeStep[e] = _mm_mul_ps(a, _mm_set1_ps(4.0f));
+            }
+            __m128 depthA = _mm_set1_ps(triangle.depthA);
+            __m128 depthRow = _mm_add_ps(_mm_mul_ps(depthA, _mm_add_ps(_mm_set1_ps((float)columnBegin), offsets)),
+                                         _mm_set1_ps(triangle.depthB * centerY + triangle.depthC));
+            __m128 depthStep = _mm_mul_ps(depthA, _mm_set1_ps(4.0f));
+            const __m128 zero = _mm_setzero_ps();
+
+            for (int x = columnBegin; x <= triangle.maxX; x += 4) {
+                __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(edgeRow[0], zero), _mm_cmpge_ps(edgeRow[1], zero)),
+                                           _mm_cmpge_ps(edgeRow[2], zero));
+                if (_mm_movemask_ps(inside)) {
+                    __m128 current = _mm_loadu_ps(row + x);
+                    __m128 nearest = _mm_min_ps(current, depthRow);
+                    _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, current)));
+                }
+                for (int e = 0; e < 3; e++) edgeRow[e] = _mm_add_ps(edgeRow[e], edgeStep[e]);
+                depthRow = _mm_add_ps(depthRow, depthStep);
+            }
+#else
+            for (int x = triangle.minX; x <= triangle.maxX; x++) {
+                float centerX = x + 0.5f;
+                bool inside = true;
+                for (int e = 0; e < 3 && inside; e++) {
+                    inside = triangle.edgeA[e] * centerX + triangle.edgeB[e] * centerY + triangle.edgeC[e] >= 0.0f;
+                }
+                if (!inside) continue;
+                float z = triangle.depthA * centerX + triangle.depthB * centerY + triangle.depthC;
+                row[x] = std::min(row[x], z);
+            }
+#endif
+        }
+    }
+}
+
+void OcclusionCuller::BuildPyramid() {
+    for (size_t level = 1; level < pyramid.size(); level++) {
+        const std::vector<float>& below = pyramid[level - 1];
+        int belowWidth = levelWidth[level - 1], belowHeight = levelHeight[level - 1];
+        std::vector<float>& current = pyramid[level];
+        for (int y = 0; y < levelHeight[level]; y++) {
+            int y0 = y * 2, y1 = std::min(y * 2 + 1, belowHeight - 1);
+            for (int x = 0; x < levelWidth[level]; x++) {
+                int x0 = x * 2, x1 = std::min(x * 2 + 1, belowWidth - 1);
+                current[y * levelWidth[level] + x] = std::max(std::max(below[y0 * belowWidth + x0], below[y0 * belowWidth + x1]),
+                                                              std::max(below[y1 * belowWidth + x0], below[y1 * belowWidth + x1]));
+            }
+        }
+    }
+}
+
+bool OcclusionCuller::IsVisible(const BoundingVolume& box) const {
+    if (box.IsEmpty()) return true;
+
+    float minX = (float)WIDTH, maxX = 0.0f, minY = (float)HEIGHT, maxY = 0.0f;
+    float nearest = 1.0f;
+    for (int i = 0; i < 8; i++) {
+        glm::vec3 corner(i & 1 ? box.max.x : box.min.x, i & 2 ? box.max.y : box.min.y, i & 4 ? box.max.z : box.min.z);
+        glm::vec4 clip = viewProjection * glm::vec4(corner, 1.0f);
+        if (clip.z < -clip.w || clip.w < MIN_CLIP_W) return true;
+        float x = (clip.x / clip.w * 0.5f + 0.5f) * WIDTH;
+        float y = (clip.y / clip.w * 0.5f + 0.5f) * HEIGHT;
+        minX = std::min(minX, x);
+        maxX = std::max(maxX, x);
+        minY = std::min(minY, y);
+        maxY = std::max(maxY, y);
+        nearest = std::min(nearest, clip.z / clip.w * 0.5f + 0.5f);
+    }
+
+    int x0 = std::max(0, (int)std::floor(minX)), x1 = std::min(WIDTH - 1, (int)std::floor(maxX));
+    int y0 = std::max(0, (int)std::floor(minY)), y1 = std::min(HEIGHT - 1, (int)std::floor(maxY));
+    // Off screen: the frustum test decides those
+    if (x0 > x1 || y0 > y1) return true;
+
+    // Coarsest level on which the rectangle still spans at most two texels per axis
+    int level = 0;
+    while (level + 1 < (int)pyramid.size() && ((x1 >> level) - (x0 >> level) > 1 || (y1 >> level) - (y0 >> level) > 1)) {
+        level++;
+    }
+    const std::vector<float>& depth = pyramid[level];
+    int width = levelWidth[level];
+    for (int y = y0 >> level; y <= y1 >> level; y++) {
+        for (int x = x0 >> level; x <= x1 >> level; x++) {
+            if (nearest <= depth[y * width + x]) return true;
+        }
+    }
+    return false;
+}
+
+void OcclusionCuller::TestBoxes(const std::vector<BoundingVolume>& boxes, std::vector<unsigned char>& result) {
+    auto start = std::chrono::high_resolution_clock::now();
+    result.resize(boxes.size());
+    jobs.ParallelFor((unsigned int)boxes.size(), 256, [this, &boxes, &result](unsigned int begin, unsigned int end, unsigned int) {
+        for (unsigned int i = begin; i < end; i++) {
+            result[i] = IsVisible(boxes[i]) ? 1 : 0;
+        }
+    });
+
+    stats.tested = (unsigned int)boxes.size();
+    stats.occluded = (unsigned int)std::count(result.begin(), result.end(), 0);
+    stats.testMilliseconds = std::chrono::duration<double, std::milli>(
+        std::chrono::high_resolution_clock::now() - start).count();
+}
+
+const std::vector<float>& OcclusionCuller::GetDepthBuffer() const {
+    return pyramid[0];
+}
+
+const OcclusionCullerStats& OcclusionCuller::GetStats() const {
+    return stats;
+}
@@ -0,0 +1,108 @@
+#ifndef OCCLUSION_CULLER_H
+#define OCCLUSION_CULLER_H
+
+#include <glm/glm.hpp>
+
+#include "job_system.h"
+#include "skinned_bounds.h"
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Simplified closed geometry standing in for an object when it hides others.
+// It must lie inside the object it replaces, or things behind the gaps are
+// wrongly culled.
+struct OccluderMesh {
+    std::vector<glm::vec3> vertices;
+    std::vector<unsigned int> indices;
+
+    static OccluderMesh MakeBox(const glm::vec3& min, const glm::vec3& max);
+};
+
+struct Occluder {
+    const OccluderMesh* mesh;
+    glm::mat4 transform;
+};
+
+struct OcclusionCullerStats {
+    unsigned int occluderTriangles = 0;   // rasterized, after near-plane and degenerate rejection
+    unsigned int tested = 0;
+    unsigned int occluded = 0;
+    double rasterMilliseconds = 0.0;
+    double testMilliseconds = 0.0;
+};
+
+// Software occlusion culling on the CPU. Occluders are rasterized into a
+// small depth buffer that keeps the nearest depth per pixel; horizontal
+// bands of TILE_ROWS rows are filled in parallel, each sweeping its part of
+// every triangle four pixels at a time with SSE edge and depth tests. The
+// buffer is then reduced into a pyramid of 2x2 maxima, so each texel holds
+// the farthest occluder depth under it. A box is hidden when its nearest
+// corner is behind that depth everywhere on the level where its screen
+// rectangle spans at most a few texels.
+//
+// Begin() hands a frame to the culler's own thread and returns at once, so
+// the work overlaps simulation; Finish() waits for the result. Render() and
+// IsVisible() do the same work synchronously. No GL is involved, so the
+// culler runs and can be checked without a GPU.
+//
+// Depth is NDC z mapped to [0, 1]. Boxes crossing the near plane and
+// occluder triangles with a vertex behind it are left out, which only ever
+// makes the result more conservative.
+class OcclusionCuller {
+public:
+    static const int WIDTH = 256;
+    static const int HEIGHT = 144;
+    static const int TILE_ROWS = 8;
+
+    // threadCount includes the culler's own thread; 0 uses every hardware thread
+    explicit OcclusionCuller(unsigned int threadCount = 0);
+    ~OcclusionCuller();
+
+    void Begin(const glm::mat4& viewProjection, const std::vector<Occluder>& occluders,
+               const std::vector<BoundingVolume>& boxes);
+    // visible[i] is 0 when boxes[i] of the last Begin() is hidden
+    const std::vector<unsigned char>& Finish();
+
+    void Render(const glm::mat4& viewProjection, const std::vector<Occluder>& occluders);
+    bool IsVisible(const BoundingVolume& box) const;
+
+    const std::vector<float>& GetDepthBuffer() const;   // WIDTH x HEIGHT, rows bottom up
+    const OcclusionCullerStats& GetStats() const;
+
+private:
+    struct Triangle {
+        float edgeA[3], edgeB[3], edgeC[3];   // inside where A x + B y + C >= 0 for all edges
+        float depthA, depthB, depthC;         // depth = A x + B y + C
+        int minX, maxX, minY, maxY;           // pixel bounds, inclusive
+    };
+
+    JobSystem jobs;
+    glm::mat4 viewProjection = glm::mat4(1.0f);
+    std::vector<Triangle> triangles;
+    std::vector<std::vector<float>> pyramid;   // level 0 is the depth buffer
+    std::vector<int> levelWidth, levelHeight;
+    OcclusionCullerStats stats;
+
+    // Frame handed over by Begin()
+    std::vector<Occluder> pendingOccluders;
+    std::vector<BoundingVolume> pendingBoxes;
+    std::vector<unsigned char> visibility;
+    bool pending = false;
+    bool busy = false;
+    bool quit = false;
+    std::mutex mutex;
+    std::condition_variable work;
+    std::condition_variable done;
+    std::thread worker;
+
+    void WorkerLoop();
+    void SetupTriangles(const std::vector<Occluder>& occluders);
+    void RasterizeBand(int firstRow, int endRow);
+    void BuildPyramid();
+    void TestBoxes(const std::vector<BoundingVolume>& boxes, std::vector<unsigned char>& result);
+};
+
+#endif
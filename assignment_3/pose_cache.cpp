@@ -0,0 +1,117 @@
+#include "pose_cache.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <iterator>
+
+float PoseCacheStats::GetHitRate() const {
+    unsigned long long lookups = hits + misses;
+    return lookups ? (float)hits / lookups : 0.0f;
+}
+
+size_t PoseCache::KeyHash::operator()(const Key& key) const {
+    size_t hash = std::hash<const void*>()(key.model);
+    hash ^= std::hash<const void*>()(key.animation) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+    hash ^= std::hash<uint64_t>()(key.streamedClip) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+    hash ^= std::hash<int64_t>()(key.frame) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+    hash ^= std::hash<int>()(key.lod) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+    return hash;
+}
+
+PoseCache::PoseCache(const PoseCacheSettings& settings) : settings(settings) {
+}
+
+void PoseCache::SetSettings(const PoseCacheSettings& newSettings) {
+    settings = newSettings;
+    entries.clear();
+    lookup.clear();
+}
+
+const PoseCacheSettings& PoseCache::GetSettings() const {
+    return settings;
+}
+
+void PoseCache::Resolve(std::vector<PoseRequest>& requests) {
+    resolveCount++;
+    for (auto& request : requests) {
+        request.palette = nullptr;
+        request.evaluate = true;
+        if (settings.enabled && settings.capacity > 0 && settings.timeQuantum > 0.0f) {
+            ResolveRequest(request);
+        }
+    }
+}
+
+// Leaves palette null when the request is to evaluate straight into its output
+void PoseCache::ResolveRequest(PoseRequest& request) {
+    const Model& model = *request.model;
+    const StreamedClip* clip = request.clip;
+    const aiAnimation* animation = clip ? nullptr : model.GetAnimation();
+    if (!clip && !animation) return;
+
+    float ticksPerSecond = clip ? clip->clip.ticksPerSecond
+                                : (animation->mTicksPerSecond != 0 ? animation->mTicksPerSecond : 25.0f);
+    float quantum = settings.timeQuantum * ticksPerSecond;
+    Key key = { &model, animation, clip ? clip->serial : 0, (int64_t)std::floor(request.animationTime / quantum + 0.5f),
+                request.lod };
+    request.animationTime = key.frame * quantum;
+
+    // A hit may also be a pose another request of this Resolve() evaluates
+    auto found = lookup.find(key);
+    if (found != lookup.end()) {
+        entries.splice(entries.begin(), entries, found->second);
+        found->second->lastResolve = resolveCount;
+        request.palette = found->second->palette.data();
+        request.evaluate = false;
+        stats.hits++;
+        return;
+    }
+    stats.misses++;
+
+    // Recycle the least recently used entry once the cache is full, unless
+    // the workers are about to use it
+    if (entries.size() >= settings.capacity) {
+        if (entries.back().lastResolve == resolveCount) return;
+        lookup.erase(entries.back().key);
+        entries.splice(entries.begin(), entries, std::prev(entries.end()));
+        stats.evictions++;
+    }
+    else {
+        entries.push_front(Entry());
+    }
+    Entry& entry = entries.front();
+    entry.key = key;
+    entry.lastResolve = resolveCount;
+    entry.palette.resize(model.boneTransforms.size());
+    lookup[key] = entries.begin();
+    request.palette = entry.palette.data();
+}
+
+unsigned int PoseCache::Evaluate(const PoseRequest& request, glm::mat4* nodeGlobals) {
+    glm::mat4* palette = request.palette ? request.palette : request.output;
+    const Model& model = *request.model;
+    if (request.clip) {
+        return model.EvaluatePose(request.clip->clip, request.clip->nodeTracks, request.animationTime, nodeGlobals,
+                                  palette, request.reducedSkeleton);
+    }
+    return model.EvaluatePose(request.animationTime, nodeGlobals, palette, request.reducedSkeleton);
+}
+
+void PoseCache::CopyResult(const PoseRequest& request) {
+    if (!request.palette) return;
+    std::copy(request.palette, request.palette + request.model->boneTransforms.size(), request.output);
+}
+
+void PoseCache::Clear() {
+    entries.clear();
+    lookup.clear();
+}
+
+PoseCacheStats PoseCache::GetStats() const {
+    return stats;
+}
+
+void PoseCache::ResetStats() {
+    stats = PoseCacheStats();
+}
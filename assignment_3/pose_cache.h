@@ -0,0 +1,104 @@
+#ifndef POSE_CACHE_H
+#define POSE_CACHE_H
+
+#include <glm/glm.hpp>
+
+#include "clip_streamer.h"
+#include "model.h"
+
+#include <cstdint>
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+struct PoseCacheSettings {
+    bool enabled = false;
+    unsigned int capacity = 256;            // palettes kept before the least recently used is evicted
+    float timeQuantum = 1.0f / 60.0f;       // seconds; poses are evaluated on this grid
+};
+
+struct PoseCacheStats {
+    unsigned long long hits = 0;
+    unsigned long long misses = 0;
+    unsigned long long evictions = 0;
+
+    float GetHitRate() const;
+};
+
+// One pose an instance needs this frame. The caller fills the first block;
+// PoseCache::Resolve() fills the rest.
+struct PoseRequest {
+    const Model* model = nullptr;
+    const StreamedClip* clip = nullptr;   // played instead of the model's own clip when set
+    float animationTime = 0.0f;           // snapped to the cache grid by Resolve()
+    int lod = 0;
+    bool reducedSkeleton = false;
+    glm::mat4* output = nullptr;          // where the instance wants the palette
+
+    glm::mat4* palette = nullptr;         // cache entry holding the pose, null when not cached
+    bool evaluate = true;                 // this request computes the pose; the rest share it
+};
+
+// Shares evaluated palettes between instances that play the same clip at
+// (nearly) the same time. Animation time is snapped to a grid, so instances
+// landing in the same cell at the same LOD get a copy of one palette instead
+// of evaluating it again.
+//
+// The cache is only looked up and changed by Resolve(), on one thread
+// before the workers start. It hands every request either a cached palette
+// or a reserved entry that exactly one request evaluates into, and no entry
+// handed out is evicted before the next Resolve(), so Evaluate() and
+// CopyResult() run on the workers without taking a lock: first Evaluate()
+// for every request, then CopyResult() once all of them are done.
+class PoseCache {
+public:
+    explicit PoseCache(const PoseCacheSettings& settings = PoseCacheSettings());
+
+    void SetSettings(const PoseCacheSettings& settings);
+    const PoseCacheSettings& GetSettings() const;
+
+    void Resolve(std::vector<PoseRequest>& requests);
+    // Computes the pose of a request with evaluate set, into its entry or
+    // straight into its output; returns the number of bones evaluated
+    static unsigned int Evaluate(const PoseRequest& request, glm::mat4* nodeGlobals);
+    // Copies a cached pose to the request's output
+    static void CopyResult(const PoseRequest& request);
+
+    void Clear();
+    PoseCacheStats GetStats() const;
+    void ResetStats();
+
+private:
+    struct Key {
+        const Model* model;
+        const aiAnimation* animation;   // the model's own clip, or nullptr
+        uint64_t streamedClip;          // StreamedClip::serial, or 0
+        int64_t frame;
+        int lod;
+
+        bool operator==(const Key& other) const {
+            return model == other.model && animation == other.animation && streamedClip == other.streamedClip &&
+                   frame == other.frame && lod == other.lod;
+        }
+    };
+
+    struct KeyHash {
+        size_t operator()(const Key& key) const;
+    };
+
+    struct Entry {
+        Key key;
+        uint64_t lastResolve;   // entries handed out by the current Resolve() are not evicted
+        std::vector<glm::mat4> palette;
+    };
+
+    PoseCacheSettings settings;
+    std::list<Entry> entries;   // most recently used first
+    std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> lookup;
+    PoseCacheStats stats;
+    uint64_t resolveCount = 0;
+
+    void ResolveRequest(PoseRequest& request);
+};
+
+#endif
@@ -0,0 +1,292 @@
+#include "pre_skinner.h"
+
+#include "bone_palette.h"
+#include "gl_state.h"
+
+#include <cstddef>
+#include <cstring>
+#include <string>
+
+// Same blend as the main vertex shader, written out per vertex instead of
+// passed on to rasterization. Compiled through ShaderVariants like it, so
+// skinning mode, blend shapes and influence count are #defines rather than
+// branches.
+static const char* preSkinningShaderSource = R"(
+    #version 330 core
+    layout (location = 0) in vec3 aPos;
+    layout (location = 1) in vec3 aNormal;
+    layout (location = 3) in ivec4 aBoneIDs;
+    layout (location = 4) in vec4 aWeights;
+    #ifdef MORPHED
+    layout (location = 5) in vec3 aPositionOffset;   // this character's blend shapes
+    layout (location = 6) in vec3 aNormalOffset;
+    #endif
+
+    out vec3 skinnedPosition;
+    out vec3 skinnedNormal;
+
+    #ifdef SKINNED
+    uniform samplerBuffer boneTransforms;
+    uniform int boneTexelOffset;
+
+    // Unused slots hold bone -1 with weight 0, as in the main vertex shader
+    int getBone(int slot) {
+        return max(aBoneIDs[slot], 0);
+    }
+
+    #ifndef DUAL_QUATERNION
+    mat4 getBoneTransform(int bone) {
+        int texel = boneTexelOffset + bone * 3;
+        vec4 row0 = texelFetch(boneTransforms, texel);
+        vec4 row1 = texelFetch(boneTransforms, texel + 1);
+        vec4 row2 = texelFetch(boneTransforms, texel + 2);
+        return mat4(row0.x, row1.x, row2.x, 0.0,
+                    row0.y, row1.y, row2.y, 0.0,
+                    row0.z, row1.z, row2.z, 0.0,
+                    row0.w, row1.w, row2.w, 1.0);
+    }
+
+    // Weight the influences do not cover stays in the rest pose
+    void skin(inout vec3 position, inout vec3 normal) {
+        vec4 totalPosition = vec4(0.0);
+        vec3 totalNormal = vec3(0.0);
+        float totalWeight = 0.0;
+
+        for(int i = 0; i < BONE_INFLUENCES; i++) {
+            mat4 boneTransform = getBoneTransform(getBone(i));
+            totalPosition += boneTransform * vec4(position, 1.0) * aWeights[i];
+            totalNormal += mat3(boneTransform) * normal * aWeights[i];
+            totalWeight += aWeights[i];
+        }
+
+        position = totalPosition.xyz + position * (1.0 - totalWeight);
+        normal = totalNormal + normal * (1.0 - totalWeight);
+    }
+    #else
+    // Uncovered weight blends in the identity, as above
+    void skin(inout vec3 position, inout vec3 normal) {
+        int texel = boneTexelOffset + getBone(0) * 2;
+        vec4 pivot = texelFetch(boneTransforms, texel);
+        vec4 blendReal = pivot * aWeights[0];
+        vec4 blendDual = texelFetch(boneTransforms, texel + 1) * aWeights[0];
+        float totalWeight = aWeights[0];
+
+        for(int i = 1; i < BONE_INFLUENCES; i++) {
+            texel = boneTexelOffset + getBone(i) * 2;
+            vec4 real = texelFetch(boneTransforms, texel);
+            vec4 dual = texelFetch(boneTransforms, texel + 1);
+            float weight = dot(real, pivot) < 0.0 ? -aWeights[i] : aWeights[i];
+            blendReal += real * weight;
+            blendDual += dual * weight;
+            totalWeight += aWeights[i];
+        }
+        blendReal.w += 1.0 - totalWeight;
+
+        float len = length(blendReal);
+        vec3 r = blendReal.xyz / len;
+        float w = blendReal.w / len;
+        vec3 d = blendDual.xyz / len;
+        float dw = blendDual.w / len;
+        vec3 translation = 2.0 * (w * d - dw * r + cross(r, d));
+        position = position + 2.0 * cross(r, cross(r, position) + w * position) + translation;
+        normal = normal + 2.0 * cross(r, cross(r, normal) + w * normal);
+    }
+    #endif
+    #endif
+
+    void main() {
+        vec3 position = aPos;
+        vec3 normal = aNormal;
+    #ifdef MORPHED
+        position += aPositionOffset;
+        vec3 morphedNormal = aNormal + aNormalOffset;
+        if(dot(morphedNormal, morphedNormal) > 0.0) normal = normalize(morphedNormal);
+    #endif
+    #ifdef SKINNED
+        skin(position, normal);
+    #endif
+        skinnedPosition = position;
+        skinnedNormal = normal;
+    }
+)";
+
+// Layout of one transform feedback output vertex
+struct SkinnedVertex {
+    glm::vec3 position;
+    glm::vec3 normal;
+};
+
+PreSkinner::PreSkinner()
+: shaders(preSkinningShaderSource, std::vector<std::string>{ "skinnedPosition", "skinnedNormal" }) {
+    shaders.SetSampler("boneTransforms", BONE_PALETTE_TEXTURE_UNIT);
+}
+
+PreSkinner::~PreSkinner() {
+    for (auto& target : targets) {
+        for (auto& mesh : target.meshes) {
+            glDeleteVertexArrays(1, &mesh.vertexArray);
+            glDeleteBuffers(1, &mesh.buffer);
+            if (mesh.morphArray) glDeleteVertexArrays(1, &mesh.morphArray);
+            if (mesh.morphBuffer) glDeleteBuffers(1, &mesh.morphBuffer);
+        }
+    }
+    GLStateCache::Get().Invalidate();
+}
+
+int PreSkinner::AddTarget(Model* model) {
+    Target target;
+    target.model = model;
+    target.lastMode = model->skinningMode;
+
+    for (const auto& mesh : model->meshes) {
+        SkinnedMesh skinned;
+        glGenBuffers(1, &skinned.buffer);
+        glBindBuffer(GL_ARRAY_BUFFER, skinned.buffer);
+        glBufferData(GL_ARRAY_BUFFER, mesh.vertices.size() * sizeof(SkinnedVertex), NULL, GL_DYNAMIC_COPY);
+
+        // Skinned positions and normals, the mesh's own texture coordinates and indices
+        glGenVertexArrays(1, &skinned.vertexArray);
+        GLStateCache::Get().BindVertexArray(skinned.vertexArray);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(SkinnedVertex), (void*)offsetof(SkinnedVertex, position));
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(SkinnedVertex), (void*)offsetof(SkinnedVertex, normal));
+
+        glBindBuffer(GL_ARRAY_BUFFER, mesh.VBO);
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.EBO);
+
+        GLStateCache::Get().BindVertexArray(0);
+        if (mesh.GetMorphEnd() > 0) CreateMorphArray(mesh, skinned);
+        target.meshes.push_back(skinned);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    targets.push_back(target);
+    return (int)targets.size() - 1;
+}
+
+bool PreSkinner::Skin(int id, const glm::mat4* palette, const unsigned int* meshPaletteTexels) {
+    Target& target = targets[id];
+    if (target.skinned && !PoseChanged(target, palette)) {
+        stats.targetsSkipped++;
+        return false;
+    }
+
+    const Model* model = target.model;
+    unsigned int features = SHADER_SKINNED;
+    if (model->skinningMode == SkinningMode::DualQuaternion) features |= SHADER_DUAL_QUATERNION;
+    GLStateCache& state = GLStateCache::Get();
+    glEnable(GL_RASTERIZER_DISCARD);
+    for (size_t i = 0; i < model->meshes.size(); i++) {
+        const Mesh& mesh = model->meshes[i];
+        const SkinnedMesh& skinned = target.meshes[i];
+        // Textures play no part in skinning, so TEXTURED would only add variants
+        unsigned int key = ShaderVariants::ForMesh(features | (skinned.morphArray ? SHADER_MORPHED : 0), mesh);
+        Shader& shader = shaders.Get(key & ~SHADER_TEXTURED);
+        shader.use();
+        shader.setInt("boneTexelOffset", (int)meshPaletteTexels[i]);
+
+        // One point per vertex, so the output lines up with the mesh's indices
+        glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, skinned.buffer);
+        state.BindVertexArray(skinned.morphArray ? skinned.morphArray : mesh.VAO);
+        glBeginTransformFeedback(GL_POINTS);
+        glDrawArrays(GL_POINTS, 0, (GLsizei)mesh.vertices.size());
+        glEndTransformFeedback();
+        stats.verticesSkinned += mesh.vertices.size();
+    }
+    glDisable(GL_RASTERIZER_DISCARD);
+    glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+
+    target.lastPalette.assign(palette, palette + model->boneTransforms.size());
+    target.lastMode = model->skinningMode;
+    target.morphChanged = false;
+    target.skinned = true;
+    stats.targetsSkinned++;
+    return true;
+}
+
+void PreSkinner::SetMorphWeights(int id, const std::vector<std::vector<float>>& meshWeights) {
+    Target& target = targets[id];
+    for (size_t i = 0; i < target.meshes.size(); i++) {
+        SkinnedMesh& skinned = target.meshes[i];
+        if (!skinned.morphBuffer) continue;
+
+        // Compared in place, so unchanged weights cost no allocation
+        bool changed = false;
+        for (size_t t = 0; t < skinned.morphWeights.size(); t++) {
+            float weight = i < meshWeights.size() && t < meshWeights[i].size() ? meshWeights[i][t] : 0.0f;
+            if (weight != skinned.morphWeights[t]) {
+                skinned.morphWeights[t] = weight;
+                changed = true;
+            }
+        }
+        if (!changed) continue;
+
+        const Mesh& mesh = target.model->meshes[i];
+        unsigned int begin = mesh.GetMorphBegin();
+        unsigned int count = mesh.GetMorphEnd() - begin;
+        positionOffsets.assign(count, glm::vec4(0.0f));
+        normalOffsets.assign(count, glm::vec4(0.0f));
+        mesh.AccumulateMorphTargets(skinned.morphWeights.data(), positionOffsets.data(), normalOffsets.data());
+
+        glBindBuffer(GL_COPY_WRITE_BUFFER, skinned.morphBuffer);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, begin * sizeof(glm::vec4), count * sizeof(glm::vec4), positionOffsets.data());
+        glBufferSubData(GL_COPY_WRITE_BUFFER, (mesh.vertices.size() + begin) * sizeof(glm::vec4),
+                        count * sizeof(glm::vec4), normalOffsets.data());
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        target.morphChanged = true;
+    }
+}
+
+void PreSkinner::Draw(int id, Shader& shader) {
+    Target& target = targets[id];
+    for (size_t i = 0; i < target.meshes.size(); i++) {
+        target.model->meshes[i].Draw(shader, target.meshes[i].vertexArray);
+    }
+}
+
+unsigned int PreSkinner::GetVertexArray(int id, size_t mesh) const {
+    return targets[id].meshes[mesh].vertexArray;
+}
+
+const PreSkinnerStats& PreSkinner::GetStats() const {
+    return stats;
+}
+
+bool PreSkinner::PoseChanged(const Target& target, const glm::mat4* palette) const {
+    if (target.lastMode != target.model->skinningMode) return true;
+    if (target.morphChanged) return true;
+    if (target.lastPalette.size() != target.model->boneTransforms.size()) return true;
+    return std::memcmp(target.lastPalette.data(), palette, target.lastPalette.size() * sizeof(glm::mat4)) != 0;
+}
+
+// The mesh's skinning inputs with the offsets next to them; the offsets
+// start at zero, the base shape
+void PreSkinner::CreateMorphArray(const Mesh& mesh, SkinnedMesh& skinned) {
+    size_t vertexCount = mesh.vertices.size();
+    std::vector<glm::vec4> zeros(vertexCount * 2, glm::vec4(0.0f));
+    glGenBuffers(1, &skinned.morphBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, skinned.morphBuffer);
+    glBufferData(GL_ARRAY_BUFFER, zeros.size() * sizeof(glm::vec4), zeros.data(), GL_DYNAMIC_DRAW);
+    skinned.morphWeights.assign(mesh.morphTargets.size(), 0.0f);
+
+    glGenVertexArrays(1, &skinned.morphArray);
+    GLStateCache::Get().BindVertexArray(skinned.morphArray);
+    glEnableVertexAttribArray(5);
+    glVertexAttribPointer(5, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec4), (void*)0);
+    glEnableVertexAttribArray(6);
+    glVertexAttribPointer(6, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec4), (void*)(vertexCount * sizeof(glm::vec4)));
+
+    glBindBuffer(GL_ARRAY_BUFFER, mesh.VBO);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Position));
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
+    glEnableVertexAttribArray(3);
+    glVertexAttribIPointer(3, 4, GL_INT, sizeof(Vertex), (void*)offsetof(Vertex, BoneIDs));
+    glEnableVertexAttribArray(4);
+    glVertexAttribPointer(4, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Weights));
+    GLStateCache::Get().BindVertexArray(0);
+}
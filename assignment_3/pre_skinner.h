@@ -0,0 +1,82 @@
+#ifndef PRE_SKINNER_H
+#define PRE_SKINNER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "model.h"
+#include "shader.h"
+#include "shader_variants.h"
+
+#include <vector>
+
+struct PreSkinnerStats {
+    unsigned int targetsSkinned = 0;
+    unsigned int targetsSkipped = 0;   // pose identical to the last pass
+    unsigned long long verticesSkinned = 0;
+};
+
+// Skins characters once per frame on the GPU with transform feedback and
+// keeps the result in a vertex buffer per mesh, so every pass that draws the
+// character afterwards (depth prepass, shadows, picking, the main pass) reads
+// static geometry instead of blending four bones per vertex again.
+//
+// Skin() reads the palettes already uploaded to the BonePaletteBuffer and is
+// skipped for characters whose palette and morph weights have not changed
+// since their last pass. Each mesh is skinned by the transform feedback
+// variant for its skinning mode, bone influences and blend shapes.
+//
+// Targets sharing a model each have their own morph weights: SetMorphWeights()
+// blends a target's active blend shapes into a buffer of position and normal
+// offsets per morphed mesh, which the skinning pass adds to the shared base
+// vertices. The blend is only redone when the weights change.
+// Draw() binds the skinned copy: positions and normals come from the
+// transform feedback buffer, texture coordinates and indices from the mesh.
+class PreSkinner {
+public:
+    PreSkinner();
+    ~PreSkinner();
+
+    int AddTarget(Model* model);
+    // meshPaletteTexels holds the texel offset BonePaletteBuffer::Add returned
+    // for every mesh of the target; the palette buffer must be bound
+    bool Skin(int target, const glm::mat4* palette, const unsigned int* meshPaletteTexels);
+    // One vector of weights per mesh, as from Model::SampleMorphWeights();
+    // missing meshes and weights count as zero
+    void SetMorphWeights(int target, const std::vector<std::vector<float>>& meshWeights);
+    void Draw(int target, Shader& shader);
+    // Skinned VAO of one mesh of the target, for callers that draw it themselves
+    unsigned int GetVertexArray(int target, size_t mesh) const;
+
+    const PreSkinnerStats& GetStats() const;
+
+private:
+    struct SkinnedMesh {
+        unsigned int buffer = 0;   // interleaved position and normal per vertex
+        unsigned int vertexArray = 0;
+        // Meshes with morph targets only: offsets for every vertex, all
+        // positions then all normals, and the mesh's attributes plus them
+        unsigned int morphBuffer = 0;
+        unsigned int morphArray = 0;
+        std::vector<float> morphWeights;   // blended into morphBuffer
+    };
+
+    struct Target {
+        Model* model;
+        std::vector<SkinnedMesh> meshes;
+        std::vector<glm::mat4> lastPalette;
+        SkinningMode lastMode;
+        bool morphChanged = false;
+        bool skinned = false;
+    };
+
+    ShaderVariants shaders;   // SKINNED, DUAL_QUATERNION, MORPHED and BONE_INFLUENCES per mesh
+    std::vector<Target> targets;
+    PreSkinnerStats stats;
+    std::vector<glm::vec4> positionOffsets, normalOffsets;   // scratch for SetMorphWeights()
+
+    bool PoseChanged(const Target& target, const glm::mat4* palette) const;
+    static void CreateMorphArray(const Mesh& mesh, SkinnedMesh& skinned);
+};
+
+#endif
@@ -0,0 +1,212 @@
+#include "program_cache.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#endif
+#ifndef GL_PROGRAM_BINARY_LENGTH
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#endif
+#ifndef GL_NUM_PROGRAM_BINARY_FORMATS
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+
+typedef void (APIENTRYP PFNGLGETPROGRAMBINARYPROC)(GLuint program, GLsizei bufSize, GLsizei* length,
+                                                   GLenum* binaryFormat, void* binary);
+typedef void (APIENTRYP PFNGLPROGRAMBINARYPROC)(GLuint program, GLenum binaryFormat, const void* binary, GLsizei length);
+typedef void (APIENTRYP PFNGLPROGRAMPARAMETERIPROC)(GLuint program, GLenum pname, GLint value);
+static PFNGLGETPROGRAMBINARYPROC getProgramBinary = nullptr;
+static PFNGLPROGRAMBINARYPROC programBinary = nullptr;
+static PFNGLPROGRAMPARAMETERIPROC programParameteri = nullptr;
+
+// Start of every cache file; the binary follows
+struct ProgramBinaryHeader {
+    uint32_t magic;
+    uint32_t format;   // driver-specific, from glGetProgramBinary
+    uint64_t key;      // guards against a renamed or truncated file
+    uint32_t length;
+    uint32_t padding;
+};
+
+static const uint32_t BINARY_MAGIC = 0x4E494250;   // "PBIN"
+// Part of every key; bump it when the file layout changes
+static const uint64_t CACHE_VERSION = 1;
+
+static const uint64_t FNV_OFFSET = 14695981039346656037ull;
+static const uint64_t FNV_PRIME = 1099511628211ull;
+
+static uint64_t HashBytes(uint64_t hash, const void* data, size_t size) {
+    const unsigned char* bytes = (const unsigned char*)data;
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ bytes[i]) * FNV_PRIME;
+    }
+    return hash;
+}
+
+// The length goes in too, so no two different sequences of strings hash
+// the same bytes
+static uint64_t HashString(uint64_t hash, const char* text) {
+    size_t length = text ? std::strlen(text) : 0;
+    hash = HashBytes(hash, &length, sizeof(length));
+    return HashBytes(hash, text, length);
+}
+
+static bool HasExtension(const char* name) {
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (GLint i = 0; i < count; i++) {
+        const char* extension = (const char*)glGetStringi(GL_EXTENSIONS, i);
+        if (extension && std::strcmp(extension, name) == 0) return true;
+    }
+    return false;
+}
+
+ProgramCache& ProgramCache::Get() {
+    static ProgramCache cache;
+    return cache;
+}
+
+bool ProgramCache::Init(GLADloadproc load, const std::string& cacheDirectory) {
+    enabled = false;
+    getProgramBinary = nullptr;
+    programBinary = nullptr;
+    programParameteri = nullptr;
+    bool core = GLVersion.major > 4 || (GLVersion.major == 4 && GLVersion.minor >= 1);
+    if (core || HasExtension("GL_ARB_get_program_binary")) {
+        getProgramBinary = (PFNGLGETPROGRAMBINARYPROC)load("glGetProgramBinary");
+        programBinary = (PFNGLPROGRAMBINARYPROC)load("glProgramBinary");
+        programParameteri = (PFNGLPROGRAMPARAMETERIPROC)load("glProgramParameteri");
+    }
+    if (!getProgramBinary || !programBinary || !programParameteri) return false;
+
+    // Some drivers expose the calls but cannot save anything
+    GLint formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    if (formats <= 0) return false;
+
+    driverHash = HashBytes(FNV_OFFSET, &CACHE_VERSION, sizeof(CACHE_VERSION));
+    driverHash = HashString(driverHash, (const char*)glGetString(GL_VENDOR));
+    driverHash = HashString(driverHash, (const char*)glGetString(GL_RENDERER));
+    driverHash = HashString(driverHash, (const char*)glGetString(GL_VERSION));
+
+    directory = cacheDirectory;
+#ifdef _WIN32
+    _mkdir(directory.c_str());
+#else
+    mkdir(directory.c_str(), 0755);
+#endif
+    enabled = true;
+    return true;
+}
+
+bool ProgramCache::IsEnabled() const {
+    return enabled;
+}
+
+uint64_t ProgramCache::MakeKey(const char* const* sources, unsigned int count) const {
+    uint64_t key = driverHash;
+    for (unsigned int i = 0; i < count; i++) {
+        key = HashString(key, sources[i]);
+    }
+    return key;
+}
+
+bool ProgramCache::Load(unsigned int program, uint64_t key) {
+    if (!enabled) return false;
+
+    std::ifstream file(GetPath(key), std::ios::binary | std::ios::ate);
+    if (!file) {
+        stats.missed++;
+        return false;
+    }
+    std::streamoff fileSize = file.tellg();
+    file.seekg(0);
+
+    // The length is checked against the file before anything is allocated,
+    // so a damaged header cannot ask for gigabytes
+    ProgramBinaryHeader header;
+    std::vector<char> binary;
+    bool valid = (bool)file.read((char*)&header, sizeof(header)) && header.magic == BINARY_MAGIC && header.key == key &&
+                 header.length > 0 && (std::streamoff)header.length == fileSize - (std::streamoff)sizeof(header);
+    if (valid) {
+        binary.resize(header.length);
+        valid = (bool)file.read(binary.data(), header.length);
+    }
+
+    GLint linked = 0;
+    if (valid) {
+        programBinary(program, header.format, binary.data(), (GLsizei)header.length);
+        glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    }
+    if (!linked) {
+        stats.missed++;
+        stats.rejected++;
+        return false;
+    }
+    stats.loaded++;
+    return true;
+}
+
+void ProgramCache::PrepareLink(unsigned int program) const {
+    if (enabled) programParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+}
+
+// Written under a temporary name and renamed, so an interrupted write never
+// leaves a truncated binary behind
+void ProgramCache::Store(unsigned int program, uint64_t key) {
+    if (!enabled) return;
+
+    GLint linked = 0, length = 0;
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (!linked || length <= 0) return;
+
+    ProgramBinaryHeader header;
+    std::vector<char> binary(length);
+    GLsizei written = 0;
+    GLenum format = 0;
+    getProgramBinary(program, length, &written, &format, binary.data());
+    if (written <= 0) return;
+    header.magic = BINARY_MAGIC;
+    header.format = format;
+    header.key = key;
+    header.length = (uint32_t)written;
+    header.padding = 0;
+
+    std::string path = GetPath(key);
+    std::string temporary = path + ".tmp";
+    bool saved;
+    {
+        std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+        saved = file.write((const char*)&header, sizeof(header)) && file.write(binary.data(), written);
+    }
+    // rename() does not replace an existing file everywhere
+    if (saved) std::remove(path.c_str());
+    if (!saved || std::rename(temporary.c_str(), path.c_str()) != 0) {
+        std::cout << "ERROR::PROGRAM_CACHE::WRITE_FAILED: " << path << std::endl;
+        std::remove(temporary.c_str());
+        return;
+    }
+    stats.stored++;
+}
+
+const ProgramCacheStats& ProgramCache::GetStats() const {
+    return stats;
+}
+
+std::string ProgramCache::GetPath(uint64_t key) const {
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)key);
+    return directory + "/" + name;
+}
@@ -0,0 +1,59 @@
+#ifndef PROGRAM_CACHE_H
+#define PROGRAM_CACHE_H
+
+#include <glad/glad.h>
+
+#include <cstdint>
+#include <string>
+
+struct ProgramCacheStats {
+    unsigned int loaded = 0;     // programs linked from a cached binary
+    unsigned int missed = 0;     // built from source instead
+    unsigned int rejected = 0;   // of those, binaries the driver refused or that were damaged
+    unsigned int stored = 0;     // binaries written
+};
+
+// Linked programs saved to disk with glGetProgramBinary, so later launches
+// restore them with glProgramBinary instead of compiling and linking GLSL.
+// Each binary is one file named after its key, a hash of the program's
+// sources (which carry their #defines) and of the driver's vendor, renderer
+// and version strings; a driver update therefore misses rather than loads
+// a stale binary. A driver may still refuse a binary with the same strings,
+// so Load() checks the link status and the caller falls back to building
+// from source, after which Store() replaces the file.
+//
+// glad's 3.3 loader covers none of the entry points. Init() fetches them
+// on GL 4.1 contexts or with ARB_get_program_binary; without them, or when
+// the driver offers no binary format, Load() always misses and Store() does
+// nothing.
+class ProgramCache {
+public:
+    static ProgramCache& Get();
+
+    // Call once after gladLoadGLLoader; files go to directory, which is
+    // created if needed
+    bool Init(GLADloadproc load, const std::string& directory);
+    bool IsEnabled() const;
+
+    uint64_t MakeKey(const char* const* sources, unsigned int count) const;
+    // Links program from the binary stored under key; false if there is
+    // none or it was rejected, leaving program to be built from source
+    bool Load(unsigned int program, uint64_t key);
+    // Marks program's binary as retrievable; call before glLinkProgram
+    void PrepareLink(unsigned int program) const;
+    // Saves the binary of program, if it linked, under key
+    void Store(unsigned int program, uint64_t key);
+
+    const ProgramCacheStats& GetStats() const;
+
+private:
+    bool enabled = false;
+    std::string directory;
+    uint64_t driverHash = 0;
+    ProgramCacheStats stats;
+
+    ProgramCache() {}
+    std::string GetPath(uint64_t key) const;
+};
+
+#endif
@@ -0,0 +1,310 @@
+#include "render_queue.h"
+
+#include "gl_state.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <iostream>
+
+// Past this many bytes of instances per frame the ring stops growing and
+// only the batches that fit are drawn
+static const unsigned int MAX_INSTANCE_REGION_SIZE = 64 * 1024 * 1024;
+
+RenderQueue::RenderQueue(UniformBlocks& blocks, unsigned int instanceRegionSize)
+: uniformBlocks(blocks), stream(instanceRegionSize) {}
+
+unsigned int RenderQueue::AddMaterial(const Material& material) {
+    materials.push_back(material);
+    return (unsigned int)materials.size() - 1;
+}
+
+void RenderQueue::Begin(const glm::mat4& viewMatrix) {
+    stream.BeginFrame();
+    view = viewMatrix;
+    items.clear();
+    itemShaders.clear();
+}
+
+void RenderQueue::Submit(const DrawItem& item) {
+    Push(item);
+    if (!items.back().vertexArray) {
+        items.back().vertexArray = item.mesh->VAO;
+    }
+}
+
+void RenderQueue::Submit(Model* model, unsigned int material, const glm::mat4& transform, RenderPass pass) {
+    DrawItem item;
+    item.material = material;
+    item.transform = transform;
+    item.pass = pass;
+    for (auto& mesh : model->meshes) {
+        item.mesh = &mesh;
+        item.vertexArray = mesh.VAO;
+        Push(item);
+    }
+}
+
+// Picks the item's variant once, rather than on every use while sorting and drawing
+void RenderQueue::Push(const DrawItem& item) {
+    const Material& material = materials[item.material];
+    unsigned int key = ShaderVariants::ForMesh(material.variant | SHADER_INSTANCED, *item.mesh);
+    items.push_back(item);
+    itemShaders.push_back(&material.shaders->Get(key));
+}
+
+void RenderQueue::Flush() {
+    Sort();
+    BuildBatches();
+    drawCalls = 0;
+    if (instances.empty()) return;
+
+    WriteInstances();
+    glBindBuffer(GL_ARRAY_BUFFER, stream.GetBuffer());
+    DrawPooled();
+
+    int currentMaterial = -1;
+    bool blending = false;
+    for (const auto& batch : batches) {
+        if (batch.pooled || batch.first + batch.count > writtenInstances) continue;
+        const DrawItem& item = items[entries[batch.first].item];
+        bool transparent = item.pass == RenderPass::Transparent;
+        if (transparent != blending) {
+            if (transparent) {
+                glEnable(GL_BLEND);
+                glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+                glDepthMask(GL_FALSE);
+            } else {
+                glDisable(GL_BLEND);
+                glDepthMask(GL_TRUE);
+            }
+            blending = transparent;
+        }
+
+        if ((int)item.material != currentMaterial) {
+            ObjectBlock object;
+            object.color = MaterialColor(item.material);
+            uniformBlocks.SetObject(object);
+            currentMaterial = (int)item.material;
+        }
+        Shader& shader = *itemShaders[entries[batch.first].item];
+        shader.use();
+        BindInstances(item.vertexArray, batch.first);
+        item.mesh->DrawInstanced(shader, batch.count, item.vertexArray);
+        drawCalls++;
+    }
+
+    if (blending) {
+        glDisable(GL_BLEND);
+        glDepthMask(GL_TRUE);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+// Grows the ring to the frame's instances, so the queue scales with the
+// scene. Above MAX_INSTANCE_REGION_SIZE only the leading instances are
+// written, and batches past them are skipped instead of the whole frame.
+void RenderQueue::WriteInstances() {
+    unsigned int count = (unsigned int)instances.size();
+    unsigned int maxCount = MAX_INSTANCE_REGION_SIZE / sizeof(Instance);
+    if (count > maxCount) {
+        if (!reportedTooMany) {
+            std::cout << "ERROR::RENDER_QUEUE::TOO_MANY_INSTANCES: " << count << ", drawing the first "
+                      << maxCount << std::endl;
+            reportedTooMany = true;
+        }
+        count = maxCount;
+    }
+
+    stream.Reserve(count * sizeof(Instance));
+    instanceOffset = stream.Write(instances.data(), count * sizeof(Instance), sizeof(glm::vec4));
+    writtenInstances = instanceOffset == StreamBuffer::INVALID_OFFSET ? 0 : count;
+}
+
+const StreamBuffer& RenderQueue::GetInstanceStream() const {
+    return stream;
+}
+
+unsigned int RenderQueue::GetItemCount() const {
+    return (unsigned int)items.size();
+}
+
+unsigned int RenderQueue::GetDrawCount() const {
+    return drawCalls;
+}
+
+void RenderQueue::SetMeshPool(MeshPool* pool) {
+    meshPool = pool;
+}
+
+uint64_t RenderQueue::MakeKey(const DrawItem& item, const Shader& shader) const {
+    float distance = -(view * item.transform[3]).z;
+    distance = std::max(distance, 0.0f);
+    uint32_t bits;
+    std::memcpy(&bits, &distance, sizeof(bits));
+    uint64_t depth = bits >> 8;
+    uint64_t state = ((uint64_t)(shader.ID & 0xFF) << 28) |
+                     ((uint64_t)(item.material & 0xFFF) << 16) |
+                     (uint64_t)(item.vertexArray & 0xFFFF);
+
+    if (item.pass == RenderPass::Transparent) {
+        return (1ull << 62) | ((0xFFFFFFull - depth) << 36) | state;
+    }
+    return (state << 24) | depth;
+}
+
+void RenderQueue::Sort() {
+    size_t count = items.size();
+    entries.resize(count);
+    scratch.resize(count);
+    if (count == 0) return;
+
+    // Histograms of all eight bytes in one pass over the keys
+    unsigned int histograms[8][256] = {};
+    for (size_t i = 0; i < count; i++) {
+        entries[i].key = MakeKey(items[i], *itemShaders[i]);
+        entries[i].item = (unsigned int)i;
+        for (int b = 0; b < 8; b++) {
+            histograms[b][(entries[i].key >> (b * 8)) & 0xFF]++;
+        }
+    }
+
+    for (int b = 0; b < 8; b++) {
+        unsigned int* histogram = histograms[b];
+        // All keys share this byte; the pass would not move anything
+        if (histogram[(entries[0].key >> (b * 8)) & 0xFF] == count) continue;
+
+        unsigned int offset = 0;
+        for (int digit = 0; digit < 256; digit++) {
+            unsigned int size = histogram[digit];
+            histogram[digit] = offset;
+            offset += size;
+        }
+        for (size_t i = 0; i < count; i++) {
+            unsigned int digit = (entries[i].key >> (b * 8)) & 0xFF;
+            scratch[histogram[digit]++] = entries[i];
+        }
+        entries.swap(scratch);
+    }
+}
+
+// Writes the instances in sorted order and splits them into runs that share
+// pass, material and VAO
+void RenderQueue::BuildBatches() {
+    instances.resize(entries.size());
+    batches.clear();
+    for (size_t i = 0; i < entries.size(); i++) {
+        const DrawItem& item = items[entries[i].item];
+        instances[i].transform = ShaderVariants::PackInstanceTransform(item.transform);
+        instances[i].color = item.color;
+
+        if (!batches.empty()) {
+            const DrawItem& first = items[entries[batches.back().first].item];
+            if (first.pass == item.pass && first.material == item.material && first.mesh == item.mesh &&
+                first.vertexArray == item.vertexArray) {
+                batches.back().count++;
+                if (batches.back().pooled) instances[i].color *= MaterialColor(item.material);
+                continue;
+            }
+        }
+        Batch batch;
+        batch.first = (unsigned int)i;
+        batch.count = 1;
+        batch.pooled = IsPooled(item);
+        if (batch.pooled) instances[i].color *= MaterialColor(item.material);
+        batches.push_back(batch);
+    }
+}
+
+// Points the VAO's instance attributes at the run starting at firstInstance.
+// The instance buffer must be bound to GL_ARRAY_BUFFER.
+void RenderQueue::BindInstances(unsigned int vertexArray, unsigned int firstInstance) {
+    GLStateCache::Get().BindVertexArray(vertexArray);
+    bool enable = instancedArrays.insert(vertexArray).second;
+    size_t base = instanceOffset + firstInstance * sizeof(Instance);
+
+    // A mat4 attribute takes four consecutive locations
+    for (unsigned int column = 0; column < 4; column++) {
+        if (enable) {
+            glEnableVertexAttribArray(INSTANCE_ATTRIBUTE + column);
+            glVertexAttribDivisor(INSTANCE_ATTRIBUTE + column, 1);
+        }
+        glVertexAttribPointer(INSTANCE_ATTRIBUTE + column, 4, GL_FLOAT, GL_FALSE, sizeof(Instance),
+                              (void*)(base + offsetof(Instance, transform) + column * sizeof(glm::vec4)));
+    }
+    if (enable) {
+        glEnableVertexAttribArray(INSTANCE_ATTRIBUTE + 4);
+        glVertexAttribDivisor(INSTANCE_ATTRIBUTE + 4, 1);
+    }
+    glVertexAttribPointer(INSTANCE_ATTRIBUTE + 4, 4, GL_FLOAT, GL_FALSE, sizeof(Instance),
+                          (void*)(base + offsetof(Instance, color)));
+}
+
+// Opaque items without textures whose mesh is in the pool can be drawn
+// together with any other such item of the same shader
+bool RenderQueue::IsPooled(const DrawItem& item) const {
+    return meshPool && item.pass == RenderPass::Opaque && item.mesh->textures.empty() &&
+           item.vertexArray == item.mesh->VAO && meshPool->Find(item.mesh);
+}
+
+glm::vec4 RenderQueue::MaterialColor(unsigned int material) const {
+    const Material& entry = materials[material];
+    return glm::vec4(entry.color, entry.opacity);
+}
+
+// Draws the pooled batches before everything else, in sort order, with one
+// multi-draw per shader: material colors are already in the instance colors,
+// so the material uniforms are set to neutral values once. On GL 3.3 each
+// command becomes a glDrawElementsInstancedBaseVertex with the instance
+// attributes moved to its first instance, which the multi-draw does through
+// baseInstance.
+void RenderQueue::DrawPooled() {
+    if (!meshPool) return;
+
+    for (auto& pass : pooledPasses) pass.commands.clear();
+    for (const auto& batch : batches) {
+        if (!batch.pooled || batch.first + batch.count > writtenInstances) continue;
+        const DrawItem& item = items[entries[batch.first].item];
+        Shader* shader = itemShaders[entries[batch.first].item];
+        PooledPass* pass = nullptr;
+        for (auto& candidate : pooledPasses) {
+            if (candidate.shader == shader) pass = &candidate;
+        }
+        if (!pass) {
+            pooledPasses.push_back(PooledPass());
+            pass = &pooledPasses.back();
+            pass->shader = shader;
+        }
+
+        const PooledMesh* mesh = meshPool->Find(item.mesh);
+        DrawElementsIndirectCommand command;
+        command.count = mesh->indexCount;
+        command.instanceCount = batch.count;
+        command.firstIndex = mesh->firstIndex;
+        command.baseVertex = mesh->baseVertex;
+        command.baseInstance = batch.first;
+        pass->commands.push_back(command);
+    }
+
+    unsigned int vertexArray = meshPool->GetVertexArray();
+    for (const auto& pass : pooledPasses) {
+        if (pass.commands.empty()) continue;
+        // Material colors are in the instance colors
+        uniformBlocks.SetObject(ObjectBlock());
+        pass.shader->use();
+
+        if (MeshPool::IsMultiDrawAvailable()) {
+            BindInstances(vertexArray, 0);
+            meshPool->MultiDraw(pass.commands);
+            drawCalls++;
+            continue;
+        }
+        for (const auto& command : pass.commands) {
+            BindInstances(vertexArray, command.baseInstance);
+            glDrawElementsInstancedBaseVertex(GL_TRIANGLES, command.count, GL_UNSIGNED_INT,
+                                              (void*)(command.firstIndex * sizeof(unsigned int)),
+                                              command.instanceCount, command.baseVertex);
+            drawCalls++;
+        }
+    }
+}
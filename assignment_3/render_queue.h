@@ -0,0 +1,150 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "mesh_pool.h"
+#include "model.h"
+#include "shader.h"
+#include "shader_variants.h"
+#include "stream_buffer.h"
+#include "uniform_blocks.h"
+
+#include <cstdint>
+#include <unordered_set>
+#include <vector>
+
+enum class RenderPass {
+    Opaque,        // depth tested and written, sorted front to back
+    Transparent    // alpha blended without depth writes, sorted back to front
+};
+
+// Shader variants and per-draw surface uniforms shared by every item that uses it
+struct Material {
+    ShaderVariants* shaders = nullptr;
+    unsigned int variant = 0;   // key without SKINNED; the queue adds INSTANCED and TEXTURED per mesh
+    glm::vec3 color = glm::vec3(1.0f);
+    float opacity = 1.0f;
+};
+
+struct DrawItem {
+    Mesh* mesh = nullptr;
+    unsigned int vertexArray = 0;   // VAO holding the mesh's vertices, 0 for the mesh's own
+    unsigned int material = 0;      // id from RenderQueue::AddMaterial
+    glm::mat4 transform = glm::mat4(1.0f);
+    glm::vec4 color = glm::vec4(1.0f);   // multiplies the material's color and opacity
+    RenderPass pass = RenderPass::Opaque;
+};
+
+// Collects the frame's draws and issues them in an order that minimizes
+// state changes. Every item gets a 64-bit key:
+//
+//   opaque:       pass:2 | shader:8 | material:12 | vertex array:16 | depth:24
+//   transparent:  pass:2 | ~depth:24 | shader:8 | material:12 | vertex array:16
+//
+// so opaque draws are grouped by program, then material, then VAO, and go
+// front to back within a group for early depth rejection, while transparent
+// draws blend back to front. Depth is the top 24 bits of the view-space
+// distance as a float, whose bit pattern orders like the value for positive
+// numbers. Keys are sorted with an LSD radix sort over bytes, skipping the
+// bytes all keys share.
+//
+// Each item is drawn with the instanced variant of its material's key for
+// its mesh, so meshes with textures get the TEXTURED one. After sorting,
+// runs of items with the same material and VAO are drawn as one instanced
+// call. Their transforms, packed with their normal matrices, and colors are
+// written, in sorted order, into the frame's region of the queue's own
+// StreamBuffer; each run's VAO reads them at locations 10-14 (mat4
+// transform, vec4 color) from the run's offset. That buffer grows with the
+// number of items, so Begin() moves it to its next region and must be
+// called once per frame. Opaque runs cover every item sharing mesh and
+// material, transparent ones only neighbours in depth order.
+//
+// With a MeshPool set, opaque runs whose mesh is pooled and untextured skip
+// the per-mesh path: they are written as indirect commands into the pool's
+// shared geometry and each shader's share goes out as one
+// glMultiDrawElementsIndirect (a loop of glDrawElementsInstancedBaseVertex
+// on GL 3.3), with the material color folded into the instance color.
+//
+// Flush() writes each material's color and opacity to the Object uniform
+// block; the frame, camera and light blocks are shared by every shader and
+// set by the caller before flushing.
+class RenderQueue {
+public:
+    // instanceRegionSize is the starting size of each frame's instance region
+    RenderQueue(UniformBlocks& uniformBlocks, unsigned int instanceRegionSize);
+
+    unsigned int AddMaterial(const Material& material);
+
+    // Clears the queue; view is used to compute each item's depth
+    void Begin(const glm::mat4& view);
+    void Submit(const DrawItem& item);
+    // One item per mesh of the model
+    void Submit(Model* model, unsigned int material, const glm::mat4& transform,
+                RenderPass pass = RenderPass::Opaque);
+    void Flush();
+
+    // Draws pooled meshes through the multi-draw path; nullptr disables it
+    void SetMeshPool(MeshPool* pool);
+
+    unsigned int GetItemCount() const;
+    unsigned int GetDrawCount() const;   // draw calls of the last Flush()
+    const StreamBuffer& GetInstanceStream() const;
+
+private:
+    static const unsigned int INSTANCE_ATTRIBUTE = 10;
+
+    struct SortEntry {
+        uint64_t key;
+        unsigned int item;
+    };
+
+    struct Instance {
+        glm::mat4 transform;
+        glm::vec4 color;
+    };
+
+    // Items entries[first, first + count) drawn with one call
+    struct Batch {
+        unsigned int first;
+        unsigned int count;
+        bool pooled;
+    };
+
+    // Pooled batches of one shader, drawn with one multi-draw
+    struct PooledPass {
+        Shader* shader = nullptr;
+        std::vector<DrawElementsIndirectCommand> commands;
+    };
+
+    UniformBlocks& uniformBlocks;
+    std::vector<Material> materials;
+    std::vector<DrawItem> items;
+    std::vector<Shader*> itemShaders;   // variant of each item, parallel to items
+    std::vector<SortEntry> entries;
+    std::vector<SortEntry> scratch;
+    std::vector<Instance> instances;
+    std::vector<Batch> batches;
+    std::unordered_set<unsigned int> instancedArrays;   // VAOs with the instance attributes enabled
+    std::vector<PooledPass> pooledPasses;
+    MeshPool* meshPool = nullptr;
+    StreamBuffer stream;                  // instances only
+    unsigned int instanceOffset = 0;      // of this frame's instances in the stream
+    unsigned int writtenInstances = 0;    // leading instances in the stream this frame
+    bool reportedTooMany = false;
+    unsigned int drawCalls = 0;
+    glm::mat4 view = glm::mat4(1.0f);
+
+    void Push(const DrawItem& item);
+    uint64_t MakeKey(const DrawItem& item, const Shader& shader) const;
+    void Sort();
+    void BuildBatches();
+    bool IsPooled(const DrawItem& item) const;
+    glm::vec4 MaterialColor(unsigned int material) const;
+    void WriteInstances();
+    void DrawPooled();
+    void BindInstances(unsigned int vertexArray, unsigned int firstInstance);
+};
+
+#endif
@@ -1,94 +1,185 @@
-#include "shader.h"
-
-Shader::Shader(const char* vertexPath, const char* fragmentPath) {
-    std::string vertexCode, fragmentCode;
-    std::ifstream vShaderFile, fShaderFile;
-    
-    vShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-    fShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-    
-    try {
-        vShaderFile.open(vertexPath);
-        fShaderFile.open(fragmentPath);
-        std::stringstream vShaderStream, fShaderStream;
-        
-        vShaderStream << vShaderFile.rdbuf();
-        fShaderStream << fShaderFile.rdbuf();
-        
-        vShaderFile.close();
-        fShaderFile.close();
-        
-        vertexCode = vShaderStream.str();
-        fragmentCode = fShaderStream.str();
-    }
-    catch (std::ifstream::failure& e) {
-        std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ" << std::endl;
-    }
-    
-    const char* vShaderCode = vertexCode.c_str();
-    const char* fShaderCode = fragmentCode.c_str();
-    
-    unsigned int vertex, fragment;
-    
-    vertex = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertex, 1, &vShaderCode, NULL);
-    glCompileShader(vertex);
-    checkCompileErrors(vertex, "VERTEX");
-    
-    fragment = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragment, 1, &fShaderCode, NULL);
-    glCompileShader(fragment);
-    checkCompileErrors(fragment, "FRAGMENT");
-    
-    ID = glCreateProgram();
-    glAttachShader(ID, vertex);
-    glAttachShader(ID, fragment);
-    glLinkProgram(ID);
-    checkCompileErrors(ID, "PROGRAM");
-    
-    glDeleteShader(vertex);
-    glDeleteShader(fragment);
-}
-
-void Shader::use() { 
-    glUseProgram(ID); 
-}
-
-void Shader::setMat4(const std::string &name, const glm::mat4 &mat) const {
-    glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
-}
-
-void Shader::setVec3(const std::string &name, const glm::vec3 &value) const {
-    glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
-}
-
-void Shader::setFloat(const std::string &name, float value) const {
-    glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
-}
-
-void Shader::setInt(const std::string &name, int value) const {
-    glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
-}
-
-void Shader::setBool(const std::string &name, bool value) const {
-    glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
-}
-
-void Shader::checkCompileErrors(unsigned int shader, std::string type) {
-    int success;
-    char infoLog[1024];
-    if (type != "PROGRAM") {
-        glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
-        if (!success) {
-            glGetShaderInfoLog(shader, 1024, NULL, infoLog);
-            std::cout << "ERROR::SHADER_COMPILATION_ERROR of type: " << type << "\n" << infoLog << std::endl;
-        }
-    }
-    else {
-        glGetProgramiv(shader, GL_LINK_STATUS, &success);
-        if (!success) {
-            glGetProgramInfoLog(shader, 1024, NULL, infoLog);
-            std::cout << "ERROR::PROGRAM_LINKING_ERROR of type: " << type << "\n" << infoLog << std::endl;
-        }
-    }
-}
+#include "shader.h"
+#include "gl_state.h"
+#include "program_cache.h"
+#include "uniform_blocks.h"
+
+#include <vector>
+
+Shader::Shader(const char* vertexPath, const char* fragmentPath) {
+    std::string vertexCode, fragmentCode;
+    std::ifstream vShaderFile, fShaderFile;
+    
+    vShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+    fShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+    
+    try {
+        vShaderFile.open(vertexPath);
+        fShaderFile.open(fragmentPath);
+        std::stringstream vShaderStream, fShaderStream;
+        
+        vShaderStream << vShaderFile.rdbuf();
+        fShaderStream << fShaderFile.rdbuf();
+        
+        vShaderFile.close();
+        fShaderFile.close();
+        
+        vertexCode = vShaderStream.str();
+        fragmentCode = fShaderStream.str();
+    }
+    catch (std::ifstream::failure& e) {
+        std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ" << std::endl;
+    }
+    
+    build(vertexCode.c_str(), fragmentCode.c_str());
+}
+
+Shader::Shader() : ID(0) {}
+
+Shader Shader::fromSource(const char* vertexSource, const char* fragmentSource) {
+    Shader shader;
+    shader.build(vertexSource, fragmentSource);
+    return shader;
+}
+
+Shader Shader::fromTransformFeedback(const char* vertexSource, const char* const* varyings, unsigned int varyingCount) {
+    Shader shader;
+    shader.build(vertexSource, nullptr, varyings, varyingCount);
+    return shader;
+}
+
+// Restores the program from the binary cache when it can, and otherwise
+// compiles it and adds it to the cache. Varyings have to be declared before
+// linking, so they are part of the key; a cached binary keeps them.
+void Shader::build(const char* vShaderCode, const char* fShaderCode, const char* const* varyings, unsigned int varyingCount) {
+    ProgramCache& cache = ProgramCache::Get();
+    std::vector<const char*> sources(1, vShaderCode);
+    if (fShaderCode) sources.push_back(fShaderCode);
+    sources.insert(sources.end(), varyings, varyings + varyingCount);
+    uint64_t key = cache.MakeKey(sources.data(), (unsigned int)sources.size());
+    
+    ID = glCreateProgram();
+    if (!cache.Load(ID, key)) {
+        unsigned int vertex, fragment = 0;
+        
+        vertex = glCreateShader(GL_VERTEX_SHADER);
+        glShaderSource(vertex, 1, &vShaderCode, NULL);
+        glCompileShader(vertex);
+        checkCompileErrors(vertex, "VERTEX");
+        glAttachShader(ID, vertex);
+        
+        if (fShaderCode) {
+            fragment = glCreateShader(GL_FRAGMENT_SHADER);
+            glShaderSource(fragment, 1, &fShaderCode, NULL);
+            glCompileShader(fragment);
+            checkCompileErrors(fragment, "FRAGMENT");
+            glAttachShader(ID, fragment);
+        }
+        
+        if (varyingCount > 0) {
+            glTransformFeedbackVaryings(ID, varyingCount, varyings, GL_INTERLEAVED_ATTRIBS);
+        }
+        cache.PrepareLink(ID);
+        glLinkProgram(ID);
+        checkCompileErrors(ID, "PROGRAM");
+        
+        glDeleteShader(vertex);
+        if (fragment) glDeleteShader(fragment);
+        cache.Store(ID, key);
+    }
+    // Block bindings and uniform values are not part of a binary
+    UniformBlocks::BindProgram(ID);
+    reflectUniforms();
+}
+
+// The only place locations are queried. Arrays are reported as "name[0]";
+// they are cached under the plain name too so either spelling resolves.
+void Shader::reflectUniforms() {
+    uniformLocations.clear();
+    int count = 0;
+    glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+    
+    char name[256];
+    for (int i = 0; i < count; i++) {
+        GLsizei length = 0;
+        GLint size = 0;
+        GLenum type = 0;
+        glGetActiveUniform(ID, (GLuint)i, sizeof(name), &length, &size, &type, name);
+        std::string uniformName(name, length);
+        int location = glGetUniformLocation(ID, uniformName.c_str());
+        if (location < 0) continue;   // uniform block members have no location
+        
+        uniformLocations[uniformName] = location;
+        size_t bracket = uniformName.find("[0]");
+        if (bracket != std::string::npos && bracket + 3 == uniformName.size()) {
+            uniformLocations[uniformName.substr(0, bracket)] = location;
+        }
+    }
+}
+
+int Shader::getUniformLocation(const std::string &name) const {
+    auto found = uniformLocations.find(name);
+    return found != uniformLocations.end() ? found->second : -1;
+}
+
+void Shader::use() { 
+    GLStateCache::Get().UseProgram(ID);
+}
+
+void Shader::setMat4(const std::string &name, const glm::mat4 &mat) const {
+    GLStateCache::Get().SetUniform(getUniformLocation(name), mat);
+}
+
+void Shader::setVec3(const std::string &name, const glm::vec3 &value) const {
+    GLStateCache::Get().SetUniform(getUniformLocation(name), value);
+}
+
+void Shader::setFloat(const std::string &name, float value) const {
+    GLStateCache::Get().SetUniform(getUniformLocation(name), value);
+}
+
+void Shader::setInt(const std::string &name, int value) const {
+    GLStateCache::Get().SetUniform(getUniformLocation(name), value);
+}
+
+void Shader::setBool(const std::string &name, bool value) const {
+    GLStateCache::Get().SetUniform(getUniformLocation(name), (int)value);
+}
+
+void Shader::set(Uniform<glm::mat4> uniform, const glm::mat4 &value) const {
+    GLStateCache::Get().SetUniform(uniform.location, value);
+}
+
+void Shader::set(Uniform<glm::vec3> uniform, const glm::vec3 &value) const {
+    GLStateCache::Get().SetUniform(uniform.location, value);
+}
+
+void Shader::set(Uniform<float> uniform, float value) const {
+    GLStateCache::Get().SetUniform(uniform.location, value);
+}
+
+void Shader::set(Uniform<int> uniform, int value) const {
+    GLStateCache::Get().SetUniform(uniform.location, value);
+}
+
+void Shader::set(Uniform<bool> uniform, bool value) const {
+    GLStateCache::Get().SetUniform(uniform.location, (int)value);
+}
+
+void Shader::checkCompileErrors(unsigned int shader, std::string type) {
+    int success;
+    char infoLog[1024];
+    if (type != "PROGRAM") {
+        glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+        if (!success) {
+            glGetShaderInfoLog(shader, 1024, NULL, infoLog);
+            std::cout << "ERROR::SHADER_COMPILATION_ERROR of type: " << type << "\n" << infoLog << std::endl;
+        }
+    }
+    else {
+        glGetProgramiv(shader, GL_LINK_STATUS, &success);
+        if (!success) {
+            glGetProgramInfoLog(shader, 1024, NULL, infoLog);
+            std::cout << "ERROR::PROGRAM_LINKING_ERROR of type: " << type << "\n" << infoLog << std::endl;
+        }
+    }
+}
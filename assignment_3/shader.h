@@ -1,29 +1,70 @@
-#ifndef SHADER_H
-#define SHADER_H
-
-#include <glad/glad.h>
-#include <string>
-#include <fstream>
-#include <sstream>
-#include <iostream>
-#include <glm/glm.hpp>
-#include <glm/gtc/type_ptr.hpp>
-
-class Shader {
-public:
-    unsigned int ID;
-    
-    Shader(const char* vertexPath, const char* fragmentPath);
-    
-    void use();
-    void setMat4(const std::string &name, const glm::mat4 &mat) const;
-    void setVec3(const std::string &name, const glm::vec3 &value) const;
-    void setFloat(const std::string &name, float value) const;
-    void setInt(const std::string &name, int value) const;
-    void setBool(const std::string &name, bool value) const;
-    
-private:
-    void checkCompileErrors(unsigned int shader, std::string type);
-};
-
-#endif
+#ifndef SHADER_H
+#define SHADER_H
+
+#include <glad/glad.h>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <unordered_map>
+
+// Uniform location resolved once from a Shader; setting a value through a
+// handle makes no location query. The type parameter picks the glUniform
+// call, so a handle can only be set with the type it was declared with.
+template <typename T>
+struct Uniform {
+    int location = -1;
+    bool isValid() const { return location >= 0; }
+};
+
+// Active uniforms are enumerated once after linking and kept in a hashed
+// name cache, so neither the name-based setters nor getUniform() call
+// glGetUniformLocation. Names of inactive or misspelled uniforms resolve to
+// -1, which glUniform* ignores, as before.
+//
+// Programs are restored from ProgramCache when it holds a binary of the
+// same sources and added to it otherwise. After linking, the program's
+// uniform blocks are assigned to the shared binding points of UniformBlocks.
+class Shader {
+public:
+    unsigned int ID;
+    
+    Shader(const char* vertexPath, const char* fragmentPath);
+    // Builds a program from source strings instead of files
+    static Shader fromSource(const char* vertexSource, const char* fragmentSource);
+    // Vertex stage only, its varyings captured interleaved by transform feedback
+    static Shader fromTransformFeedback(const char* vertexSource, const char* const* varyings, unsigned int varyingCount);
+    
+    void use();
+    void setMat4(const std::string &name, const glm::mat4 &mat) const;
+    void setVec3(const std::string &name, const glm::vec3 &value) const;
+    void setFloat(const std::string &name, float value) const;
+    void setInt(const std::string &name, int value) const;
+    void setBool(const std::string &name, bool value) const;
+    
+    int getUniformLocation(const std::string &name) const;
+    template <typename T>
+    Uniform<T> getUniform(const std::string &name) const {
+        Uniform<T> uniform;
+        uniform.location = getUniformLocation(name);
+        return uniform;
+    }
+    void set(Uniform<glm::mat4> uniform, const glm::mat4 &value) const;
+    void set(Uniform<glm::vec3> uniform, const glm::vec3 &value) const;
+    void set(Uniform<float> uniform, float value) const;
+    void set(Uniform<int> uniform, int value) const;
+    void set(Uniform<bool> uniform, bool value) const;
+    
+private:
+    std::unordered_map<std::string, int> uniformLocations;
+    
+    Shader();
+    void build(const char* vertexCode, const char* fragmentCode,
+               const char* const* varyings = nullptr, unsigned int varyingCount = 0);
+    void reflectUniforms();
+    void checkCompileErrors(unsigned int shader, std::string type);
+};
+
+#endif
@@ -0,0 +1,106 @@
+#include "shader_variants.h"
+#include "uniform_blocks.h"
+
+// Key layout: features:5 | bone influences:3 | light count:4
+static const unsigned int FEATURE_MASK = 0x1F;
+static const unsigned int INFLUENCE_SHIFT = 5;
+static const unsigned int INFLUENCE_MASK = 0x7;
+static const unsigned int LIGHT_SHIFT = 8;
+static const unsigned int LIGHT_MASK = 0xF;
+
+static_assert(MAX_BONE_INFLUENCE <= INFLUENCE_MASK, "bone influences do not fit in a variant key");
+static_assert(MAX_LIGHTS <= LIGHT_MASK, "light count does not fit in a variant key");
+
+// Vertex stage helpers for PackInstanceTransform()
+static const char* INSTANCE_FUNCTIONS = R"(
+#ifdef INSTANCED
+mat4 instanceModel(mat4 packed) {
+    return mat4(vec4(packed[0].xyz, 0.0), vec4(packed[1].xyz, 0.0), vec4(packed[2].xyz, 0.0), packed[3]);
+}
+
+mat3 instanceNormalMatrix(mat4 packed) {
+    return mat3(packed[0].xyz * packed[0].w, packed[1].xyz * packed[1].w, packed[2].xyz * packed[2].w);
+}
+#endif
+)";
+
+ShaderVariants::ShaderVariants(const char* vertex, const char* fragment)
+: vertexSource(vertex), fragmentSource(fragment) {}
+
+ShaderVariants::ShaderVariants(const char* vertex, const std::vector<std::string>& outputs)
+: vertexSource(vertex), varyings(outputs) {}
+
+unsigned int ShaderVariants::MakeKey(unsigned int features, unsigned int boneInfluences, unsigned int lightCount) {
+    if (lightCount > MAX_LIGHTS) lightCount = MAX_LIGHTS;
+    return (features & FEATURE_MASK) | (boneInfluences & INFLUENCE_MASK) << INFLUENCE_SHIFT |
+           (lightCount & LIGHT_MASK) << LIGHT_SHIFT;
+}
+
+unsigned int ShaderVariants::ForMesh(unsigned int key, const Mesh& mesh) {
+    unsigned int features = key & FEATURE_MASK;
+    unsigned int influences = 0;
+    if (!mesh.textures.empty()) features |= SHADER_TEXTURED;
+    if ((features & SHADER_SKINNED) && mesh.boneInfluences > 0) {
+        influences = mesh.boneInfluences;
+    } else {
+        features &= ~(SHADER_SKINNED | SHADER_DUAL_QUATERNION);
+    }
+    if (mesh.morphTargets.empty()) features &= ~SHADER_MORPHED;
+    return MakeKey(features, influences, key >> LIGHT_SHIFT & LIGHT_MASK);
+}
+
+// Without shear the normal matrix, the inverse transpose of the upper 3x3,
+// is that 3x3 with each column divided by its squared length. The bottom
+// row of an affine transform is always (0, 0, 0, 1), so the reciprocal
+// squared lengths fit there and the vertex shader rebuilds both matrices
+// with a multiply per column instead of an inverse per vertex.
+glm::mat4 ShaderVariants::PackInstanceTransform(const glm::mat4& transform) {
+    glm::mat4 packed = transform;
+    for (int column = 0; column < 3; column++) {
+        glm::vec3 axis(transform[column]);
+        float lengthSquared = glm::dot(axis, axis);
+        packed[column].w = lengthSquared > 0.0f ? 1.0f / lengthSquared : 0.0f;
+    }
+    return packed;
+}
+
+Shader& ShaderVariants::Get(unsigned int key) {
+    auto found = variants.find(key);
+    if (found != variants.end()) return found->second;
+
+    std::string defines = GetDefines(key);
+    std::string vertexCode = UniformBlocks::AddDeclarations(vertexSource.c_str(), defines + INSTANCE_FUNCTIONS);
+    std::vector<const char*> names;
+    for (const auto& varying : varyings) names.push_back(varying.c_str());
+    Shader program = varyings.empty()
+        ? Shader::fromSource(vertexCode.c_str(), UniformBlocks::AddDeclarations(fragmentSource.c_str(), defines).c_str())
+        : Shader::fromTransformFeedback(vertexCode.c_str(), names.data(), (unsigned int)names.size());
+    Shader& shader = variants.insert(std::make_pair(key, program)).first->second;
+    shader.use();
+    for (const auto& sampler : samplers) shader.setInt(sampler.first, sampler.second);
+    return shader;
+}
+
+void ShaderVariants::SetSampler(const std::string& name, int unit) {
+    samplers.push_back(std::make_pair(name, unit));
+    for (auto& variant : variants) {
+        variant.second.use();
+        variant.second.setInt(name, unit);
+    }
+}
+
+unsigned int ShaderVariants::GetVariantCount() const {
+    return (unsigned int)variants.size();
+}
+
+std::string ShaderVariants::GetDefines(unsigned int key) {
+    std::string defines;
+    if (key & SHADER_SKINNED) defines += "#define SKINNED\n";
+    if (key & SHADER_DUAL_QUATERNION) defines += "#define DUAL_QUATERNION\n";
+    if (key & SHADER_TEXTURED) defines += "#define TEXTURED\n";
+    if (key & SHADER_INSTANCED) defines += "#define INSTANCED\n";
+    if (key & SHADER_MORPHED) defines += "#define MORPHED\n";
+    defines += "#define BONE_INFLUENCES " + std::to_string(key >> INFLUENCE_SHIFT & INFLUENCE_MASK) + "\n";
+    defines += "#define LIGHT_COUNT " + std::to_string(key >> LIGHT_SHIFT & LIGHT_MASK) + "\n";
+    return defines;
+}
@@ -0,0 +1,65 @@
+#ifndef SHADER_VARIANTS_H
+#define SHADER_VARIANTS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "mesh.h"
+#include "shader.h"
+
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Feature bits of a variant key; each is compiled in as the #define in the comment
+#define SHADER_SKINNED (1u << 0)           // SKINNED: bone palette skinning
+#define SHADER_DUAL_QUATERNION (1u << 1)   // DUAL_QUATERNION: with SKINNED, instead of linear blend
+#define SHADER_TEXTURED (1u << 2)          // TEXTURED: base color from texture_diffuse
+#define SHADER_INSTANCED (1u << 3)         // INSTANCED: transform and color from instance attributes
+#define SHADER_MORPHED (1u << 4)           // MORPHED: blend shape offsets at locations 5 and 6
+
+// Specialized programs built from one pair of sources. A variant key packs
+// the feature bits with the bone influences per vertex (BONE_INFLUENCES)
+// and the number of lights (LIGHT_COUNT); they are inserted as #defines
+// after #version along with the uniform block declarations, so a variant
+// never branches on a uniform and its loops have constant trip counts.
+// Variants are compiled the first time they are asked for and live as long
+// as the set. A set made with varyings instead of a fragment source builds
+// vertex-only programs whose outputs are captured by transform feedback.
+//
+// Non-instanced variants read the normal matrix from the Object block
+// (ObjectBlock::SetModel); instanced ones from the instance transform, see
+// PackInstanceTransform().
+class ShaderVariants {
+public:
+    ShaderVariants(const char* vertexSource, const char* fragmentSource);
+    ShaderVariants(const char* vertexSource, const std::vector<std::string>& varyings);
+
+    static unsigned int MakeKey(unsigned int features, unsigned int boneInfluences = 0, unsigned int lightCount = 0);
+    // The key for drawing mesh: TEXTURED if it has textures, and with
+    // SKINNED requested, the mesh's bone influences, or no skinning at all
+    // for a mesh without bones; MORPHED only for a mesh with morph targets
+    static unsigned int ForMesh(unsigned int key, const Mesh& mesh);
+    // Stores the normal matrix in the transform's bottom row; the transform
+    // must be translation, rotation and scale only
+    static glm::mat4 PackInstanceTransform(const glm::mat4& transform);
+
+    // Program for key, compiled on first use
+    Shader& Get(unsigned int key);
+    // Texture unit of a sampler in every variant, current and future
+    void SetSampler(const std::string& name, int unit);
+
+    unsigned int GetVariantCount() const;
+
+private:
+    std::string vertexSource;
+    std::string fragmentSource;
+    std::vector<std::string> varyings;   // transform feedback outputs, without a fragment stage
+    std::unordered_map<unsigned int, Shader> variants;
+    std::vector<std::pair<std::string, int>> samplers;
+
+    static std::string GetDefines(unsigned int key);
+};
+
+#endif
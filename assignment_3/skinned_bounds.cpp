@@ -0,0 +1,145 @@
+#include "skinned_bounds.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SKINNED_BOUNDS_X86
+#include <emmintrin.h>
+#endif
+
+bool BoundingVolume::IsEmpty() const {
+    return min.x > max.x || min.y > max.y || min.z > max.z;
+}
+
+BoundingVolume BoundingVolume::Transform(const glm::mat4& transform) const {
+    if (IsEmpty()) return *this;
+
+    glm::vec3 boxCenter = (min + max) * 0.5f;
+    glm::vec3 boxExtent = (max - min) * 0.5f;
+    glm::mat3 absolute(glm::abs(glm::vec3(transform[0])), glm::abs(glm::vec3(transform[1])), glm::abs(glm::vec3(transform[2])));
+    glm::vec3 newCenter = glm::vec3(transform * glm::vec4(boxCenter, 1.0f));
+    glm::vec3 newExtent = absolute * boxExtent;
+
+    float scale = std::max(glm::length(glm::vec3(transform[0])),
+                           std::max(glm::length(glm::vec3(transform[1])), glm::length(glm::vec3(transform[2]))));
+    BoundingVolume result;
+    result.min = newCenter - newExtent;
+    result.max = newCenter + newExtent;
+    result.center = glm::vec3(transform * glm::vec4(center, 1.0f));
+    result.radius = radius * scale;
+    return result;
+}
+
+bool BoundingVolume::IntersectsSphere(const glm::vec3& sphereCenter, float sphereRadius) const {
+    if (IsEmpty()) return false;
+    glm::vec3 closest = glm::clamp(sphereCenter, min, max);
+    glm::vec3 offset = sphereCenter - closest;
+    return glm::dot(offset, offset) < sphereRadius * sphereRadius;
+}
+
+void SkinnedBounds::Build(const std::vector<Mesh>& meshes) {
+    std::vector<glm::vec3> boneMin, boneMax;
+    glm::vec3 staticMin(FLT_MAX), staticMax(-FLT_MAX);
+    boxes.clear();
+    boxBones.clear();
+    hasUnskinned = false;
+
+    for (const auto& mesh : meshes) {
+        for (const auto& vertex : mesh.vertices) {
+            bool skinned = false;
+            for (int i = 0; i < MAX_BONE_INFLUENCE; i++) {
+                int id = vertex.BoneIDs[i];
+                if (id < 0 || id >= (int)mesh.bones.size() || vertex.Weights[i] <= 0.0f) continue;
+                unsigned int bone = mesh.bones[id];
+                if (bone >= boneMin.size()) {
+                    boneMin.resize(bone + 1, glm::vec3(FLT_MAX));
+                    boneMax.resize(bone + 1, glm::vec3(-FLT_MAX));
+                }
+                boneMin[bone] = glm::min(boneMin[bone], vertex.Position);
+                boneMax[bone] = glm::max(boneMax[bone], vertex.Position);
+                skinned = true;
+            }
+            if (!skinned) {
+                staticMin = glm::min(staticMin, vertex.Position);
+                staticMax = glm::max(staticMax, vertex.Position);
+                hasUnskinned = true;
+            }
+        }
+    }
+
+    for (unsigned int bone = 0; bone < boneMin.size(); bone++) {
+        if (boneMin[bone].x > boneMax[bone].x) continue;
+        Box box;
+        box.center = glm::vec4((boneMin[bone] + boneMax[bone]) * 0.5f, 1.0f);
+        box.extent = glm::vec4((boneMax[bone] - boneMin[bone]) * 0.5f, 0.0f);
+        boxes.push_back(box);
+        boxBones.push_back(bone);
+    }
+    if (hasUnskinned) {
+        unskinned.center = glm::vec4((staticMin + staticMax) * 0.5f, 1.0f);
+        unskinned.extent = glm::vec4((staticMax - staticMin) * 0.5f, 0.0f);
+    }
+}
+
+BoundingVolume SkinnedBounds::Compute(const glm::mat4* palette, unsigned int boneCount) const {
+    float lower[4] = { FLT_MAX, FLT_MAX, FLT_MAX, FLT_MAX };
+    float upper[4] = { -FLT_MAX, -FLT_MAX, -FLT_MAX, -FLT_MAX };
+    if (hasUnskinned) {
+        for (int c = 0; c < 3; c++) {
+            lower[c] = unskinned.center[c] - unskinned.extent[c];
+            upper[c] = unskinned.center[c] + unskinned.extent[c];
+        }
+    }
+
+#ifdef SKINNED_BOUNDS_X86
+    __m128 minimum = _mm_loadu_ps(lower);
+    __m128 maximum = _mm_loadu_ps(upper);
+    const __m128 signMask = _mm_set1_ps(-0.0f);
+    for (size_t i = 0; i < boxes.size(); i++) {
+        if (boxBones[i] >= boneCount) continue;
+        const float* bone = &palette[boxBones[i]][0][0];
+        const Box& box = boxes[i];
+        __m128 c0 = _mm_loadu_ps(bone);
+        __m128 c1 = _mm_loadu_ps(bone + 4);
+        __m128 c2 = _mm_loadu_ps(bone + 8);
+        __m128 c3 = _mm_loadu_ps(bone + 12);
+
+        __m128 center = _mm_add_ps(_mm_add_ps(_mm_mul_ps(c0, _mm_set1_ps(box.center.x)), _mm_mul_ps(c1, _mm_set1_ps(box.center.y))),
+                                   _mm_add_ps(_mm_mul_ps(c2, _mm_set1_ps(box.center.z)), c3));
+        __m128 extent = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_andnot_ps(signMask, c0), _mm_set1_ps(box.extent.x)),
+                                              _mm_mul_ps(_mm_andnot_ps(signMask, c1), _mm_set1_ps(box.extent.y))),
+                                   _mm_mul_ps(_mm_andnot_ps(signMask, c2), _mm_set1_ps(box.extent.z)));
+        minimum = _mm_min_ps(minimum, _mm_sub_ps(center, extent));
+        maximum = _mm_max_ps(maximum, _mm_add_ps(center, extent));
+    }
+    _mm_storeu_ps(lower, minimum);
+    _mm_storeu_ps(upper, maximum);
+#else
+    for (size_t i = 0; i < boxes.size(); i++) {
+        if (boxBones[i] >= boneCount) continue;
+        const glm::mat4& bone = palette[boxBones[i]];
+        const Box& box = boxes[i];
+        glm::vec4 center = bone * box.center;
+        glm::mat3 absolute(glm::abs(glm::vec3(bone[0])), glm::abs(glm::vec3(bone[1])), glm::abs(glm::vec3(bone[2])));
+        glm::vec3 extent = absolute * glm::vec3(box.extent);
+        for (int c = 0; c < 3; c++) {
+            lower[c] = std::min(lower[c], center[c] - extent[c]);
+            upper[c] = std::max(upper[c], center[c] + extent[c]);
+        }
+    }
+#endif
+
+    BoundingVolume volume;
+    if (lower[0] > upper[0]) return volume;
+    volume.min = glm::vec3(lower[0], lower[1], lower[2]);
+    volume.max = glm::vec3(upper[0], upper[1], upper[2]);
+    volume.center = (volume.min + volume.max) * 0.5f;
+    volume.radius = glm::length(volume.max - volume.min) * 0.5f;
+    return volume;
+}
+
+bool SkinnedBounds::IsEmpty() const {
+    return boxes.empty() && !hasUnskinned;
+}
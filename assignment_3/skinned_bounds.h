@@ -0,0 +1,48 @@
+#ifndef SKINNED_BOUNDS_H
+#define SKINNED_BOUNDS_H
+
+#include <glm/glm.hpp>
+
+#include "mesh.h"
+
+#include <vector>
+
+// Axis-aligned box with the sphere around it. Empty until min <= max.
+struct BoundingVolume {
+    glm::vec3 min = glm::vec3(1.0f);
+    glm::vec3 max = glm::vec3(-1.0f);
+    glm::vec3 center = glm::vec3(0.0f);
+    float radius = 0.0f;
+
+    bool IsEmpty() const;
+    BoundingVolume Transform(const glm::mat4& transform) const;
+    // Sphere against box; an empty volume intersects nothing
+    bool IntersectsSphere(const glm::vec3& sphereCenter, float sphereRadius) const;
+};
+
+// Bounds of a skinned model in its current pose, without skinning vertices.
+// At import every bone gets the bind-pose box of the vertices it influences.
+// A blended vertex is a weighted average of its bones' transforms of the
+// bind position, so it lies inside the union of each bone's box moved by its
+// palette matrix, and the model-space box is the union of those moved boxes.
+// Compute() moves all boxes with SSE (centre by the matrix, half extent by
+// its absolute value) and reduces them with min/max.
+class SkinnedBounds {
+public:
+    void Build(const std::vector<Mesh>& meshes);
+    BoundingVolume Compute(const glm::mat4* palette, unsigned int boneCount) const;
+    bool IsEmpty() const;
+
+private:
+    struct Box {
+        glm::vec4 center;
+        glm::vec4 extent;   // half size, w = 0
+    };
+
+    std::vector<Box> boxes;
+    std::vector<unsigned int> boxBones;   // model bone that moves each box
+    bool hasUnskinned = false;            // vertices without influences
+    Box unskinned;
+};
+
+#endif
@@ -0,0 +1,203 @@
+#include "stream_buffer.h"
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#endif
+#ifndef GL_MAP_COHERENT_BIT
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+
+typedef void (APIENTRYP PFNGLBUFFERSTORAGEPROC)(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags);
+static PFNGLBUFFERSTORAGEPROC bufferStorage = nullptr;
+
+// Waits are done in slices of this many nanoseconds
+static const GLuint64 WAIT_SLICE = 1000000;
+
+static unsigned int AlignUp(unsigned int value, unsigned int alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+bool StreamBuffer::LoadBufferStorage(GLADloadproc load) {
+    bufferStorage = nullptr;
+    if (GLVersion.major > 4 || (GLVersion.major == 4 && GLVersion.minor >= 4)) {
+        bufferStorage = (PFNGLBUFFERSTORAGEPROC)load("glBufferStorage");
+    }
+    return bufferStorage != nullptr;
+}
+
+bool StreamBuffer::IsPersistentAvailable() {
+    return bufferStorage != nullptr;
+}
+
+StreamBuffer::StreamBuffer(unsigned int size) : regionSize(size) {
+    for (unsigned int i = 0; i < REGION_COUNT; i++) fences[i] = nullptr;
+    Allocate();
+}
+
+StreamBuffer::~StreamBuffer() {
+    Release();
+}
+
+// The copy target leaves the array, uniform and texture bindings alone
+void StreamBuffer::Allocate() {
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+    if (bufferStorage) {
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        bufferStorage(GL_COPY_WRITE_BUFFER, GetSize(), NULL, flags);
+        mapped = (unsigned char*)glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, GetSize(), flags);
+        if (!mapped) {
+            std::cout << "ERROR::STREAM_BUFFER::MAP_FAILED" << std::endl;
+        }
+    } else {
+        glBufferData(GL_COPY_WRITE_BUFFER, GetSize(), NULL, GL_STREAM_DRAW);
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+void StreamBuffer::Release() {
+    for (unsigned int i = 0; i < REGION_COUNT; i++) {
+        if (fences[i]) glDeleteSync(fences[i]);
+        fences[i] = nullptr;
+    }
+    if (mapped) {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+        glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        mapped = nullptr;
+    }
+    glDeleteBuffers(1, &buffer);
+    buffer = 0;
+}
+
+// GL keeps a deleted buffer alive until the commands reading it are done,
+// so the old storage needs no fence
+void StreamBuffer::Reserve(unsigned int size) {
+    if (size <= regionSize) return;
+    if (head > 0) {
+        std::cout << "ERROR::STREAM_BUFFER::RESERVE_AFTER_WRITE" << std::endl;
+        return;
+    }
+    unsigned int grown = regionSize;
+    while (grown < size && grown <= ~0u / (2 * REGION_COUNT)) grown *= 2;
+    if (grown < size) {
+        std::cout << "ERROR::STREAM_BUFFER::RESERVE_TOO_LARGE: " << size << std::endl;
+        return;
+    }
+    Release();
+    regionSize = grown;
+    region = 0;
+    reportedFull = false;
+    Allocate();
+}
+
+void StreamBuffer::BeginFrame() {
+    if (fences[region]) glDeleteSync(fences[region]);
+    fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    region = (region + 1) % REGION_COUNT;
+    head = 0;
+
+    total.bytes += current.bytes;
+    total.fenceWaits += current.fenceWaits;
+    total.waitMilliseconds += current.waitMilliseconds;
+    total.orphans += current.orphans;
+    lastFrame = current;
+    current = StreamBufferStats();
+    frames++;
+
+    WaitForRegion();
+}
+
+// Makes the current region safe to overwrite
+void StreamBuffer::WaitForRegion() {
+    GLsync fence = fences[region];
+    if (!fence) return;
+
+    if (glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED) {
+        current.fenceWaits++;
+        if (!mapped) {
+            Orphan();
+            return;
+        }
+        auto start = std::chrono::high_resolution_clock::now();
+        while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, WAIT_SLICE) == GL_TIMEOUT_EXPIRED) {}
+        current.waitMilliseconds += std::chrono::duration<double, std::milli>(
+            std::chrono::high_resolution_clock::now() - start).count();
+    }
+    glDeleteSync(fence);
+    fences[region] = nullptr;
+}
+
+// Fresh storage has no readers, so every fence is dropped with the old one
+void StreamBuffer::Orphan() {
+    glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, GetSize(), NULL, GL_STREAM_DRAW);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    for (unsigned int i = 0; i < REGION_COUNT; i++) {
+        if (fences[i]) glDeleteSync(fences[i]);
+        fences[i] = nullptr;
+    }
+    current.orphans++;
+}
+
+unsigned int StreamBuffer::GetWriteOffset(unsigned int alignment) const {
+    return region * regionSize + AlignUp(head, alignment);
+}
+
+unsigned int StreamBuffer::Write(const void* data, unsigned int size, unsigned int alignment) {
+    unsigned int start = AlignUp(head, alignment);
+    if (start + size > regionSize) {
+        if (!reportedFull) {
+            std::cout << "ERROR::STREAM_BUFFER::REGION_FULL: " << size << " bytes do not fit in "
+                      << regionSize - head << " free of " << regionSize << std::endl;
+            reportedFull = true;
+        }
+        return INVALID_OFFSET;
+    }
+
+    unsigned int offset = region * regionSize + start;
+    if (mapped) {
+        std::memcpy(mapped + offset, data, size);
+    } else if (size > 0) {
+        // Fences and orphaning already keep the GPU off this range
+        glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+        void* target = glMapBufferRange(GL_COPY_WRITE_BUFFER, offset, size,
+                                        GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+        if (target) {
+            std::memcpy(target, data, size);
+            glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+        }
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    }
+    head = start + size;
+    current.bytes += size;
+    return offset;
+}
+
+unsigned int StreamBuffer::GetBuffer() const {
+    return buffer;
+}
+
+unsigned int StreamBuffer::GetSize() const {
+    return regionSize * REGION_COUNT;
+}
+
+bool StreamBuffer::IsPersistent() const {
+    return mapped != nullptr;
+}
+
+const StreamBufferStats& StreamBuffer::GetFrameStats() const {
+    return lastFrame;
+}
+
+const StreamBufferStats& StreamBuffer::GetTotalStats() const {
+    return total;
+}
+
+unsigned int StreamBuffer::GetFrameCount() const {
+    return frames;
+}
@@ -0,0 +1,83 @@
+#ifndef STREAM_BUFFER_H
+#define STREAM_BUFFER_H
+
+#include <glad/glad.h>
+
+struct StreamBufferStats {
+    unsigned long long bytes = 0;    // written by Write()
+    unsigned int fenceWaits = 0;     // frames whose region the GPU was still reading
+    double waitMilliseconds = 0.0;   // blocked on those fences
+    unsigned int orphans = 0;        // GL 3.3: storage replaced instead of waiting
+};
+
+// A buffer for data that is rewritten every frame: uniform blocks, the
+// instance attributes of a RenderQueue, or the bone palettes of a
+// BonePaletteBuffer. It is
+// split into REGION_COUNT regions used round robin, one per frame; within a
+// frame, Write() bump-allocates from the current region, and each region is
+// fenced when the frame moves on, so the CPU only writes memory the GPU has
+// finished reading.
+//
+// With glBufferStorage from GL 4.4 the buffer is mapped once, persistent
+// and coherent, and Write() is a plain copy; BeginFrame() waits on the
+// fence of the region it reuses. glad's 3.3 loader does not cover
+// glBufferStorage, so LoadBufferStorage() fetches it when the context is new
+// enough. On 3.3 each Write() maps its range unsynchronized, and when the
+// next region is still in use the whole buffer is orphaned rather than
+// waited for: the driver hands out fresh storage and retires the old one
+// once the GPU is done with it.
+//
+// Offsets are from the start of the buffer, so they can be bound directly
+// with glBindBufferRange, used as attribute offsets, or, divided by the
+// texel size, indexed from a texture buffer over the whole buffer.
+class StreamBuffer {
+public:
+    static const unsigned int REGION_COUNT = 3;
+    static const unsigned int INVALID_OFFSET = ~0u;
+
+    static bool LoadBufferStorage(GLADloadproc load);
+    static bool IsPersistentAvailable();
+
+    explicit StreamBuffer(unsigned int regionSize);
+    ~StreamBuffer();
+
+    // Fences the current region and moves to the next; call once per frame
+    // before writing
+    void BeginFrame();
+    // Offset the next Write() with this alignment will return
+    unsigned int GetWriteOffset(unsigned int alignment) const;
+    // Copies data into the current region; INVALID_OFFSET if it is full
+    unsigned int Write(const void* data, unsigned int size, unsigned int alignment);
+    // Grows every region to at least size bytes, doubling, on fresh storage.
+    // Only before the frame's first Write(), since earlier offsets are lost.
+    void Reserve(unsigned int size);
+
+    unsigned int GetBuffer() const;
+    unsigned int GetSize() const;
+    bool IsPersistent() const;
+
+    const StreamBufferStats& GetFrameStats() const;   // last finished frame
+    const StreamBufferStats& GetTotalStats() const;
+    unsigned int GetFrameCount() const;
+
+private:
+    unsigned int buffer = 0;
+    unsigned int regionSize;
+    unsigned int region = 0;
+    unsigned int head = 0;                   // next free byte of the current region
+    unsigned char* mapped = nullptr;         // persistent mapping, null on 3.3
+    GLsync fences[REGION_COUNT];
+    bool reportedFull = false;
+
+    StreamBufferStats current;
+    StreamBufferStats lastFrame;
+    StreamBufferStats total;
+    unsigned int frames = 0;
+
+    void Allocate();
+    void Release();
+    void WaitForRegion();
+    void Orphan();
+};
+
+#endif
@@ -0,0 +1,140 @@
+#include "uniform_blocks.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+// GLSL side of the blocks in uniform_blocks.h; members are visible to the
+// shader by their plain names
+static const char* BLOCK_DECLARATIONS = R"(
+layout (std140) uniform Frame {
+    float time;
+    float deltaTime;
+};
+
+layout (std140) uniform Camera {
+    mat4 projection;
+    mat4 view;
+    mat4 viewProjection;
+    vec4 cameraPosition;
+};
+
+layout (std140) uniform Lights {
+    vec4 lightPositions[MAX_LIGHTS];
+    vec4 lightColors[MAX_LIGHTS];
+    int lightCount;
+};
+
+layout (std140) uniform Object {
+    mat4 model;
+    mat4 normalMatrix;
+    vec4 objectColor;   // rgb surface color, a opacity
+};
+)";
+
+static const char* BLOCK_NAMES[UNIFORM_BLOCK_COUNT] = { "Frame", "Camera", "Lights", "Object" };
+static const size_t BLOCK_SIZES[UNIFORM_BLOCK_COUNT] = {
+    sizeof(FrameBlock), sizeof(CameraBlock), sizeof(LightBlock), sizeof(ObjectBlock)
+};
+
+UniformBlocks::UniformBlocks(StreamBuffer& streamBuffer) : stream(streamBuffer) {
+    GLint offsetAlignment = 0;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &offsetAlignment);
+    if (offsetAlignment > 0) alignment = (unsigned int)offsetAlignment;
+
+    size_t largest = 0;
+    for (unsigned int i = 0; i < UNIFORM_BLOCK_COUNT; i++) largest = std::max(largest, BLOCK_SIZES[i]);
+    overflowSlotSize = ((unsigned int)largest + alignment - 1) / alignment * alignment;
+    glGenBuffers(1, &overflowBuffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, overflowBuffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, overflowSlotSize * UNIFORM_BLOCK_COUNT, NULL, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+UniformBlocks::~UniformBlocks() {
+    glDeleteBuffers(1, &overflowBuffer);
+}
+
+void ObjectBlock::SetModel(const glm::mat4& transform) {
+    model = transform;
+    normalMatrix = glm::mat4(glm::transpose(glm::inverse(glm::mat3(transform))));
+}
+
+std::string UniformBlocks::AddDeclarations(const char* source, const std::string& defines) {
+    std::string code(source);
+    std::string declarations = defines + "#define MAX_LIGHTS " + std::to_string(MAX_LIGHTS) + "\n" + BLOCK_DECLARATIONS;
+    size_t version = code.find("#version");
+    size_t lineEnd = version == std::string::npos ? std::string::npos : code.find('\n', version);
+    if (lineEnd == std::string::npos) return declarations + code;
+    return code.insert(lineEnd + 1, declarations);
+}
+
+void UniformBlocks::BindProgram(unsigned int program) {
+    for (unsigned int i = 0; i < UNIFORM_BLOCK_COUNT; i++) {
+        unsigned int index = glGetUniformBlockIndex(program, BLOCK_NAMES[i]);
+        if (index == GL_INVALID_INDEX) continue;   // not used by this program
+        glUniformBlockBinding(program, index, i);
+
+        // The compile-time checks cover the C++ side; this catches a GLSL
+        // declaration that drifted from it
+        GLint size = 0;
+        glGetActiveUniformBlockiv(program, index, GL_UNIFORM_BLOCK_DATA_SIZE, &size);
+        if ((size_t)size > BLOCK_SIZES[i]) {
+            std::cout << "ERROR::UNIFORM_BLOCK::SIZE_MISMATCH: " << BLOCK_NAMES[i] << " is " << size
+                      << " bytes in GLSL, " << BLOCK_SIZES[i] << " in C++" << std::endl;
+        }
+    }
+}
+
+void UniformBlocks::SetFrame(const FrameBlock& block) {
+    Upload(FRAME_BLOCK_BINDING, &block, sizeof(block));
+}
+
+void UniformBlocks::SetCamera(const CameraBlock& block) {
+    Upload(CAMERA_BLOCK_BINDING, &block, sizeof(block));
+}
+
+void UniformBlocks::SetLights(const LightBlock& block) {
+    Upload(LIGHT_BLOCK_BINDING, &block, sizeof(block));
+}
+
+void UniformBlocks::SetObject(const ObjectBlock& block) {
+    Upload(OBJECT_BLOCK_BINDING, &block, sizeof(block));
+}
+
+void UniformBlocks::BeginFrame() {
+    for (unsigned int i = 0; i < UNIFORM_BLOCK_COUNT; i++) {
+        if (uploaded[i].empty()) continue;
+        std::vector<unsigned char> contents;
+        contents.swap(uploaded[i]);
+        Upload(i, contents.data(), contents.size());
+    }
+}
+
+unsigned int UniformBlocks::GetUploadCount() const {
+    return uploads;
+}
+
+void UniformBlocks::Upload(unsigned int binding, const void* data, size_t size) {
+    std::vector<unsigned char>& last = uploaded[binding];
+    if (last.size() == size && std::memcmp(last.data(), data, size) == 0) return;
+
+    unsigned int offset = stream.Write(data, (unsigned int)size, alignment);
+    if (offset == StreamBuffer::INVALID_OFFSET) {
+        // The driver orders glBufferSubData against draws still reading the slot
+        if (!reportedOverflow) {
+            std::cout << "ERROR::UNIFORM_BLOCK::STREAM_FULL: " << BLOCK_NAMES[binding]
+                      << " uploaded with glBufferSubData instead" << std::endl;
+            reportedOverflow = true;
+        }
+        offset = binding * overflowSlotSize;
+        glBindBuffer(GL_COPY_WRITE_BUFFER, overflowBuffer);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, offset, size, data);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        glBindBufferRange(GL_UNIFORM_BUFFER, binding, overflowBuffer, offset, size);
+    } else {
+        glBindBufferRange(GL_UNIFORM_BUFFER, binding, stream.GetBuffer(), offset, size);
+    }
+    last.assign((const unsigned char*)data, (const unsigned char*)data + size);
+    uploads++;
+}
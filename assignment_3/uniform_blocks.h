@@ -0,0 +1,125 @@
+#ifndef UNIFORM_BLOCKS_H
+#define UNIFORM_BLOCKS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "stream_buffer.h"
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Binding points of the shared blocks, the same in every program
+#define FRAME_BLOCK_BINDING 0
+#define CAMERA_BLOCK_BINDING 1
+#define LIGHT_BLOCK_BINDING 2
+#define OBJECT_BLOCK_BINDING 3
+#define UNIFORM_BLOCK_COUNT 4
+
+#define MAX_LIGHTS 4
+
+// C++ mirrors of the GLSL blocks in uniform_blocks.cpp. std140 aligns vec3
+// like vec4, so positions and colors are stored as vec4; bools take four
+// bytes and are stored as int. The asserts below pin every member to its
+// std140 offset.
+struct FrameBlock {
+    float time = 0.0f;        // seconds since start
+    float deltaTime = 0.0f;
+    float padding[2] = { 0.0f, 0.0f };
+};
+
+struct CameraBlock {
+    glm::mat4 projection = glm::mat4(1.0f);
+    glm::mat4 view = glm::mat4(1.0f);
+    glm::mat4 viewProjection = glm::mat4(1.0f);
+    glm::vec4 position = glm::vec4(0.0f);   // w unused
+};
+
+struct LightBlock {
+    glm::vec4 positions[MAX_LIGHTS];   // w unused
+    glm::vec4 colors[MAX_LIGHTS];      // w unused
+    int count = 0;
+    int padding[3] = { 0, 0, 0 };
+};
+
+// The normal matrix is a mat4 whose upper 3x3 is used: a std140 mat3 has
+// vec4 columns, which glm::mat3 does not.
+struct ObjectBlock {
+    glm::mat4 model = glm::mat4(1.0f);          // non-instanced variants only
+    glm::mat4 normalMatrix = glm::mat4(1.0f);   // non-instanced variants only
+    glm::vec4 color = glm::vec4(1.0f);          // rgb surface color, a opacity
+
+    // Sets model and the normal matrix that goes with it
+    void SetModel(const glm::mat4& transform);
+};
+
+#define CHECK_STD140_OFFSET(block, member, offset) \
+    static_assert(offsetof(block, member) == offset, #block "::" #member " is not at its std140 offset")
+#define CHECK_STD140_SIZE(block, size) \
+    static_assert(sizeof(block) == size && sizeof(block) % 16 == 0, #block " does not match its std140 size")
+
+CHECK_STD140_OFFSET(FrameBlock, time, 0);
+CHECK_STD140_OFFSET(FrameBlock, deltaTime, 4);
+CHECK_STD140_SIZE(FrameBlock, 16);
+
+CHECK_STD140_OFFSET(CameraBlock, projection, 0);
+CHECK_STD140_OFFSET(CameraBlock, view, 64);
+CHECK_STD140_OFFSET(CameraBlock, viewProjection, 128);
+CHECK_STD140_OFFSET(CameraBlock, position, 192);
+CHECK_STD140_SIZE(CameraBlock, 208);
+
+CHECK_STD140_OFFSET(LightBlock, positions, 0);
+CHECK_STD140_OFFSET(LightBlock, colors, 16 * MAX_LIGHTS);
+CHECK_STD140_OFFSET(LightBlock, count, 32 * MAX_LIGHTS);
+CHECK_STD140_SIZE(LightBlock, 32 * MAX_LIGHTS + 16);
+
+CHECK_STD140_OFFSET(ObjectBlock, model, 0);
+CHECK_STD140_OFFSET(ObjectBlock, normalMatrix, 64);
+CHECK_STD140_OFFSET(ObjectBlock, color, 128);
+CHECK_STD140_SIZE(ObjectBlock, 144);
+
+// The four blocks, streamed through a StreamBuffer and bound with
+// glBindBufferRange to fixed binding points. Programs declare the blocks
+// through AddDeclarations() and Shader assigns them to the binding points
+// after linking, so every program reads the same ranges and switching
+// programs re-uploads nothing. Frame and camera are set once per frame,
+// lights when they move, and the object block per material or object; a
+// block whose contents did not change is not written again within a frame.
+// BeginFrame() carries every block over into the stream's new region.
+// Should a region fill up, blocks go to a small buffer of their own with
+// glBufferSubData for the rest of the frame, so no binding is left pointing
+// into a region that a later frame will reuse.
+class UniformBlocks {
+public:
+    explicit UniformBlocks(StreamBuffer& stream);
+    ~UniformBlocks();
+
+    // Inserts defines and the GLSL block declarations after the source's
+    // #version line
+    static std::string AddDeclarations(const char* source, const std::string& defines = std::string());
+    // Assigns the program's active blocks to the shared binding points
+    static void BindProgram(unsigned int program);
+
+    void SetFrame(const FrameBlock& block);
+    void SetCamera(const CameraBlock& block);
+    void SetLights(const LightBlock& block);
+    void SetObject(const ObjectBlock& block);
+    // Rewrites the current blocks after StreamBuffer::BeginFrame()
+    void BeginFrame();
+
+    unsigned int GetUploadCount() const;   // block writes since creation
+
+private:
+    StreamBuffer& stream;
+    unsigned int alignment = 256;   // GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT
+    std::vector<unsigned char> uploaded[UNIFORM_BLOCK_COUNT];   // last contents of each block
+    unsigned int uploads = 0;
+    unsigned int overflowBuffer = 0;   // one slot per block, used when the stream is full
+    unsigned int overflowSlotSize = 0;
+    bool reportedOverflow = false;
+
+    void Upload(unsigned int binding, const void* data, size_t size);
+};
+
+#endif